@@ -1,14 +1,52 @@
 # Hydroponic Data Collector - Ryan Cohen, 2023
-# Version 0.1.0
-# 
-# This is meant to be run as a cron script every 5 minutes.
+# Version 0.6.0
 #
-# The script connects to a Hydro Manager and collects data from it. This data
+# This is meant to be run as a daemon that collects from every Hydro Manager every
+# 5 minutes. With `--once`, it collects a single time, so it can still be run from cron.
+#
+# The script connects to Hydro Managers and collects data from them. This data
 # is immediately logged into a MySQL database.
 #
-# Currently, it only collects basic pH data. In the future, it will also collect
-# other sensors, events, and logs.
-import mysql.connector, datetime, requests, sys
+# Every Hydro Manager is collected from at the same time, so a collection takes about as
+# long as the slowest Hydro Manager. Rows are written with bulk inserts over a pool of
+# database connections that is kept open between collections.
+#
+# Pump pulse events are collected with a cursor. The cursor is only saved after
+# the events are committed to the database, so if a request or the database fails,
+# the same events are requested again on the next run.
+#
+# Hourly and daily rollups of the readings and pump pulses are updated in the same
+# transaction as the rows they summarize, so they always agree with the raw tables.
+#
+# Readings of ESP32 Hydro Managers are drained from their flash log through
+# '/api/history' with a time cursor, in batches, so readings logged while a Hydro Manager
+# or the collector was offline are collected once it is reachable again.
+#
+# Pump pulse events of ESP32 Hydro Managers are requested as binary telemetry frames from
+# '/api/telemetry', which are a fraction of the size of the JSON and checked with a CRC.
+#
+# With `--listen`, telemetry frames pushed over UDP by ESP32 Hydro Managers are received
+# too. A pushed frame whose event cursor is ahead of the saved one starts a collection of
+# that Hydro Manager right away, instead of at the next interval.
+#
+# Changelog:
+#
+# Version 0.6.0
+#  * Request events of ESP32 Hydro Managers as binary telemetry frames from '/api/telemetry'
+#  * Collect right away when a pushed telemetry frame has new events, with `--listen`
+#
+# Version 0.5.0
+#  * Drain readings and dropped pump pulse events of ESP32 Hydro Managers from '/api/history'
+#
+# Version 0.4.0
+#  * Maintain hourly and daily rollups in `sensor_rollups` and `pump_rollups`
+#
+# Version 0.3.0
+#  * Collect from many Hydro Managers concurrently, as a daemon or once from cron
+#  * Collect from ESP32 Hydro Managers through '/api/events.json' and '/api/readings.json'
+#  * Bulk insert rows with one pooled connection per Hydro Manager
+import mysql.connector, mysql.connector.pooling
+import argparse, concurrent.futures, datetime, decimal, json, os, requests, socket, struct, threading, time, zlib
 
 
 CONFIG = {
@@ -19,38 +57,488 @@ CONFIG = {
     'raise_on_warnings': True
 }
 
+# File that stores the event cursor of each Hydro Manager
+CURSOR_FILE = os.path.expanduser('~/.hydro_collector_cursors.json')
 
-if __name__ == '__main__':
-    if len(sys.argv) != 2:
-        print("USAGE: python3 hydro_collector.py IP_ADDR")
-        sys.exit(1)
+# Max number of mailbox requests to a Hydro Manager in a single collection
+MAX_MAILBOX_REQUESTS = 32
+
+# Seconds between collections when running as a daemon
+COLLECT_INTERVAL = 5 * 60
+
+# UDP port that Hydro Managers push telemetry frames to (CONFIG_HYDRO_MANAGER_TELEMETRY_PORT)
+TELEMETRY_PORT = 5140
+
+# Min seconds between collections started by pushed frames; frames are pushed every
+# second, and keep showing new events until a collection succeeds
+PUSH_COLLECT_INTERVAL = 10
+
+# Timeout of every HTTP request in seconds
+REQUEST_TIMEOUT = 15
+
+# Max number of pooled database connections; mysql-connector allows at most 32
+MAX_POOL_SIZE = 32
+
+# Periods of the rollup tiers in seconds
+ROLLUP_PERIODS = (3600, 86400)
+
+# Seconds of history requested at a time, and the max number of history requests to a
+# Hydro Manager in a single collection
+HISTORY_BATCH_SECONDS = 6 * 60 * 60
+MAX_HISTORY_REQUESTS = 16
+
+# History older than this is not drained; a Hydro Manager's flash log does not hold much more
+HISTORY_MAX_AGE = 7 * 24 * 60 * 60
+
+# Seconds that newer records are left for the next collection, since the Hydro Manager
+# queues records before they are added to its flash log
+HISTORY_SETTLE_SECONDS = 10
+
+# Hydro Manager clocks before this time have not been synced from SNTP yet (2023-01-01)
+MIN_SYNCED_TIME = 1672531200
+
+# Format version of '/api/history' (see HydroManager/main/history.h)
+HISTORY_FORMAT = 2
+
+# Sensor type index of each reading in `sensor_readings`
+SENSOR_TYPE_PH = 0
+SENSOR_TYPE_TDS = 1
+SENSOR_TYPE_TEMP = 2
+SENSOR_TYPE_HUMIDITY = 3
+
+# Readings of ESP32 Hydro Managers and their sensor type indexes
+ESP32_READINGS = (('ph', SENSOR_TYPE_PH), ('tds', SENSOR_TYPE_TDS),
+                  ('temp', SENSOR_TYPE_TEMP), ('humidity', SENSOR_TYPE_HUMIDITY))
+
+# Binary telemetry frames of '/api/telemetry' (see HydroManager/main/telemetry.h)
+TELEMETRY_MAGIC = 0x46544d48
+TELEMETRY_VERSION = 2
+TELEMETRY_HEADER = struct.Struct('<IBBBxIIII')
+TELEMETRY_READING = struct.Struct('<IiiiI')
+TELEMETRY_EVENT = struct.Struct('<IIIBBxx')
+TELEMETRY_CRC_SIZE = 4
+TELEMETRY_FLAG_READING = 1 << 0
+TELEMETRY_FLAG_RESET = 1 << 1
+TELEMETRY_FLAG_MORE = 1 << 2
+TELEMETRY_EVENT_INTERRUPTED = 1 << 0
+TELEMETRY_EVENT_AUTOMATIC = 1 << 1
+
+# Sensor type index and scale of each channel of '/api/history', in channel order
+HISTORY_CHANNELS = ((SENSOR_TYPE_PH, 100), (SENSOR_TYPE_TEMP, 100),
+                    (SENSOR_TYPE_HUMIDITY, 100), (SENSOR_TYPE_TDS, 1))
+
+PULSE_QUERY = ("INSERT INTO pump_pulses (timestamp,pump_id,pulse_length,interrupted,sensor_id) "
+               "VALUES (%s,%s,%s,%s,%s)")
+READING_QUERY = ("INSERT INTO sensor_readings (timestamp,sensor_id,sensor_reading,sensor_type_index) "
+                 "VALUES (%s,%s,%s,%s)")
+SENSOR_ROLLUP_QUERY = (
+    "INSERT INTO sensor_rollups (period,period_start,sensor_id,sensor_type_index,"
+    "reading_min,reading_max,reading_sum,reading_count) VALUES (%s,%s,%s,%s,%s,%s,%s,%s) "
+    "ON DUPLICATE KEY UPDATE reading_min=LEAST(reading_min,VALUES(reading_min)),"
+    "reading_max=GREATEST(reading_max,VALUES(reading_max)),"
+    "reading_sum=reading_sum+VALUES(reading_sum),reading_count=reading_count+VALUES(reading_count)")
+PUMP_ROLLUP_QUERY = (
+    "INSERT INTO pump_rollups (period,period_start,sensor_id,pump_id,dose_total,pulse_count) "
+    "VALUES (%s,%s,%s,%s,%s,%s) "
+    "ON DUPLICATE KEY UPDATE dose_total=dose_total+VALUES(dose_total),"
+    "pulse_count=pulse_count+VALUES(pulse_count)")
+
+# Cursors are saved by every collecting thread
+cursor_file_lock = threading.Lock()
+
+
+def cursor_entry(value):
+    # Cursor files of version 0.4.0 only have the event cursor of each Hydro Manager
+    return value if isinstance(value, dict) else {'seq': value}
+
+
+def load_cursors(ip):
+    try:
+        with open(CURSOR_FILE) as f:
+            return cursor_entry(json.load(f).get(ip))
+    except (OSError, ValueError):
+        return {}
+
+
+def save_cursor(ip, **values):
+    with cursor_file_lock:
+        try:
+            with open(CURSOR_FILE) as f:
+                cursors = json.load(f)
+        except (OSError, ValueError):
+            cursors = {}
+
+        entry = cursor_entry(cursors.get(ip))
+        entry.update(values)
+        cursors[ip] = entry
+        tmp_file = CURSOR_FILE + '.tmp'
+        with open(tmp_file, 'w') as f:
+            json.dump(cursors, f)
+        os.replace(tmp_file, CURSOR_FILE)
+
+
+def varint(data, offset):
+    value = shift = 0
+    while True:
+        if offset >= len(data):
+            raise ValueError('history record is truncated')
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7f) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, offset
+
+
+def zigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def decode_history(data):
+    # Decodes the ts_codec stream of '/api/history' (see HydroManager/main/ts_codec.h) into
+    # ('reading', time, values) and ('pulse', time, pump_id, length, interrupted, seq) tuples
+    if len(data) < 2 or data[0] != HISTORY_FORMAT:
+        raise ValueError('unknown history format')
+
+    records = []
+    offset = 2
+    readings = last_time = last_reading_time = last_delta = last_seq = 0
+    values = [0] * len(HISTORY_CHANNELS)
+    while offset < len(data):
+        header, offset = varint(data, offset)
+        if header & 1:
+            seq_delta, offset = varint(data, offset)
+            length, offset = varint(data, offset)
+            if offset >= len(data):
+                raise ValueError('history record is truncated')
+            flags = data[offset]
+            offset += 1
+            last_time = (last_time + zigzag(header >> 1)) & 0xffffffff
+            last_seq = (last_seq + zigzag(seq_delta)) & 0xffffffff
+            records.append(('pulse', last_time, flags & 0x0f, length, bool(flags & 0x10), last_seq))
+            continue
+
+        changed = (header >> 1) & 0x0f
+        delta = last_delta + zigzag(header >> 5)
+        for i in range(len(HISTORY_CHANNELS)):
+            if changed & (1 << i):
+                value_delta, offset = varint(data, offset)
+                values[i] += zigzag(value_delta)
+        last_reading_time = last_time = (last_reading_time + delta) & 0xffffffff
+        last_delta = delta if readings else 0
+        readings += 1
+        records.append(('reading', last_time, tuple(values)))
+    return records
 
-    ip = sys.argv[1]
 
-    req = requests.get(f'http://{ip}/json/mailbox.json')
-    json = req.json()
-    json['time'] += 14400    # temporary timestamp offset to UTC. FIX IN HYDRO MANAGER
-    json['time'] = datetime.datetime.fromtimestamp(json['time'])
-    time = json['time']
+def parse_frame(data):
+    # Parses a telemetry frame into the same fields as a response of '/api/events.json'
+    size = TELEMETRY_HEADER.size + TELEMETRY_READING.size + TELEMETRY_CRC_SIZE
+    if len(data) < size:
+        raise ValueError('telemetry frame is truncated')
+    if zlib.crc32(data[:-TELEMETRY_CRC_SIZE]) != int.from_bytes(data[-TELEMETRY_CRC_SIZE:], 'little'):
+        raise ValueError('telemetry frame CRC does not match')
+    magic, version, flags, event_count, time, seq, dropped, boot = TELEMETRY_HEADER.unpack_from(data)
+    if magic != TELEMETRY_MAGIC or version != TELEMETRY_VERSION:
+        raise ValueError('unknown telemetry frame format')
+    if len(data) != size + event_count * TELEMETRY_EVENT.size:
+        raise ValueError('telemetry frame size does not match its events')
 
-    json['time'] = str(json['time'])
-    print(json)
+    frame = {'time': time, 'seq': seq, 'dropped': dropped, 'boot': boot, 'reset': bool(flags & TELEMETRY_FLAG_RESET),
+             'more': bool(flags & TELEMETRY_FLAG_MORE), 'pulse_events': []}
+    if flags & TELEMETRY_FLAG_READING:
+        timestamp, ph, temp, humidity, tds = TELEMETRY_READING.unpack_from(data, TELEMETRY_HEADER.size)
+        frame['reading'] = {'time': timestamp, 'ph': ph / 100, 'temp': temp / 100,
+                            'humidity': humidity / 100, 'tds': tds}
 
-    cnx = mysql.connector.connect(**CONFIG)
-    cursor = cnx.cursor()
+    offset = TELEMETRY_HEADER.size + TELEMETRY_READING.size
+    for i in range(event_count):
+        event_seq, timestamp, length, pump_id, event_flags = TELEMETRY_EVENT.unpack_from(data, offset)
+        offset += TELEMETRY_EVENT.size
+        frame['pulse_events'].append({
+            'seq': event_seq, 'time': timestamp, 'type': pump_id, 'len': length,
+            'interrupt': bool(event_flags & TELEMETRY_EVENT_INTERRUPTED),
+            'auto': bool(event_flags & TELEMETRY_EVENT_AUTOMATIC)})
+    return frame
+
+
+def period_start(timestamp, period):
+    if period == 86400:
+        return timestamp.replace(hour=0, minute=0, second=0, microsecond=0)
+    return timestamp.replace(minute=0, second=0, microsecond=0)
+
+
+def centi(reading):
+    # Rounds a reading to the 2 decimals of the DECIMAL columns the way MySQL does, so sums
+    # are exact and never need to be truncated by the database
+    return decimal.Decimal(str(reading)).quantize(decimal.Decimal('0.01'), decimal.ROUND_HALF_UP)
+
+
+def sensor_rollup_rows(readings):
+    # Readings of the same period are combined first, so each rollup row is only updated once
+    rollups = {}
+    for timestamp, sensor_id, reading, sensor_type in readings:
+        reading = centi(reading)
+        for period in ROLLUP_PERIODS:
+            key = (period, period_start(timestamp, period), sensor_id, sensor_type)
+            low, high, total, count = rollups.get(key, (reading, reading, 0, 0))
+            rollups[key] = (min(low, reading), max(high, reading), total + reading, count + 1)
+    return [key + value for key, value in rollups.items()]
+
+
+def pump_rollup_rows(pulses):
+    rollups = {}
+    for timestamp, pump_id, pulse_length, interrupted, sensor_id in pulses:
+        for period in ROLLUP_PERIODS:
+            key = (period, period_start(timestamp, period), sensor_id, pump_id)
+            total, count = rollups.get(key, (0, 0))
+            rollups[key] = (total + pulse_length, count + 1)
+    return [key + value for key, value in rollups.items()]
+
+
+class HydroManager:
+    def __init__(self, ip, sensor_id):
+        self.ip = ip
+        self.sensor_id = sensor_id
+        cursors = load_cursors(ip)
+        self.cursor_seq = cursors.get('seq')
+        # Boot ID of an ESP32 Hydro Manager that the cursor belongs to
+        self.cursor_boot = cursors.get('boot')
+        # Time of the newest drained history record of an ESP32 Hydro Manager
+        self.history_time = cursors.get('history')
+        # Keeps the HTTP connection alive between requests
+        self.session = requests.Session()
+        # Set on the first collection; None until then
+        self.is_esp32 = None
+        self.has_telemetry = False
+
+    def get(self, path, params=None, binary=False):
+        req = self.session.get(f'http://{self.ip}{path}', params=params, timeout=REQUEST_TIMEOUT)
+        req.raise_for_status()
+        return req.content if binary else req.json()
+
+    def timestamp(self, time):
+        # The ESP8266 sends local time; temporary timestamp offset to UTC. FIX IN HYDRO MANAGER
+        return datetime.datetime.fromtimestamp(time + (0 if self.is_esp32 else 14400))
+
+    def detect(self):
+        # Only ESP32 Hydro Managers have '/api/events.json'
+        req = self.session.get(f'http://{self.ip}/api/events.json', timeout=REQUEST_TIMEOUT)
+        self.is_esp32 = req.status_code != 404
+        if self.is_esp32:
+            # Requesting a frame without a cursor does not acknowledge any events
+            req = self.session.get(f'http://{self.ip}/api/telemetry', timeout=REQUEST_TIMEOUT)
+            self.has_telemetry = req.status_code != 404
+        print(f"{self.ip}: {'ESP32' if self.is_esp32 else 'ESP8266'} Hydro Manager"
+              f"{' with telemetry frames' if self.has_telemetry else ''}")
+
+    def has_new_events(self, frame):
+        # Pushed frames carry the seq of the newest event; it matches the cursor once every
+        # event was committed. Events are left alone until the clock is synced.
+        return frame['time'] >= MIN_SYNCED_TIME and (
+            frame['boot'] != self.cursor_boot or frame['seq'] != self.cursor_seq)
+
+    def get_events(self, params):
+        if self.has_telemetry:
+            return parse_frame(self.get('/api/telemetry', params, binary=True))
+        return self.get('/api/events.json' if self.is_esp32 else '/json/mailbox.json', params)
+
+    def pulse_rows(self, mailbox):
+        return [(self.timestamp(event['time']), event['type'], event['len'], event['interrupt'],
+                 self.sensor_id) for event in mailbox.get('pulse_events', [])]
+
+    def reading_rows(self, mailbox):
+        if not self.is_esp32:
+            return [(self.timestamp(mailbox['time']), self.sensor_id, mailbox['ph'], SENSOR_TYPE_PH)]
+
+        reading = self.get('/api/readings.json')
+        time = self.timestamp(reading['time'])
+        return [(time, self.sensor_id, reading[key], sensor_type)
+                for key, sensor_type in ESP32_READINGS if key in reading]
+
+    def history_rows(self, data):
+        readings, pulses = [], []
+        for record in decode_history(data):
+            time = self.timestamp(record[1])
+            if record[0] == 'reading':
+                readings += [(time, self.sensor_id, round(value / scale, 2), sensor_type)
+                             for value, (sensor_type, scale) in zip(record[2], HISTORY_CHANNELS)]
+            elif record[5] == 0:
+                # Events without a seq were dropped from the event ring, so they were never
+                # sent by '/api/events.json'
+                _, _, pump_id, length, interrupted, _ = record
+                pulses.append((time, pump_id, length, interrupted, self.sensor_id))
+        return readings, pulses
+
+    def commit_rows(self, cnx, cursor, pulses, readings):
+        if pulses:
+            cursor.executemany(PULSE_QUERY, pulses)
+            cursor.executemany(PUMP_ROLLUP_QUERY, pump_rollup_rows(pulses))
+        if readings:
+            cursor.executemany(READING_QUERY, readings)
+            cursor.executemany(SENSOR_ROLLUP_QUERY, sensor_rollup_rows(readings))
+        cnx.commit()
+
+    def drain_history(self, cnx, cursor, now):
+        # Records are drained in batches of time up to `now` on the Hydro Manager. Each batch
+        # is committed before the history cursor is saved, so a failure only repeats a batch.
+        end = now - HISTORY_SETTLE_SECONDS
+        if now < MIN_SYNCED_TIME:
+            print(f"{self.ip}: Hydro Manager clock is not synced; history is not drained")
+            return
+        if self.history_time is None:
+            self.history_time = end - COLLECT_INTERVAL
+        self.history_time = max(self.history_time, end - HISTORY_MAX_AGE)
+
+        for i in range(MAX_HISTORY_REQUESTS):
+            if self.history_time >= end:
+                break
+            to = min(self.history_time + HISTORY_BATCH_SECONDS, end)
+            try:
+                data = self.get('/api/history', {'from': self.history_time + 1, 'to': to},
+                                binary=True)
+            except requests.HTTPError as e:
+                if e.response.status_code != 500 or i > 0:
+                    raise
+                # The flash log is not available, so only the latest reading is collected
+                readings = self.reading_rows({})
+                self.commit_rows(cnx, cursor, [], readings)
+                print(f"{self.ip}: History is not available; committed the latest reading")
+                return
+
+            readings, pulses = self.history_rows(data)
+            self.commit_rows(cnx, cursor, pulses, readings)
+            self.history_time = to
+            save_cursor(self.ip, history=self.history_time)
+            print(f"{self.ip}: Committed {len(readings)} readings and {len(pulses)} dropped pulses from history")
+
+    def collect(self, pool):
+        if self.is_esp32 is None:
+            self.detect()
+
+        cnx = pool.get_connection()
+        try:
+            cursor = cnx.cursor()
+
+            # Request events newer than the cursor until there are no more. Each page is
+            # committed before the next request, because the next request acknowledges it.
+            for i in range(MAX_MAILBOX_REQUESTS):
+                params = {} if self.cursor_seq is None else {'since': self.cursor_seq}
+                if self.cursor_seq is not None and self.cursor_boot is not None:
+                    params['boot'] = self.cursor_boot
+                mailbox = self.get_events(params)
+                if i == 0:
+                    now = mailbox['time']
+
+                # Until its clock is synced, an ESP32 Hydro Manager timestamps events from
+                # boot. They are left unacknowledged, and moved to the wall clock by the Hydro
+                # Manager once it syncs.
+                if self.is_esp32 and now < MIN_SYNCED_TIME:
+                    break
+
+                if mailbox.get('reset'):
+                    print(f"{self.ip}: Hydro Manager did not recognize the cursor; it was probably restarted")
+
+                pulses = self.pulse_rows(mailbox)
+
+                # Only log the reading from the first response; readings of ESP32 Hydro
+                # Managers are drained from their history instead
+                readings = self.reading_rows(mailbox) if i == 0 and not self.is_esp32 else []
+                self.commit_rows(cnx, cursor, pulses, readings)
+
+                self.cursor_seq = mailbox['seq']
+                self.cursor_boot = mailbox.get('boot')
+                save_cursor(self.ip, seq=self.cursor_seq, boot=self.cursor_boot)
+                print(f"{self.ip}: Committed {len(pulses)} pulses and {len(readings)} readings")
+                if not mailbox.get('more'):
+                    break
+
+            if self.is_esp32:
+                self.drain_history(cnx, cursor, now)
+
+            cursor.close()
+        finally:
+            # Returns the connection to the pool
+            cnx.close()
+
+
+def collect_all(managers, pool, executor):
+    futures = {executor.submit(manager.collect, pool): manager for manager in managers}
+    for future in concurrent.futures.as_completed(futures):
+        try:
+            future.result()
+        except (requests.RequestException, mysql.connector.Error, KeyError, ValueError) as e:
+            # Only this Hydro Manager is skipped; its cursor is unchanged, so nothing is lost
+            print(f"{futures[future].ip}: Collection failed: {e}")
+
+
+def listen_telemetry(port, managers, pushed, wake):
+    # Pushes are matched to Hydro Managers by their address, so they must be given by IP
+    by_ip = {manager.ip: manager for manager in managers}
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(('', port))
+    while True:
+        data, (ip, _) = sock.recvfrom(2048)
+        manager = by_ip.get(ip)
+        if manager is None:
+            continue
+        try:
+            frame = parse_frame(data)
+        except ValueError as e:
+            print(f"{ip}: Ignored pushed telemetry frame: {e}")
+            continue
+        if manager.has_new_events(frame):
+            with pushed['lock']:
+                pushed['managers'].add(manager)
+            wake.set()
+
+
+def wait_for_pushes(managers, pool, executor, pushed, wake, deadline):
+    # Collects from Hydro Managers that pushed new events until the next collection is due
+    while wake.wait(max(0, deadline - time.monotonic())):
+        wake.clear()
+        with pushed['lock']:
+            woken = [manager for manager in managers if manager in pushed['managers']]
+            pushed['managers'].clear()
+        collect_all(woken, pool, executor)
+        time.sleep(min(PUSH_COLLECT_INTERVAL, max(0, deadline - time.monotonic())))
+
+
+def parse_manager(arg, index):
+    ip, _, sensor_id = arg.partition('=')
+    return HydroManager(ip, int(sensor_id) if sensor_id else index + 1)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Collects data from Hydro Managers.')
+    parser.add_argument('managers', metavar='IP_ADDR[=SENSOR_ID]', nargs='+',
+                        help='Hydro Manager address; SENSOR_ID defaults to its position, starting from 1')
+    parser.add_argument('--once', action='store_true', help='collect once and exit')
+    parser.add_argument('--interval', type=float, default=COLLECT_INTERVAL,
+                        help='seconds between collections')
+    parser.add_argument('--listen', metavar='PORT', type=int, nargs='?', const=TELEMETRY_PORT,
+                        help=f'receive pushed telemetry frames on this UDP port (default {TELEMETRY_PORT})')
+    args = parser.parse_args()
 
-    if 'pulse_events' in json:
-        for event in json['pulse_events']:
-            query = ("INSERT INTO pump_pulses (timestamp,pump_id,pulse_length,interrupted)"
-                     "VALUES (%s,%s,%s,%s)")
-            cursor.execute(query, (datetime.datetime.fromtimestamp(event['time'] + 14400), event['type'], event['len'], event['interrupt']))
+    managers = [parse_manager(arg, i) for i, arg in enumerate(args.managers)]
 
-    query = ("INSERT INTO sensor_readings (timestamp,sensor_id,sensor_reading,sensor_type_index) "
-             "VALUES (%s,%s,%s,%s)")
-    cursor.execute(query, (time,1,json['ph'],0))
-    cnx.commit()
+    # Every collecting thread holds one connection while it collects
+    pool_size = min(len(managers), MAX_POOL_SIZE)
+    pool = mysql.connector.pooling.MySQLConnectionPool(
+        pool_name='hydro_collector', pool_size=pool_size, **CONFIG)
 
-    cursor.close()
-    cnx.close()
-    print("Committed reading to database")
+    # Hydro Managers that pushed new events, and set when one is added
+    pushed = {'lock': threading.Lock(), 'managers': set()}
+    wake = threading.Event()
+    if args.listen is not None and not args.once:
+        threading.Thread(target=listen_telemetry, args=(args.listen, managers, pushed, wake),
+                         daemon=True).start()
 
+    with concurrent.futures.ThreadPoolExecutor(max_workers=pool_size) as executor:
+        while True:
+            start = time.monotonic()
+            collect_all(managers, pool, executor)
+            print(f"Collected from {len(managers)} Hydro Managers in {time.monotonic() - start:.1f} s")
+            if args.once:
+                break
+            wait_for_pushes(managers, pool, executor, pushed, wake, start + args.interval)
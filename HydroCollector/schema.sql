@@ -0,0 +1,74 @@
+-- Tables of the HydroCollection database written by hydro_collector.py
+--
+-- Databases created before collector version 0.3.0 need the sensor_id column of pump_pulses
+-- and the indexes that HydroDataView uses for its range queries:
+--
+--   ALTER TABLE pump_pulses ADD COLUMN sensor_id INT NOT NULL DEFAULT 1;
+--   CREATE INDEX sensor_time ON sensor_readings (sensor_id, sensor_type_index, timestamp);
+--   CREATE INDEX sensor_time ON pump_pulses (sensor_id, timestamp);
+--
+-- and the rollup tables below, which can be filled from the rows that were already
+-- collected with the statements at the end of this file.
+
+-- sensor_type_index: 0 = pH, 1 = TDS (ppm), 2 = temperature (C), 3 = humidity (%)
+CREATE TABLE IF NOT EXISTS sensor_readings (
+    timestamp DATETIME NOT NULL,
+    sensor_id INT NOT NULL,
+    sensor_reading DECIMAL(10, 2) NOT NULL,
+    sensor_type_index INT NOT NULL,
+    INDEX sensor_time (sensor_id, sensor_type_index, timestamp)
+);
+
+-- pump_id: 1 = pH down, 2 = pH up, 3 = refill
+CREATE TABLE IF NOT EXISTS pump_pulses (
+    timestamp DATETIME NOT NULL,
+    pump_id INT NOT NULL,
+    pulse_length INT NOT NULL,
+    interrupted BOOLEAN NOT NULL,
+    sensor_id INT NOT NULL DEFAULT 1,
+    INDEX sensor_time (sensor_id, timestamp)
+);
+
+-- Hourly (period = 3600) and daily (period = 86400) rollups of sensor_readings, which the
+-- collector updates in the same transaction as the readings it inserts. The average of a
+-- period is reading_sum / reading_count.
+CREATE TABLE IF NOT EXISTS sensor_rollups (
+    period INT NOT NULL,
+    period_start DATETIME NOT NULL,
+    sensor_id INT NOT NULL,
+    sensor_type_index INT NOT NULL,
+    reading_min DECIMAL(10, 2) NOT NULL,
+    reading_max DECIMAL(10, 2) NOT NULL,
+    reading_sum DECIMAL(16, 2) NOT NULL,
+    reading_count INT NOT NULL,
+    PRIMARY KEY (period, sensor_id, sensor_type_index, period_start)
+);
+
+-- Hourly and daily dose totals of each pump, in milliseconds
+CREATE TABLE IF NOT EXISTS pump_rollups (
+    period INT NOT NULL,
+    period_start DATETIME NOT NULL,
+    sensor_id INT NOT NULL,
+    pump_id INT NOT NULL,
+    dose_total BIGINT NOT NULL,
+    pulse_count INT NOT NULL,
+    PRIMARY KEY (period, sensor_id, pump_id, period_start)
+);
+
+-- Backfill of the rollup tables; only run once, on tables that are still empty. Periods
+-- start at local midnight and on the local hour, like the periods of the collector.
+--
+--   INSERT INTO sensor_rollups
+--   SELECT p.period, DATE_FORMAT(timestamp,
+--          IF(p.period = 86400, '%Y-%m-%d 00:00:00', '%Y-%m-%d %H:00:00')) AS period_start,
+--          sensor_id, sensor_type_index, MIN(sensor_reading), MAX(sensor_reading),
+--          SUM(sensor_reading), COUNT(*)
+--   FROM sensor_readings JOIN (SELECT 3600 AS period UNION SELECT 86400) p
+--   GROUP BY p.period, period_start, sensor_id, sensor_type_index;
+--
+--   INSERT INTO pump_rollups
+--   SELECT p.period, DATE_FORMAT(timestamp,
+--          IF(p.period = 86400, '%Y-%m-%d 00:00:00', '%Y-%m-%d %H:00:00')) AS period_start,
+--          sensor_id, pump_id, SUM(pulse_length), COUNT(*)
+--   FROM pump_pulses JOIN (SELECT 3600 AS period UNION SELECT 86400) p
+--   GROUP BY p.period, period_start, sensor_id, pump_id;
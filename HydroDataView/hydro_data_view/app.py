@@ -1,11 +1,14 @@
 # Hydroponic Data View - Ryan Cohen, 2023
-# Version 0.1.0
+# Version 0.3.0
 # 
 # This program serves a website that will be used to view the database in
 # charts and tables.
 #
-# Currently, nothing is displayed yet. The first view will be a pH chart.
-from flask import Flask, render_template, url_for
+# Currently, there is a pH chart. Its data is loaded for the range that is shown and
+# bucketed to the width of the chart, so it loads in the same time no matter how much
+# history there is. Long ranges are read from the hourly and daily rollup tables that the
+# collector maintains, instead of from every reading.
+from flask import Flask, jsonify, render_template, request, url_for
 import mysql.connector, datetime
 from highcharts_stock import highcharts
 
@@ -61,35 +64,130 @@ def root_page():
 
 @app.route("/status")
 def status_page():
+    # The chart loads its data from `ph_data` for the range that is shown
+    return render_template('status.html')
+
+
+# Default and max number of buckets of a chart data request
+DEFAULT_BUCKETS = 500
+MAX_BUCKETS = 2000
+
+# Sensor type index of pH readings
+SENSOR_TYPE_PH = 0
+
+# Periods of the rollup tiers in seconds, from finest to coarsest
+ROLLUP_PERIODS = (3600, 86400)
+
+
+def rollup_period(bucket_seconds):
+    """Returns the coarsest rollup period that fits in a bucket, or None for raw rows."""
+    periods = [period for period in ROLLUP_PERIODS if period <= bucket_seconds]
+    return periods[-1] if periods else None
+
+
+# TODO: Find better way to convert timezones
+# This is a hack to convert the timezone from UTC seconds to EST milliseconds
+def to_chart_time(timestamp):
+    return (timestamp.timestamp() - 14400.0) * 1000.0
+
+
+def from_chart_time(time):
+    return datetime.datetime.fromtimestamp(time / 1000.0 + 14400.0)
+
+
+def period_start(timestamp, period):
+    if period == 86400:
+        return timestamp.replace(hour=0, minute=0, second=0, microsecond=0)
+    return timestamp.replace(minute=0, second=0, microsecond=0)
+
+
+@app.route("/api/ph.json")
+def ph_data():
+    """Sends the pH readings and pump pulses between `start` and `end` (chart
+    milliseconds), with the readings bucketed into at most `buckets` min/avg/max points.
+    Without `start` and `end`, the whole history is sent."""
+    sensor_id = request.args.get('sensor', 1, type=int)
+    buckets = max(1, min(request.args.get('buckets', DEFAULT_BUCKETS, type=int), MAX_BUCKETS))
+
     cnx = mysql.connector.connect(user=USER, password=PASSWORD,
                                   host=HOST, database=DATABASE)
     cursor = cnx.cursor()
-    query = ("SELECT timestamp, sensor_reading FROM sensor_readings")
-    cursor.execute(query)
 
-    ph_data = []
-    for (timestamp, sensor_reading) in cursor:
-        # TODO: Find better way to convert timezones
-        # This is a hack to convert the timezone from UTC seconds to EST milliseconds
-        timestamp = (timestamp.timestamp() - 14400.0) * 1000.0
-        ph_data.append([timestamp, float(sensor_reading)])
+    start = request.args.get('start', type=float)
+    end = request.args.get('end', type=float)
+    if start is None or end is None:
+        query = ("SELECT MIN(timestamp), MAX(timestamp) FROM sensor_readings "
+                 "WHERE sensor_id = %s AND sensor_type_index = %s")
+        cursor.execute(query, (sensor_id, SENSOR_TYPE_PH))
+        first, last = cursor.fetchone()
+        if first is None:
+            cursor.close()
+            cnx.close()
+            return jsonify(ph=[], ph_range=[], ph_down=[], ph_up=[])
+        start_time, end_time = first, last
+    else:
+        start_time, end_time = from_chart_time(start), from_chart_time(end)
+
+    # Readings are grouped into fixed buckets by the index range scan, so the response has
+    # the same size no matter how many readings are in the range
+    bucket_seconds = max(1, int((end_time - start_time).total_seconds() / buckets) + 1)
+    period = rollup_period(bucket_seconds)
+    if period is None:
+        query = ("SELECT MIN(timestamp), MIN(sensor_reading), AVG(sensor_reading), MAX(sensor_reading) "
+                 "FROM sensor_readings "
+                 "WHERE sensor_id = %s AND sensor_type_index = %s AND timestamp BETWEEN %s AND %s "
+                 "GROUP BY TIMESTAMPDIFF(SECOND, %s, timestamp) DIV %s "
+                 "ORDER BY MIN(timestamp)")
+        params = (sensor_id, SENSOR_TYPE_PH, start_time, end_time, start_time, bucket_seconds)
+    else:
+        # Each rollup row is one period, so about bucket_seconds / period rows make a bucket
+        query = ("SELECT MIN(period_start), MIN(reading_min), SUM(reading_sum) / SUM(reading_count), "
+                 "MAX(reading_max) FROM sensor_rollups "
+                 "WHERE period = %s AND sensor_id = %s AND sensor_type_index = %s "
+                 "AND period_start BETWEEN %s AND %s "
+                 "GROUP BY TIMESTAMPDIFF(SECOND, %s, period_start) DIV %s "
+                 "ORDER BY MIN(period_start)")
+        params = (period, sensor_id, SENSOR_TYPE_PH, period_start(start_time, period), end_time,
+                  start_time, bucket_seconds)
+    cursor.execute(query, params)
+
+    ph = []
+    ph_range = []
+    for (timestamp, low, average, high) in cursor:
+        time = to_chart_time(timestamp)
+        ph.append([time, round(float(average), 2)])
+        ph_range.append([time, float(low), float(high)])
+
+    # Pulses are flagged as the dose total of each pump in the same buckets as the readings,
+    # so there are at most `buckets` flags of each pump; a bucket of one pulse is flagged
+    # as that pulse
+    if period is None:
+        query = ("SELECT MIN(timestamp), pump_id, SUM(pulse_length), COUNT(*) FROM pump_pulses "
+                 "WHERE sensor_id = %s AND timestamp BETWEEN %s AND %s "
+                 "GROUP BY TIMESTAMPDIFF(SECOND, %s, timestamp) DIV %s, pump_id "
+                 "ORDER BY MIN(timestamp)")
+        params = (sensor_id, start_time, end_time, start_time, bucket_seconds)
+    else:
+        query = ("SELECT MIN(period_start), pump_id, SUM(dose_total), SUM(pulse_count) "
+                 "FROM pump_rollups "
+                 "WHERE period = %s AND sensor_id = %s AND period_start BETWEEN %s AND %s "
+                 "GROUP BY TIMESTAMPDIFF(SECOND, %s, period_start) DIV %s, pump_id "
+                 "ORDER BY MIN(period_start)")
+        params = (period, sensor_id, period_start(start_time, period), end_time,
+                  start_time, bucket_seconds)
+    cursor.execute(query, params)
 
     ph_down = []
     ph_up = []
-    query = ("SELECT * FROM pump_pulses")
-    cursor.execute(query)
-    for (timestamp, pump_id, pulse_len, interrupted) in cursor:
-        # TODO: Find better way to convert timezones
-        # This is a hack to convert the timezone from UTC seconds to EST milliseconds
-        timestamp = (timestamp.timestamp() - 14400.0) * 1000.0
+    for (timestamp, pump_id, pulse_len, pulse_count) in cursor:
+        text = f'{pulse_len} ms' if pulse_count == 1 else f'{pulse_count} pulses, {pulse_len} ms'
+        flag = {'x': to_chart_time(timestamp), 'text': text}
         if pump_id == 1:
-            ph_down.append((timestamp, pulse_len))
+            ph_down.append(flag)
         elif pump_id == 2:
-            ph_up.append((timestamp, pulse_len))
-
+            ph_up.append(flag)
 
     cursor.close()
     cnx.close()
-    
-    return render_template('status.html', ph_data=ph_data, ph_down=ph_down, ph_up=ph_up)
 
+    return jsonify(ph=ph, ph_range=ph_range, ph_down=ph_down, ph_up=ph_up)
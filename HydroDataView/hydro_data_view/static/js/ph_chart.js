@@ -1,5 +1,41 @@
-Highcharts.stockChart('container', {
+// Loads the chart data between `start` and `end` in milliseconds, or all of it without a
+// range, bucketed to about two points per pixel of the chart
+function loadPhData(chart, start, end) {
+    const params = new URLSearchParams({buckets: Math.round(chart.plotWidth / 2)});
+    if (start !== undefined) {
+        params.set('start', Math.round(start));
+        params.set('end', Math.round(end));
+    }
+    return fetch(`${PH_DATA_URL}?${params}`).then(r => r.json());
+}
+
+// Loads the data of the zoomed range once the range changes
+function afterSetExtremes(e) {
+    const chart = this.chart;
+    chart.showLoading('Loading data...');
+    loadPhData(chart, e.min, e.max).then(data => {
+        chart.get('phSeries').setData(data.ph, false);
+        chart.get('phRange').setData(data.ph_range, false);
+        chart.get('phDown').setData(data.ph_down, false);
+        chart.get('phUp').setData(data.ph_up, false);
+        chart.redraw();
+        chart.hideLoading();
+    });
+}
+
+const chart = Highcharts.stockChart('container', {
     chart: {
+        zoomType: 'x',
+    },
+    navigator: {
+        adaptToUpdatedData: false,
+        series: {
+            id: 'navigator',
+            data: [],
+        },
+    },
+    scrollbar: {
+        liveRedraw: false,
     },
     rangeSelector: {
         selected: 5,
@@ -45,7 +81,11 @@ Highcharts.stockChart('container', {
         align: 'left'
     },
     xAxis: {
-        type: 'datetime'
+        type: 'datetime',
+        events: {
+            afterSetExtremes: afterSetExtremes,
+        },
+        minRange: 60 * 1000,
     },
     yAxis: {
         title: {
@@ -70,22 +110,55 @@ Highcharts.stockChart('container', {
     series: [{
         type: 'spline',
         name: 'pH',
-        data: ph_data,
+        data: [],
         id: 'phSeries',
+        dataGrouping: {
+            enabled: false,
+        },
+    },
+    {
+        type: 'arearange',
+        name: 'pH Range',
+        data: [],
+        id: 'phRange',
+        linkedTo: 'phSeries',
+        fillOpacity: 0.3,
+        lineWidth: 0,
+        marker: {
+            enabled: false,
+        },
+        dataGrouping: {
+            enabled: false,
+        },
     },
     {
         type: 'flags',
         name: 'pH Down Pump Pulses',
-        data: ph_down,
+        data: [],
+        id: 'phDown',
         title: 'pH Down',
         onSeries: 'phSeries',
     },
     {
         type: 'flags',
         name: 'pH Up Pump Events',
-        data: ph_up,
+        data: [],
+        id: 'phUp',
         title: 'pH Up',
         onSeries: 'phSeries',
     }
     ]
 });
+
+// The navigator shows the whole history at a low resolution; the chart starts with the
+// same data until a range is selected
+chart.showLoading('Loading data...');
+loadPhData(chart).then(data => {
+    chart.get('navigator').setData(data.ph, false);
+    chart.get('phSeries').setData(data.ph, false);
+    chart.get('phRange').setData(data.ph_range, false);
+    chart.get('phDown').setData(data.ph_down, false);
+    chart.get('phUp').setData(data.ph_up, false);
+    chart.redraw();
+    chart.hideLoading();
+});
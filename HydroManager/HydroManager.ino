@@ -1,5 +1,5 @@
 // Hydroponic Manager - Ryan Cohen, 2023
-// Version 0.3.0
+// Version 0.4.0
 //
 // Use 40mL per Liter of pH Up/Down mix
 //
@@ -35,6 +35,18 @@
 //
 // Changelog:
 //
+// Version 0.4.0
+//  * Pump pulses are run by a non-blocking state machine polled from loop()
+//  * '/api/pulse' returns immediately with the ID of the started pulse
+//  * Overflow sensor is handled by an interrupt that turns off all pumps immediately
+//  * Pump pulse events are stored in a ring buffer with sequence numbers and a dropped event count
+//  * '/json/mailbox.json?since=<seq>' only sends newer events and releases events once acknowledged
+//  * pH is sampled in loop() through an oversampling, median and moving average filter; requests use the latest filtered value
+//  * pH is handled as integer centi-pH; JSON responses contain exact two-decimal values
+//  * HTML pages are static gzip compressed pages in flash, served with an ETag; live values are fetched from the JSON API
+//  * Range checked settings, their JSON and form parsing come from a single `SETTINGS_RANGES` list
+//  * Fix: settingsIsValid() checked the refill mode of the current settings instead of the settings being checked
+//
 // Version 0.3.0
 //  * Add '/json/mailbox.json' endpoint
 //  * Use a buffer to store recent pump pulse events
@@ -54,27 +66,26 @@
 #include <WiFiUdp.h>
 #include <Wire.h>
 
+// HTML pages; generated from pages/*.html by pages/generate_pages.py
+#include "html_pages.h"
 #include "ph_grav.h"
 
 //---------------------
 // Type declarations
 //---------------------
 
-// Setting types
-enum Type {
-  BOOL = 1,
-  ULONG = 2
-};
+// Size of the pump pulse event ring buffer
+const size_t PUMP_EVENT_RING_SIZE = 32;
 
-// Setting details
-struct SettingDetails {
-  String name;
-  enum Type type;
-  bool has_range;
-  unsigned long min_range;
-  unsigned long max_range;
-  void *value;
-};
+// Number of pH samples that the median is taken from; should be odd
+const size_t PH_MEDIAN_SIZE = 5;
+
+// Settings that are numbers within a range, as X(member, min, max); the member name is also
+// the name of the setting in forms and JSON
+#define SETTINGS_RANGES(X) \
+  X(phCheckInterval, PH_CHECK_INTERVAL_MIN, PH_CHECK_INTERVAL_MAX) \
+  X(phPumpDoseLength, PH_PUMP_DOSE_LENGTH_MIN, PH_PUMP_DOSE_LENGTH_MAX) \
+  X(refillDoseLength, 5, 70)
 
 enum RefillPumpMode {
   REFILL_OFF = 1,
@@ -101,12 +112,43 @@ enum PumpType {
 };
 
 struct PumpPulseEvent {
+  unsigned long seq;
   unsigned long timestamp;
   enum PumpType type;
   unsigned long length;
   bool interrupted;
 };
 
+// Ring buffer of pump pulse events. Every stored event gets a sequence number that increases
+// by 1, starting at 1. Events stay in the ring until they are released; events produced
+// while the ring is full are dropped and counted.
+struct PumpEventRing {
+  struct PumpPulseEvent events[PUMP_EVENT_RING_SIZE];
+  unsigned long head;     // Sequence number of the next event
+  unsigned long tail;     // Sequence number of the oldest event that has not been released
+  unsigned long dropped;  // Number of events dropped because the ring was full
+};
+
+// pH sensor filter. Raw ADC reads are oversampled, spikes are rejected with a median of the
+// latest samples, and the result is smoothed by an exponential moving average. Only integer
+// math is used until the final conversion to pH.
+struct PhFilter {
+  long window[PH_MEDIAN_SIZE];
+  size_t index;
+  size_t count;
+  long ema;       // Moving average, scaled by 2^PH_EMA_SHIFT
+  bool primed;
+};
+
+// State of the pump pulse that is currently running
+struct PumpPulse {
+  bool active;
+  int pump;
+  unsigned long id;
+  unsigned long startMillis;
+  unsigned long length;
+};
+
 //---------------------
 // Constants
 //---------------------
@@ -152,17 +194,38 @@ const int SETTINGS_SIZE = 128;
 const unsigned long SETTINGS_MAGIC = 0xdae46bfa;
 const unsigned long SETTINGS_VERSION = 2;
 
-// pH Range
-const float MAX_PH = 6.5f;
-const float MIN_PH = 5.5f;
+// pH Range in centi-pH (pH * 100)
+const long MAX_PH_CENTI = 650;
+const long MIN_PH_CENTI = 550;
 // Value is accurate within ~0.2 pH
-const float PH_ACC = 0.2f;
+const long PH_ACC_CENTI = 20;
 
 // Disable button delay
 const unsigned long DISABLE_DELAY = 5;
 
-// Size of the pump pulse event buffer
-const size_t MAX_PUMP_PULSE_EVENTS = 5;
+// Max number of pump pulse events sent in a single mailbox response
+const size_t MAILBOX_MAX_EVENTS = 6;
+// JSON document capacity of a full mailbox response: 7 root members and an array of events
+// with 5 members each
+const size_t MAILBOX_JSON_CAPACITY = JSON_OBJECT_SIZE(7) + JSON_ARRAY_SIZE(MAILBOX_MAX_EVENTS)
+    + MAILBOX_MAX_EVENTS * JSON_OBJECT_SIZE(5);
+// Max length of a serialized mailbox response; every number at its widest
+// ('{"seq":4294967295,"time":4294967295,"type":3,"len":4294967295,"interrupt":false},' is 81
+// characters)
+const size_t MAILBOX_JSON_MAX_LENGTH = 128 + MAILBOX_MAX_EVENTS * 96;
+
+// Interval between pH sensor samples in milliseconds
+const unsigned long PH_SAMPLE_INTERVAL = 50;
+// Number of ADC reads averaged into one pH sample
+const int PH_OVERSAMPLE = 8;
+// Right shift of the pH moving average; each sample is weighted by 1/8
+const int PH_EMA_SHIFT = 3;
+// Millivolts of a full scale ADC read. This is the scale of read_voltage() of the pH library
+// on the ESP8266 (analogRead() / 1024 * 5000), which the calibration points in EEPROM were
+// captured with, so it must not change without recalibrating.
+const long PH_ADC_MV = 5000;
+// ADC resolution of the ESP8266 in bits
+const int PH_ADC_BITS = 10;
 
 //---------------------
 // Global variables
@@ -179,13 +242,6 @@ struct Settings settings {
   .refillDoseLength = 60,     // 60 seconds
 };
 
-// Details for some settings values
-struct SettingDetails settingsDetails[] = {
-  {"phCheckInterval", ULONG, true, PH_CHECK_INTERVAL_MIN, PH_CHECK_INTERVAL_MAX, (void *)&settings.phCheckInterval},
-  {"phPumpDoseLength", ULONG, true, PH_PUMP_DOSE_LENGTH_MIN, PH_PUMP_DOSE_LENGTH_MAX, (void *)&settings.phPumpDoseLength},
-  {"refillDoseLength", ULONG, true, 5, 70, (void *)&settings.refillDoseLength}
-};
-
 // Atlas pH Sensor
 Gravity_pH pH = Gravity_pH(A0);
 
@@ -207,88 +263,27 @@ unsigned long lastDisable = 0;
 bool systemEnabled = true;
 bool statusDisplayEnabled = false;
 
-// Buffer of recent pump pulse events
-// TODO: Add a fallback in case the buffer fills up
-struct PumpPulseEvent recentPumpPulses[MAX_PUMP_PULSE_EVENTS];
-size_t numPulseEvents = 0;
+// Ring buffer of recent pump pulse events
+struct PumpEventRing pumpEvents = {
+  .events = {},
+  .head = 1,
+  .tail = 1,
+  .dropped = 0
+};
 
-//---------------------
-// HTML files
-//---------------------
+// Pump pulse in progress; only one pump can be pulsed at a time
+struct PumpPulse activePulse = {0};
+// ID of the next pump pulse; 0 is never used so it can signal a failed pulse
+unsigned long nextPulseId = 1;
+
+// pH sensor filter and its latest filtered value in centi-pH, also formatted with two decimals
+struct PhFilter phFilter = {0};
+long filteredPhCenti = 0;
+char filteredPhText[8] = "0.00";
+unsigned long lastPhSample = 0;
 
-// HTML
-const String readForm = "<!DOCTYPE html>\
-<html>\
-<head>\
-    <title>Current pH</title>\
-</head>\
-<body>\
-    <h1>Current pH</h1>\
-    <h2>%s</h2>\
-    <p>%3.2f pH</p>\
-</body>\
-</html>";
-const String autoPulseForm = "<!DOCTYPE html>\
-<html>\
-<head>\
-    <title>Auto Pulse pH</title>\
-</head>\
-<body>\
-    <form method=\"post\" action=\"api/auto_pulse\">\
-        <button type=\"submit\">Auto Pulse</button>\
-    </form>\
-</body>\
-</html>";
-const String pulseForm = "<!DOCTYPE html>\
-<html>\
-<head>\
-    <title>Pulse pH</title>\
-</head>\
-<body>\
-    <form method=\"post\" action=\"api/pulse\">\
-        <label for=\"pump\">pH Up/Down:</label>\
-        <select id=\"pump\" name=\"pump\">\
-            <option value=\"1\">pH Down</option>\
-            <option value=\"2\">pH Up</option>\
-        </select>\
-        <br>\
-        <label for=\"pulseLen\">Legnth of pulse in milliseconds:</label>\
-        <input type=\"number\" id=\"pulseLen\" name=\"pulseLen\" value=\"%lu\" min=\"%lu\" max=\"%lu\" required>\
-        <br>\
-        <button type=\"submit\">Pulse</button>\
-    </form>\
-</body>\
-</html>";
-const String settingsForm = "<!DOCTYPE html>\
-<html>\
-<head>\
-    <title>Settings</title>\
-</head>\
-<body>\
-    <form method=\"post\" action=\"api/write_settings\">\
-        <label for=\"autoPh\">Auto pH (default: %s) :</label>\
-        <input type=\"checkbox\" id=\"autoPh\" name=\"autoPh\" %s>\
-        <br>\
-        <label for=\"refillMode\">Circulate Reservoir (default: %s) :</label>\
-        <input type=\"checkbox\" id=\"refillMode\" name=\"refillMode\" %s>\
-        <br>\
-        <label for=\"phCheckInterval\">phCheckInterval (default: %lu) :</label>\
-        <input type=\"number\" id=\"phCheckInterval\" name=\"phCheckInterval\" value=\"%lu\" min=\"%lu\" max=\"%lu\">\
-        <br>\
-        <label for=\"phPumpDoseLength\">phPumpDoseLength (default: %lu) :</label>\
-        <input type=\"number\" id=\"phPumpDoseLength\" name=\"phPumpDoseLength\" value=\"%lu\" min=\"%lu\" max=\"%lu\">\
-        <br>\
-        <label for=\"refillDoseLength\">refillDoseLength (default: %lu) :</label>\
-        <input type=\"number\" id=\"refillDoseLength\" name=\"refillDoseLength\" value=\"%lu\" min=\"%lu\" max=\"%lu\">\
-        <br>\
-        <button type=\"submit\">Submit Settings</button>\
-        <br>\
-    </form>\
-    <form action=\"/api/save_settings\" method=\"post\">\
-        <button type=\"submit\">Save Settings as Default</button>\
-    </form>\
-</body>\
-</html>";
+// Latched by the overflow sensor interrupt; cleared in `loop()` once the sensor is no longer set
+volatile bool overflowFault = false;
 
 //---------------------
 // Settings functions
@@ -307,13 +302,22 @@ bool settingsRefillModeIsValid(enum RefillPumpMode refillMode) {
 
 // Returns true if `settings` is valid
 bool settingsIsValid(struct Settings checkSettings) {
+#define SETTING_IS_OUT_OF_RANGE(member, min, max) || isOutOfRange(checkSettings.member, min, max)
   return (!(checkSettings.magic != SETTINGS_MAGIC
       || checkSettings.version != SETTINGS_VERSION
-      || isOutOfRange(checkSettings.phCheckInterval, settingsDetails[0].min_range, settingsDetails[0].max_range)
-      || isOutOfRange(checkSettings.phPumpDoseLength, settingsDetails[1].min_range, settingsDetails[1].max_range)
-      || isOutOfRange(checkSettings.refillDoseLength, settingsDetails[2].min_range, settingsDetails[2].max_range)
-      || !settingsRefillModeIsValid(settings.refillMode)
+      SETTINGS_RANGES(SETTING_IS_OUT_OF_RANGE)
+      || !settingsRefillModeIsValid(checkSettings.refillMode)
       || checkSettings.crc32 != crc32((uint8_t *)&checkSettings, sizeof(checkSettings) - sizeof(uint32_t))));
+#undef SETTING_IS_OUT_OF_RANGE
+}
+
+// Adds every setting of `s` to `json`
+void settingsToJson(JsonObject json, const struct Settings &s) {
+  json["autoPh"] = s.autoPh;
+  json["refillMode"] = s.refillMode;
+#define SETTING_TO_JSON(member, min, max) json[#member] = s.member;
+  SETTINGS_RANGES(SETTING_TO_JSON)
+#undef SETTING_TO_JSON
 }
 
 // Returns true if the value is out of range
@@ -321,94 +325,280 @@ bool isOutOfRange(unsigned long value, unsigned long valMin, unsigned long valMa
   return (value < valMin || value > valMax);
 }
 
+//---------------------
+// Pump event functions
+//---------------------
+
+// Stores a copy of `event` in the ring and sets its sequence number.
+// Returns false if the ring is full and the event was dropped.
+bool pumpEventPush(struct PumpPulseEvent *event) {
+  if (pumpEvents.head - pumpEvents.tail >= PUMP_EVENT_RING_SIZE) {
+    pumpEvents.dropped += 1;
+    return false;
+  }
+
+  event->seq = pumpEvents.head;
+  pumpEvents.events[pumpEvents.head % PUMP_EVENT_RING_SIZE] = *event;
+  pumpEvents.head += 1;
+  return true;
+}
+
+// Returns the event with sequence number `seq`, or NULL if it was released or does not exist yet
+struct PumpPulseEvent *pumpEventGet(unsigned long seq) {
+  if (seq - pumpEvents.tail >= pumpEvents.head - pumpEvents.tail) {
+    return NULL;
+  }
+  return &pumpEvents.events[seq % PUMP_EVENT_RING_SIZE];
+}
+
+// Releases all events with a sequence number less than `seq`
+void pumpEventRelease(unsigned long seq) {
+  if (seq - pumpEvents.tail > pumpEvents.head - pumpEvents.tail) {
+    return;
+  }
+  pumpEvents.tail = seq;
+}
+
+//---------------------
+// pH sensor functions
+//---------------------
+
+// Median of the filled part of the pH filter window
+long phFilterMedian() {
+  long sorted[PH_MEDIAN_SIZE];
+  for (size_t i = 0; i < phFilter.count; ++i) {
+    long value = phFilter.window[i];
+    size_t j = i;
+    while (j > 0 && sorted[j - 1] > value) {
+      sorted[j] = sorted[j - 1];
+      --j;
+    }
+    sorted[j] = value;
+  }
+
+  return sorted[phFilter.count / 2];
+}
+
+// Take a new filtered pH sample
+void samplePh() {
+  // Oversample
+  long sum = 0;
+  for (int i = 0; i < PH_OVERSAMPLE; ++i) {
+    sum += analogRead(A0);
+  }
+  long sample = (sum + PH_OVERSAMPLE / 2) / PH_OVERSAMPLE;
+
+  // Reject spikes
+  phFilter.window[phFilter.index] = sample;
+  phFilter.index = (phFilter.index + 1) % PH_MEDIAN_SIZE;
+  if (phFilter.count < PH_MEDIAN_SIZE) {
+    ++phFilter.count;
+  }
+  long median = phFilterMedian();
+
+  // Smooth; the first sample primes the average so it does not ramp up from 0
+  if (!phFilter.primed) {
+    phFilter.ema = median << PH_EMA_SHIFT;
+    phFilter.primed = true;
+  } else {
+    phFilter.ema += median - (phFilter.ema >> PH_EMA_SHIFT);
+  }
+
+  // Convert the scaled average to millivolts, then to centi-pH. The calibration is owned by
+  // the pH library, so this is the only float math, and it runs once per sample instead of
+  // once per request.
+  long millivolts = (phFilter.ema * PH_ADC_MV) >> (PH_ADC_BITS + PH_EMA_SHIFT);
+  long centiPh = (long)(pH.read_ph((float)millivolts) * 100.0f + 0.5f);
+  filteredPhCenti = constrain(centiPh, 0, 1400);
+
+  // Format once so JSON responses can use the exact two-decimal text
+  snprintf(filteredPhText, sizeof(filteredPhText), "%ld.%02ld", filteredPhCenti / 100, filteredPhCenti % 100);
+}
+
+// Take a new pH sample if the sample interval passed
+void updatePhSample() {
+  if (millis() - lastPhSample < PH_SAMPLE_INTERVAL) {
+    return;
+  }
+  lastPhSample = millis();
+
+  samplePh();
+}
+
+// Latest filtered pH value in centi-pH
+long readPhCenti() {
+  return filteredPhCenti;
+}
+
+// Latest filtered pH value as text with two decimals
+const char *readPhText() {
+  return filteredPhText;
+}
+
 //---------------------
 // Pump control functions
 //---------------------
 
-// Pulse one of the pumps for `len` milliseconds
-void pulsePump(int pump, unsigned long len) {
+// Start pulsing one of the pumps for `len` milliseconds.
+// The pulse is stopped by `updatePumpPulse()`, which must be polled from `loop()`.
+// Returns the ID of the started pulse, or 0 if the pulse could not be started.
+unsigned long startPumpPulse(int pump, unsigned long len) {
   // Ensure the pump is a ph pump
   if (!(pump == PUMP_PH_UP || pump == PUMP_PH_DOWN)) {
-    return;
+    return 0;
   }
 
   // Ensure the system is not disabled and overflow sensor is not set
-  if (!systemEnabled || digitalRead(OVERFLOW_SENSOR) == HIGH) {
-    return;
+  if (!systemEnabled || overflowFault) {
+    return 0;
+  }
+
+  // Ensure another pulse is not already in progress
+  if (activePulse.active) {
+    return 0;
   }
 
-  bool interrupted = false;
-  
   digitalWrite(pump, LOW);
-  unsigned long i;
-  for (i = 0; i < len; ++i) {
-    // Disable pump if about to overflow
-    if (digitalRead(OVERFLOW_SENSOR) == HIGH) {
-      digitalWrite(pump, HIGH);
-      interrupted = true;
-      break;
-    }
-    delay(1);
+  activePulse.active = true;
+  activePulse.pump = pump;
+  activePulse.id = nextPulseId;
+  activePulse.startMillis = millis();
+  activePulse.length = len;
+
+  nextPulseId += 1;
+  if (nextPulseId == 0) {
+    nextPulseId = 1;
   }
-  digitalWrite(pump, HIGH);
 
-  // Add to event buffer
+  return activePulse.id;
+}
+
+// Stop the pulse in progress and record it as an event
+void finishPumpPulse(unsigned long length, bool interrupted) {
+  digitalWrite(activePulse.pump, HIGH);
+  activePulse.active = false;
+
+  // Add to event ring
   struct PumpPulseEvent pulseEvent = {
+    .seq = 0,
     .timestamp = timeClient.getEpochTime(),
-    .type = (pump == PUMP_PH_DOWN) ? PH_DOWN : PH_UP,
-    .length = i,
+    .type = (activePulse.pump == PUMP_PH_DOWN) ? PH_DOWN : PH_UP,
+    .length = length,
     .interrupted = interrupted
   };
 
-  if (numPulseEvents < MAX_PUMP_PULSE_EVENTS) {
-    recentPumpPulses[numPulseEvents] = pulseEvent;
-    numPulseEvents += 1;
+  if (!pumpEventPush(&pulseEvent)) {
+    Serial.println("Pump event ring is full; dropped event");
   }
 
   // LOGGER
   Serial.print(timeClient.getFormattedTime());
   Serial.print(", pulse ");
-  if (pump == PUMP_PH_UP) {
+  if (activePulse.pump == PUMP_PH_UP) {
     Serial.print("up ");
   } else {
     Serial.print("down ");
   }
-  Serial.print(settings.phPumpDoseLength);
-  Serial.println(" ms");
+  Serial.print(length);
+  Serial.print(" ms");
+  Serial.println(interrupted ? " (interrupted)" : "");
+}
+
+// Stop the pulse in progress once it has run for its full length, or early if the
+// overflow sensor is set or the system was disabled
+void updatePumpPulse() {
+  if (!activePulse.active) {
+    return;
+  }
+
+  unsigned long elapsed = millis() - activePulse.startMillis;
+  if (overflowFault || !systemEnabled) {
+    finishPumpPulse(min(elapsed, activePulse.length), true);
+  } else if (elapsed >= activePulse.length) {
+    finishPumpPulse(activePulse.length, false);
+  }
+}
+
+// Overflow sensor interrupt; turns off all pumps as soon as the sensor is set,
+// no matter what `loop()` is currently doing
+void IRAM_ATTR handleOverflowInterrupt() {
+  digitalWrite(PUMP0, HIGH);
+  digitalWrite(PUMP1, HIGH);
+  digitalWrite(PUMP2, HIGH);
+  overflowFault = true;
+}
+
+// Clear the overflow fault once the overflow sensor is no longer set
+void updateOverflowFault() {
+  if (!overflowFault) {
+    return;
+  }
+
+  // Clear before reading the sensor so an interrupt in between is not lost
+  overflowFault = false;
+  if (digitalRead(OVERFLOW_SENSOR) == HIGH) {
+    overflowFault = true;
+    return;
+  }
+
+  // Restart the refill pump if it circulates
+  digitalWrite(PUMP_REFILL, !(systemEnabled && !overflowFault && settings.autoPh && settings.refillMode == REFILL_CIRCULATE));
+
+  // LOGGER
+  Serial.print(timeClient.getFormattedTime());
+  Serial.println(", overflow sensor cleared");
 }
 
 // Pulse one of the pH pumps for `phPumpDoseLength` milliseconds
-void pulsePhPump(int pump) {
-  pulsePump(pump, settings.phPumpDoseLength); 
+unsigned long pulsePhPump(int pump) {
+  return startPumpPulse(pump, settings.phPumpDoseLength);
 }
 
 // Read the pH sensor to see if the pH is in range.
 // If not in range, pulse one of the pH pumps to get back in range.
-void bringPhInRange() {
+// Returns the ID of the started pulse, or 0 if no pulse was started.
+unsigned long bringPhInRange() {
   // Ensure the system is not disabled
   if (!systemEnabled) {
-    return;
+    return 0;
   }
 
   // Pulse with pH up or down if pH is not in range
-  float currentPh = pH.read_ph();
-  if (currentPh < MIN_PH + PH_ACC) {
-    pulsePhPump(PUMP_PH_UP);
-  } else if (currentPh > MAX_PH - PH_ACC) {
-    pulsePhPump(PUMP_PH_DOWN);
+  unsigned long pulseId = 0;
+  long currentPh = readPhCenti();
+  if (currentPh < MIN_PH_CENTI + PH_ACC_CENTI) {
+    pulseId = pulsePhPump(PUMP_PH_UP);
+  } else if (currentPh > MAX_PH_CENTI - PH_ACC_CENTI) {
+    pulseId = pulsePhPump(PUMP_PH_DOWN);
   }
 
   // LOGGER
   Serial.print(timeClient.getFormattedTime());
   Serial.print(", ");
-  Serial.print(currentPh);
+  Serial.print(readPhText());
   Serial.println("pH");
+
+  return pulseId;
 }
 
 //---------------------
 // HTTP functions
 //---------------------
 
+// Sends a gzip compressed page straight from flash. Clients revalidate the page on every
+// load and get an empty 304 response while their cached copy has the same ETag.
+void sendStaticPage(const StaticPage &page) {
+  server.sendHeader("Cache-Control", "no-cache");
+  server.sendHeader("ETag", page.etag);
+  if (server.header("If-None-Match") == page.etag) {
+    server.send(304);
+    return;
+  }
+
+  server.sendHeader("Content-Encoding", "gzip");
+  server.send_P(200, "text/html", (PGM_P)page.gzip, page.length);
+}
+
 void httpHandleUnavailable() {
   digitalWrite(LED_BUILTIN, LOW);
   server.send(503, "text/plain", "System is currently disabled.");
@@ -455,7 +645,7 @@ void httpHandleRead() {
   // Create JSON
   StaticJsonDocument<48> doc;
   doc["time"] = timeClient.getEpochTime();
-  doc["ph"] = round(pH.read_ph() * 100.0) / 100.0;
+  doc["ph"] = serialized(readPhText());
   
   // Send JSON to client
   char buffer[64 + 1];
@@ -480,21 +670,11 @@ void httpFormRead() {
   
   digitalWrite(LED_BUILTIN, LOW);
 
-  // Send HTML to client
-  StreamString temp;
-  temp.reserve(500);
-  temp.printf(readForm.c_str(), timeClient.getFormattedTime(), round(pH.read_ph() * 100.0) / 100.0);
-  server.send(200, "text/html", temp.c_str());
-
-  // Create JSON
-  StaticJsonDocument<48> doc;
-  doc["time"] = timeClient.getEpochTime();
-  doc["ph"] = round(pH.read_ph() * 100.0) / 100.0;
+  // Send HTML to client; the page fetches the reading from '/api/read'
+  sendStaticPage(PAGE_READ);
 
   // LOGGER
-  Serial.print("/read: ");
-  serializeJson(doc, Serial);
-  Serial.println();
+  Serial.println("/read");
   
   digitalWrite(LED_BUILTIN, HIGH);
 }
@@ -509,18 +689,19 @@ void httpHandleSettings() {
   
   digitalWrite(LED_BUILTIN, LOW);
 
+  // Get default settings from EEPROM
+  struct Settings defaultSettings;
+  EEPROM.get(EEPROM_START, defaultSettings);
+
   // Create JSON
-  StaticJsonDocument<128> doc;
+  StaticJsonDocument<256> doc;
   doc["time"] = timeClient.getEpochTime();
-  doc["autoPh"] = settings.autoPh;
-  doc["refillMode"] = settings.refillMode;
-  doc["phCheckInterval"] = settings.phCheckInterval;
-  doc["phPumpDoseLength"] = settings.phPumpDoseLength;
-  doc["refillDoseLength"] = settings.refillDoseLength;
+  settingsToJson(doc.as<JsonObject>(), settings);
+  settingsToJson(doc.createNestedObject("defaults"), defaultSettings);
 
   // Send JSON to client
-  char buffer[256 + 1];
-  serializeJson(doc, &buffer, 256);
+  char buffer[384 + 1];
+  serializeJson(doc, &buffer, 384);
   server.send(200, "application/json", buffer);
 
   // LOGGER
@@ -541,32 +722,8 @@ void httpFormSettings() {
   
   digitalWrite(LED_BUILTIN, LOW);
 
-  // Get default settings from EEPROM
-  struct Settings defaultSettings;
-  EEPROM.get(EEPROM_START, defaultSettings);
-
-  // Send HTML to client
-  StreamString temp;
-  temp.reserve(500);
-  temp.printf(settingsForm.c_str(),
-    defaultSettings.autoPh ? "true" : "false",
-    settings.autoPh ? "checked" : "",
-    (defaultSettings.refillMode == REFILL_CIRCULATE) ? "true" : "false",
-    (settings.refillMode == REFILL_CIRCULATE) ? "checked" : "",
-    defaultSettings.phCheckInterval,
-    settings.phCheckInterval,
-    PH_CHECK_INTERVAL_MIN,
-    PH_CHECK_INTERVAL_MAX,
-    defaultSettings.phPumpDoseLength,
-    settings.phPumpDoseLength,
-    PH_PUMP_DOSE_LENGTH_MIN,
-    PH_PUMP_DOSE_LENGTH_MAX,
-    defaultSettings.refillDoseLength,
-    settings.refillDoseLength,
-    REFILL_DOSE_LENGTH_MIN,
-    REFILL_DOSE_LENGTH_MAX
-  );
-  server.send(200, "text/html", temp.c_str());
+  // Send HTML to client; the page fetches the settings from '/api/settings'
+  sendStaticPage(PAGE_SETTINGS);
 
   // LOGGER
   Serial.println("/settings");
@@ -591,11 +748,7 @@ void httpHandleSaveSettings() {
   // Create JSON
   StaticJsonDocument<256> doc;
   doc["time"] = timeClient.getEpochTime();
-  doc["autoPh"] = settings.autoPh;
-  doc["refillMode"] = settings.refillMode;
-  doc["phCheckInterval"] = settings.phCheckInterval;
-  doc["phPumpDoseLength"] = settings.phPumpDoseLength;
-  doc["refillDoseLength"] = settings.refillDoseLength;
+  settingsToJson(doc.as<JsonObject>(), settings);
 
   // Send JSON to client
   char buffer[512 + 1];
@@ -624,15 +777,12 @@ void httpHandleWriteSettings() {
   struct Settings backupSettings = settings;
 
   // Update current settings based on client request
-  for (size_t i = 0; i < sizeof(settingsDetails) / sizeof(settingsDetails[0]); ++i) {
-    if (server.hasArg(settingsDetails[i].name)) {
-      String arg = server.arg(settingsDetails[i].name);
-      if (settingsDetails[i].has_range && settingsDetails[i].type == ULONG) {
-        unsigned long value = (unsigned long)arg.toInt();
-        *(unsigned long *)settingsDetails[i].value = value;
-      }
-    }
+#define SETTING_FROM_ARG(member, min, max) \
+  if (server.hasArg(#member)) { \
+    settings.member = (unsigned long)server.arg(#member).toInt(); \
   }
+  SETTINGS_RANGES(SETTING_FROM_ARG)
+#undef SETTING_FROM_ARG
   settings.autoPh = server.hasArg("autoPh");
   settings.refillMode = server.hasArg("refillMode") ? REFILL_CIRCULATE : REFILL_OFF;
 
@@ -642,16 +792,12 @@ void httpHandleWriteSettings() {
   // Successful settings change
   if (settingsIsValid(settings)) {
     // Update refill pump state for new settings
-    digitalWrite(PUMP_REFILL, !(systemEnabled && settings.autoPh && settings.refillMode == REFILL_CIRCULATE));
+    digitalWrite(PUMP_REFILL, !(systemEnabled && !overflowFault && settings.autoPh && settings.refillMode == REFILL_CIRCULATE));
 
     // Create JSON
     StaticJsonDocument<256> doc;
     doc["time"] = timeClient.getEpochTime();
-    doc["autoPh"] = settings.autoPh;
-    doc["refillMode"] = settings.refillMode;
-    doc["phCheckInterval"] = settings.phCheckInterval;
-    doc["phPumpDoseLength"] = settings.phPumpDoseLength;
-    doc["refillDoseLength"] = settings.refillDoseLength;
+    settingsToJson(doc.as<JsonObject>(), settings);
 
     // Send JSON to client
     char buffer[512 + 1];
@@ -688,11 +834,8 @@ void httpFormPulsePump() {
   
   digitalWrite(LED_BUILTIN, LOW);
 
-  // Send HTML to client
-  StreamString temp;
-  temp.reserve(500);
-  temp.printf(pulseForm.c_str(), settings.phPumpDoseLength, PH_PUMP_DOSE_LENGTH_MIN, PH_PUMP_DOSE_LENGTH_MAX);
-  server.send(200, "text/html", temp.c_str());
+  // Send HTML to client; the page fetches the default pulse length from '/api/settings'
+  sendStaticPage(PAGE_PULSE);
 
   // LOGGER
   Serial.println("/pulse");
@@ -713,12 +856,12 @@ void httpHandleAutoPulsePump() {
   // Create JSON
   StaticJsonDocument<128> doc;
   doc["time"] = timeClient.getEpochTime();
-  doc["ph"] = round(pH.read_ph() * 100.0) / 100.0;
+  doc["ph"] = serialized(readPhText());
 
   // Ensure auto ph mode is not enabled
   if (!settings.autoPh) {
     // Send JSON to client
-    bringPhInRange();
+    doc["pulseId"] = bringPhInRange();
     char buffer[256 + 1];
     serializeJson(doc, &buffer, 256);
     server.send(200, "application/json", buffer);
@@ -745,7 +888,7 @@ void httpFormAutoPulsePump() {
   digitalWrite(LED_BUILTIN, LOW);
 
   // Send HTML to client
-  server.send(200, "text/html", autoPulseForm);
+  sendStaticPage(PAGE_AUTO_PULSE);
   
   // LOGGER
   Serial.println("/auto_pulse");
@@ -769,16 +912,21 @@ void httpHandlePulsePump() {
     doc["time"] = timeClient.getEpochTime();
     doc["pulseLen"] = (unsigned long)server.arg("pulseLen").toInt();
     doc["pump"] = server.arg("pump").toInt();
-    doc["ph"] = round(pH.read_ph() * 100.0) / 100.0;
+    doc["ph"] = serialized(readPhText());
 
     if (doc["pump"] == 1 || doc["pump"] == 2) {
       
       if (!settings.autoPh) {
-        // Pulse pump and send JSON to client
-        pulsePump((doc["pump"] == 1) ? PUMP_PH_DOWN : PUMP_PH_UP, doc["pulseLen"]);
-        char buffer[256 + 1];
-        serializeJson(doc, &buffer, 256);
-        server.send(200, "application/json", buffer);
+        // Start pulsing pump and send JSON to client; the pulse finishes in `loop()`
+        unsigned long pulseId = startPumpPulse((doc["pump"] == 1) ? PUMP_PH_DOWN : PUMP_PH_UP, doc["pulseLen"]);
+        if (pulseId != 0) {
+          doc["pulseId"] = pulseId;
+          char buffer[256 + 1];
+          serializeJson(doc, &buffer, 256);
+          server.send(200, "application/json", buffer);
+        } else {
+          server.send(500, "text/plain", "cannot pulse while another pulse is running or the overflow sensor is set");
+        }
       } else {
         server.send(500, "text/plain", "cannot pulse in auto ph mode");
       }
@@ -793,7 +941,13 @@ void httpHandlePulsePump() {
   digitalWrite(LED_BUILTIN, HIGH);
 }
 
-// Sends the client the current pH in JSON
+// Sends the client the current pH and pending pump pulse events in JSON.
+//
+// The optional `since` argument is a cursor; the client acknowledges every event up to and
+// including `since`, which releases them from the ring, and only newer events are sent.
+// The response's `seq` is the cursor to send next time. Without `since`, pending events are
+// sent but never released. A `since` that does not match any event (e.g. after a reboot)
+// is ignored and `reset` is set in the response.
 void httpHandleJsonMailbox() {
   // Ensure the system is not disabled
   if (!systemEnabled) {
@@ -804,25 +958,45 @@ void httpHandleJsonMailbox() {
   digitalWrite(LED_BUILTIN, LOW);
   
   // Create JSON
-  StaticJsonDocument<256> doc;
+  StaticJsonDocument<MAILBOX_JSON_CAPACITY> doc;
   doc["time"] = timeClient.getEpochTime();
-  doc["ph"] = round(pH.read_ph() * 100.0) / 100.0;
-  for (size_t i = 0; i < numPulseEvents; ++i) {
-    struct PumpPulseEvent *event = &recentPumpPulses[i];
+  doc["ph"] = serialized(readPhText());
+  doc["dropped"] = pumpEvents.dropped;
+
+  // Release acknowledged events
+  unsigned long seq = pumpEvents.tail;
+  bool reset = false;
+  if (server.hasArg("since")) {
+    unsigned long since = strtoul(server.arg("since").c_str(), NULL, 10);
+    if (since + 1 - pumpEvents.tail <= pumpEvents.head - pumpEvents.tail) {
+      pumpEventRelease(since + 1);
+      seq = since + 1;
+    } else {
+      reset = true;
+    }
+  }
+  doc["reset"] = reset;
+
+  // Send at most `MAILBOX_MAX_EVENTS` events; the rest are sent in the next response
+  for (size_t i = 0; i < MAILBOX_MAX_EVENTS; ++i, ++seq) {
+    struct PumpPulseEvent *event = pumpEventGet(seq);
+    if (event == NULL) {
+      break;
+    }
+    doc["pulse_events"][i]["seq"] = event->seq;
     doc["pulse_events"][i]["time"] = event->timestamp;
     doc["pulse_events"][i]["type"] = event->type;
     doc["pulse_events"][i]["len"] = event->length;
     doc["pulse_events"][i]["interrupt"] = event->interrupted;
   }
+  doc["seq"] = seq - 1;
+  doc["more"] = pumpEventGet(seq) != NULL;
   
   // Send JSON to client
-  char buffer[256 + 1];
-  serializeJson(doc, &buffer, 256);
+  char buffer[MAILBOX_JSON_MAX_LENGTH + 1];
+  serializeJson(doc, buffer, sizeof(buffer));
   server.send(200, "application/json", buffer);
 
-  // Clear buffer of recent events
-  numPulseEvents = 0;
-
   // LOGGER
   Serial.print("/json/mailbox.json: ");
   serializeJson(doc, Serial);
@@ -870,7 +1044,7 @@ void httpHandleJsonMailbox() {
 //  display.setCursor(37, 20);
 //  display.print("CIRCULATE");
 //
-//  displayReadings(pH.read_ph(), 0); // TODO: Display ppm when available
+//  displayReadings(readPhCenti(), 0); // TODO: Display ppm when available
 //  displaySettings();
 //
 //  display.display();
@@ -933,6 +1107,9 @@ void setup() {
     Serial.print(timeClient.getFormattedTime());
     Serial.println(", pH meter failed to setup");
   }
+
+  // Prime the pH filter so the first requests get a valid reading
+  samplePh();
   
   // Setup pump pins
   pinMode(PUMP0, OUTPUT);
@@ -942,8 +1119,13 @@ void setup() {
   pinMode(PUMP2, OUTPUT);
   digitalWrite(PUMP2, HIGH);
 
-  // Setup float sensor pins
+  // Setup float sensor pins; the interrupt does not fire if the sensor is already set,
+  // so the fault is latched here as well
   pinMode(OVERFLOW_SENSOR, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(OVERFLOW_SENSOR), handleOverflowInterrupt, RISING);
+  if (digitalRead(OVERFLOW_SENSOR) == HIGH) {
+    handleOverflowInterrupt();
+  }
 
   // Setup buttons
   pinMode(DISABLE_BUTTON, INPUT_PULLUP);
@@ -974,6 +1156,8 @@ void setup() {
   server.on("/api/auto_pulse", HTTP_POST, httpHandleAutoPulsePump);
   server.on("/json/mailbox.json", HTTP_GET, httpHandleJsonMailbox);
   server.onNotFound(httpHandleNotFound);
+  const char *collectedHeaders[] = {"If-None-Match"};
+  server.collectHeaders(collectedHeaders, 1);
   server.begin();
   Serial.print(timeClient.getFormattedTime());
   Serial.println(", HTTP server started");
@@ -1001,11 +1185,7 @@ void setup() {
   // Print out loaded settings to serial
   StaticJsonDocument<256> doc;
   doc["time"] = timeClient.getEpochTime();
-  doc["autoPh"] = settings.autoPh;
-  doc["refillMode"] = settings.refillMode;
-  doc["phCheckInterval"] = settings.phCheckInterval;
-  doc["phPumpDoseLength"] = settings.phPumpDoseLength;
-  doc["refillDoseLength"] = settings.refillDoseLength;
+  settingsToJson(doc.as<JsonObject>(), settings);
   serializeJson(doc, Serial);
   Serial.println();
 
@@ -1044,7 +1224,7 @@ void loop() {
     digitalWrite(DISABLED_LED, !systemEnabled);
 
     // Update refill pump
-    digitalWrite(PUMP_REFILL, !(systemEnabled && settings.autoPh && settings.refillMode == REFILL_CIRCULATE));
+    digitalWrite(PUMP_REFILL, !(systemEnabled && !overflowFault && settings.autoPh && settings.refillMode == REFILL_CIRCULATE));
 
     // LOGGER
     Serial.print(timeClient.getFormattedTime());
@@ -1052,12 +1232,15 @@ void loop() {
     Serial.println((systemEnabled) ? "ENABLED" : "DISABLED");
   }
 
-  // Disable pumps if overflow sensor is set
-  if (digitalRead(OVERFLOW_SENSOR) == HIGH) {
-    digitalWrite(PUMP0, HIGH);
-    digitalWrite(PUMP1, HIGH);
-    digitalWrite(PUMP2, HIGH);
-  } else if (systemEnabled && settings.autoPh && currentTime - lastPhCheck > settings.phCheckInterval) {
+  // Keep the filtered pH up to date
+  updatePhSample();
+
+  // Stop the pump pulse in progress if it is finished or interrupted
+  updatePumpPulse();
+
+  // Pumps are turned off by the overflow interrupt; pH is not stabilized until the sensor clears
+  updateOverflowFault();
+  if (!overflowFault && systemEnabled && settings.autoPh && currentTime - lastPhCheck > settings.phCheckInterval) {
     // Ensure ph is in range
     lastPhCheck = currentTime;
 
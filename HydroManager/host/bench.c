@@ -0,0 +1,340 @@
+// Benchmarks of the sampling and control code, run off-target with mocked devices.
+//
+// Usage: hydro_bench [TRACE_CSV]
+//
+// Every result is printed as `name value unit` on its own line. The run fails if the pH
+// dosing controller does not converge in one of its scenarios, or if a dosing or size
+// result is over its budget. Speed results are only reported, since they depend on the
+// host.
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "event_ring.h"
+#include "hydro_json.h"
+#include "json_writer.h"
+#include "mock_devices.h"
+#include "sensor_math.h"
+#include "settings_store.h"
+#include "sim.h"
+#include "telemetry.h"
+
+// Trace replayed when no trace is given; set by CMakeLists.txt
+#ifndef HOST_DEFAULT_TRACE
+#define HOST_DEFAULT_TRACE "traces/reservoir_6h.csv"
+#endif
+
+#define PIPELINE_SAMPLES 200000
+#define JSON_MESSAGES 1000000
+#define EVENT_RING_EVENTS 10000000
+
+// Largest sizes in bytes of a live channel reading and of a JSON events page
+#define JSON_READING_SIZE_BUDGET 96
+#define JSON_EVENTS_PAGE_SIZE_BUDGET 1400
+
+// Longest simulated time that the dosing controller may take to converge
+#define CONVERGENCE_TIMEOUT_US (48LL * 60 * 60 * 1000 * 1000)
+
+// The pH must stay in the target range of auto pH mode this long for the controller to have
+// converged
+#define CONVERGENCE_HOLD_US (2LL * 60 * 60 * 1000 * 1000)
+
+// Set when a result is over its budget
+static bool g_over_budget = false;
+
+static double elapsed_ns(const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+}
+
+static void report(const char *name, double value, const char *unit) {
+    printf("%-32s %12.2f %s\n", name, value, unit);
+    fflush(stdout);
+}
+
+// Reports a result that fails the run if it is over `budget`
+static void report_budget(const char *name, double value, double budget, const char *unit) {
+    report(name, value, unit);
+    if (value > budget) {
+        fprintf(stderr, "%s: %.2f %s is over the budget of %.2f %s\n", name, value, unit,
+                budget, unit);
+        g_over_budget = true;
+    }
+}
+
+// Filters, converts and publishes samples of a replayed trace
+static void bench_pipeline(const struct SensorTrace *trace) {
+    struct MockDevices dev;
+    mock_devices_init(&dev, trace, NULL, &DEFAULT_PH_CALIBRATION);
+    struct Simulation sim;
+    sim_init(&sim, mock_devices_hal(&dev), &DEFAULT_PH_CALIBRATION, &DEFAULT_SYSTEM_SETTINGS);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct SensorReading reading;
+    uint32_t published = 0;
+    for (uint32_t i = 0; i < PIPELINE_SAMPLES; ++i) {
+        int64_t now_us = (int64_t)i * SIM_SAMPLE_INTERVAL * 1000;
+        mock_devices_advance(&dev, now_us);
+        sim.now_us = now_us;
+        published += sim_sample(&sim, &reading);
+        sensor_snapshot_read(&sim.snapshot, &reading);
+    }
+    double ns = elapsed_ns(&start);
+
+    report("pipeline_sample", ns / PIPELINE_SAMPLES, "ns/sample");
+    report("pipeline_conversion", ns / PIPELINE_SAMPLES
+            / (SENSOR_ADC_NUM_CHANNELS * CONFIG_HYDRO_MANAGER_FILTER_OVERSAMPLE), "ns/conversion");
+    if (published == 0) {
+        fprintf(stderr, "pipeline: no reading was published\n");
+    }
+}
+
+// Counts the bytes of chunks that would be sent
+static int json_count_flush(void *ctx, const char *data, size_t len) {
+    *(uint64_t *)ctx += len;
+    return 0;
+}
+
+// Serializes readings like the live channel, and events pages like /api/events.json
+static void bench_json() {
+    char buf[HTTP_JSON_BUFFER_SIZE];
+    struct JsonWriter w;
+    struct SensorReading reading = {
+        .timestamp = 1700000000,
+        .ph_centi = 612,
+        .temp_centi = 2150,
+        .humidity_centi = 5512,
+        .tds = 812,
+    };
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < JSON_MESSAGES; ++i) {
+        reading.timestamp += 1;
+        json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+        json_object_begin(&w);
+        json_add_string(&w, "type", "reading");
+        hydro_json_add_reading(&w, &reading);
+        json_object_end(&w);
+        bytes += w.len;
+    }
+    double ns = elapsed_ns(&start);
+    report("json_reading", ns / JSON_MESSAGES, "ns/message");
+    report_budget("json_reading_size", (double)bytes / JSON_MESSAGES, JSON_READING_SIZE_BUDGET,
+            "bytes/message");
+    report("json_reading_throughput", bytes / (ns / 1e9) / 1e6, "MB/s");
+
+    struct PumpPulseEvent event = {
+        .timestamp = 1700000000,
+        .pulse_length = 1500,
+        .pump_id = PUMP_ID_PH_DOWN,
+        .was_automatic = true,
+    };
+    uint32_t pages = JSON_MESSAGES / EVENTS_PAGE_SIZE;
+    bytes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < pages; ++i) {
+        json_writer_init(&w, buf, sizeof(buf), json_count_flush, &bytes);
+        json_object_begin(&w);
+        json_add_int(&w, "time", event.timestamp);
+        json_key(&w, "pulse_events");
+        json_array_begin(&w);
+        for (uint32_t j = 0; j < EVENTS_PAGE_SIZE; ++j) {
+            event.seq += 1;
+            json_object_begin(&w);
+            hydro_json_add_pulse_event(&w, &event, "type");
+            json_object_end(&w);
+        }
+        json_array_end(&w);
+        json_object_end(&w);
+        json_writer_flush(&w);
+    }
+    ns = elapsed_ns(&start);
+    report("json_events_page", ns / pages, "ns/page");
+    report_budget("json_events_page_size", (double)bytes / pages, JSON_EVENTS_PAGE_SIZE_BUDGET,
+            "bytes/page");
+    report("json_events_throughput", bytes / (ns / 1e9) / 1e6, "MB/s");
+}
+
+// Builds push frames like the telemetry task, and events pages like /api/telemetry
+static void bench_telemetry() {
+    uint8_t buf[TELEMETRY_MAX_FRAME_SIZE];
+    struct TelemetryFrame frame;
+    struct SensorReading reading = {
+        .timestamp = 1700000000,
+        .ph_centi = 612,
+        .temp_centi = 2150,
+        .humidity_centi = 5512,
+        .tds = 812,
+    };
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < JSON_MESSAGES; ++i) {
+        reading.timestamp += 1;
+        telemetry_frame_begin(&frame, buf, reading.timestamp, &reading, 0, 1);
+        bytes += telemetry_frame_end(&frame, i, 0);
+    }
+    double ns = elapsed_ns(&start);
+    report("telemetry_reading", ns / JSON_MESSAGES, "ns/frame");
+    report_budget("telemetry_reading_size", (double)bytes / JSON_MESSAGES,
+            TELEMETRY_FRAME_SIZE(0), "bytes/frame");
+
+    struct PumpPulseEvent event = {
+        .timestamp = 1700000000,
+        .pulse_length = 1500,
+        .pump_id = PUMP_ID_PH_DOWN,
+        .was_automatic = true,
+    };
+    uint32_t pages = JSON_MESSAGES / EVENTS_PAGE_SIZE;
+    bytes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < pages; ++i) {
+        telemetry_frame_begin(&frame, buf, event.timestamp, &reading, 0, 1);
+        for (uint32_t j = 0; j < EVENTS_PAGE_SIZE; ++j) {
+            event.seq += 1;
+            telemetry_frame_add_event(&frame, &event);
+        }
+        bytes += telemetry_frame_end(&frame, event.seq, 0);
+    }
+    ns = elapsed_ns(&start);
+    report("telemetry_events_page", ns / pages, "ns/page");
+    report_budget("telemetry_events_page_size", (double)bytes / pages,
+            TELEMETRY_FRAME_SIZE(EVENTS_PAGE_SIZE), "bytes/page");
+}
+
+static struct EventRing g_ring;
+
+// Consumer of the event ring benchmark; gets and releases every event like the events
+// endpoint
+static void *event_ring_consumer(void *arg) {
+    uint32_t seq = 1;
+    struct PumpPulseEvent event;
+    while (seq <= EVENT_RING_EVENTS) {
+        if (event_ring_get(&g_ring, seq, &event)) {
+            event_ring_release(&g_ring, ++seq);
+        } else {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+// Passes events from a producer thread to a consumer thread, like the system control task
+// and the HTTP server task on separate cores
+static void bench_event_ring() {
+    event_ring_init(&g_ring);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_t consumer;
+    pthread_create(&consumer, NULL, event_ring_consumer, NULL);
+
+    // Both threads yield while they wait, so the benchmark also runs on a single core
+    for (uint32_t i = 1; i <= EVENT_RING_EVENTS; ) {
+        struct PumpPulseEvent event = {
+            .pulse_length = i,
+        };
+        if (event_ring_push(&g_ring, &event)) {
+            ++i;
+        } else {
+            sched_yield();
+        }
+    }
+    pthread_join(consumer, NULL);
+    double ns = elapsed_ns(&start);
+
+    report("event_ring", ns / EVENT_RING_EVENTS, "ns/event");
+    report("event_ring_throughput", EVENT_RING_EVENTS / (ns / 1e9) / 1e6, "Mevents/s");
+}
+
+struct ConvergenceScenario {
+    const char *name;
+    struct Reservoir reservoir;
+    // Most minutes and doses the controller may take to converge
+    double converge_budget;
+    uint32_t doses_budget;
+};
+
+// Runs the dosing controller against a reservoir model until the pH has stayed in the
+// target range for CONVERGENCE_HOLD_US. Returns false if it did not converge.
+static bool bench_convergence(const struct ConvergenceScenario *scenario) {
+    struct Reservoir reservoir = scenario->reservoir;
+    struct MockDevices dev;
+    mock_devices_init(&dev, NULL, &reservoir, &DEFAULT_PH_CALIBRATION);
+    struct Simulation sim;
+    sim_init(&sim, mock_devices_hal(&dev), &DEFAULT_PH_CALIBRATION, &DEFAULT_SYSTEM_SETTINGS);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int64_t in_range_since = -1;
+    int64_t now_us = 0;
+    while (now_us < CONVERGENCE_TIMEOUT_US) {
+        mock_devices_advance(&dev, now_us);
+        if (sim_run_due(&sim, now_us)) {
+            struct SensorReading reading;
+            sensor_snapshot_read(&sim.snapshot, &reading);
+            bool in_range = reading.ph_centi >= PH_TARGET_MIN_CENTI
+                && reading.ph_centi <= PH_TARGET_MAX_CENTI;
+            if (!in_range) {
+                in_range_since = -1;
+            } else if (in_range_since < 0) {
+                in_range_since = now_us;
+            } else if (now_us - in_range_since >= CONVERGENCE_HOLD_US) {
+                break;
+            }
+        }
+        now_us = sim_next_deadline(&sim);
+    }
+    double ns = elapsed_ns(&start);
+
+    char name[64];
+    bool converged = now_us < CONVERGENCE_TIMEOUT_US;
+    snprintf(name, sizeof(name), "dosing_%s_converge", scenario->name);
+    report_budget(name, converged ? in_range_since / 60e6 : -1.0, scenario->converge_budget,
+            "min");
+    snprintf(name, sizeof(name), "dosing_%s_doses", scenario->name);
+    report_budget(name, sim.pulse_count, scenario->doses_budget, "doses");
+    snprintf(name, sizeof(name), "dosing_%s_sim_speed", scenario->name);
+    report(name, now_us / (ns / 1e3), "x realtime");
+    return converged;
+}
+
+int main(int argc, char **argv) {
+    const char *trace_path = argc > 1 ? argv[1] : HOST_DEFAULT_TRACE;
+    struct SensorTrace trace;
+    if (!sensor_trace_load(&trace, trace_path)) {
+        fprintf(stderr, "Cannot load trace %s\n", trace_path);
+        return 1;
+    }
+
+    bench_pipeline(&trace);
+    bench_json();
+    bench_telemetry();
+    bench_event_ring();
+
+    // Gains are pH per second of dose; nutrient uptake slowly raises the pH. Budgets leave
+    // some room over the current results.
+    static const struct ConvergenceScenario scenarios[] = {
+        {"high", {.ph = 7.4, .drift_per_hour = 0.02, .gain_up = 0.08, .gain_down = 0.06,
+                     .mixing_tau_s = 60.0}, 75.0, 4},
+        {"low", {.ph = 4.8, .drift_per_hour = 0.02, .gain_up = 0.08, .gain_down = 0.06,
+                    .mixing_tau_s = 60.0}, 75.0, 3},
+        {"weak_reagent", {.ph = 7.0, .drift_per_hour = 0.05, .gain_up = 0.01, .gain_down = 0.01,
+                             .mixing_tau_s = 120.0}, 270.0, 13},
+    };
+    bool converged = true;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i) {
+        converged &= bench_convergence(&scenarios[i]);
+    }
+
+    sensor_trace_free(&trace);
+    return converged && !g_over_budget ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Hardware used by the sampling and control code, so it can run off-target.
+//
+// Each function stands in for a driver call of the firmware: ads111x_get_value after the
+// input mux is set, bmp280_read_fixed, gpio_set_level of a pump relay and gpio_get_level
+// of the overflow sensor. Time is kept by the caller and is not part of the HAL.
+struct HydroHal {
+    void *ctx;
+    // Next conversion of ADS1115 input `mux`
+    int16_t (*adc_convert)(void *ctx, int mux);
+    // Temperature in centi-degrees Celsius and humidity in %RH, scaled by 2^10
+    void (*bme280_read)(void *ctx, int32_t *temp_centi, uint32_t *humidity_q10);
+    // Turns the relay of a pump on or off; `pump_id` is a PumpId
+    void (*pump_set)(void *ctx, uint8_t pump_id, bool on);
+    // Returns true while the overflow sensor is underwater
+    bool (*overflow_read)(void *ctx);
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+// Host stand-in for the CRC32 routine of the ESP32 ROM. Like the ROM routine, `crc` is the
+// result of the previous call, or 0 for the first call.
+
+#include <stdint.h>
+
+static inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; ++i) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS headers; only the types used by the portable modules in
+// main/ are defined
+
+#include "sdkconfig.h"
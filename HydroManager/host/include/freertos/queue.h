@@ -0,0 +1,5 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS queue header
+
+typedef struct QueueDefinition *QueueHandle_t;
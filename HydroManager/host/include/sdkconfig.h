@@ -0,0 +1,10 @@
+#pragma once
+
+// Kconfig defaults of the options used by the host build; see main/Kconfig.projbuild
+
+#define CONFIG_HYDRO_MANAGER_SAMPLE_INTERVAL_MS 1000
+#define CONFIG_HYDRO_MANAGER_FILTER_OVERSAMPLE 4
+#define CONFIG_HYDRO_MANAGER_FILTER_MEDIAN_SIZE 5
+#define CONFIG_HYDRO_MANAGER_FILTER_EMA_SHIFT 2
+#define CONFIG_HYDRO_MANAGER_PH_MIXING_DELAY_S 300
+#define CONFIG_HYDRO_MANAGER_EVENT_RING_SIZE 64
@@ -0,0 +1,200 @@
+#include "mock_devices.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+// Readings of the mocked sensors without a trace
+static const struct TraceRow CONSTANT_ROW = {
+    .ph_centi = 600,
+    .tds = 800,
+    .temp_centi = 2150,
+    .humidity_centi = 5500,
+};
+
+bool sensor_trace_load(struct SensorTrace *trace, const char *path) {
+    *trace = (struct SensorTrace) {0};
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return false;
+    }
+
+    size_t cap = 0;
+    char line[128];
+    // Skip the header row
+    bool ok = fgets(line, sizeof(line), f) != NULL;
+    while (ok && fgets(line, sizeof(line), f) != NULL) {
+        double ph, temp, humidity;
+        unsigned long time_s;
+        long tds;
+        int overflow;
+        if (sscanf(line, "%lu,%lf,%ld,%lf,%lf,%d", &time_s, &ph, &tds, &temp, &humidity,
+                    &overflow) != 6) {
+            continue;
+        }
+
+        if (trace->count == cap) {
+            cap = cap ? cap * 2 : 256;
+            struct TraceRow *rows = realloc(trace->rows, cap * sizeof(struct TraceRow));
+            if (rows == NULL) {
+                ok = false;
+                break;
+            }
+            trace->rows = rows;
+        }
+        trace->rows[trace->count++] = (struct TraceRow) {
+            .time_s = (uint32_t)time_s,
+            .ph_centi = (int32_t)lround(ph * 100.0),
+            .tds = (int32_t)tds,
+            .temp_centi = (int32_t)lround(temp * 100.0),
+            .humidity_centi = (int32_t)lround(humidity * 100.0),
+            .overflow = overflow != 0,
+        };
+    }
+    fclose(f);
+
+    if (!ok || trace->count == 0) {
+        sensor_trace_free(trace);
+        return false;
+    }
+    return true;
+}
+
+void sensor_trace_free(struct SensorTrace *trace) {
+    free(trace->rows);
+    *trace = (struct SensorTrace) {0};
+}
+
+void mock_devices_init(struct MockDevices *dev, const struct SensorTrace *trace,
+        struct Reservoir *reservoir, const struct PhCalibration *probe) {
+    *dev = (struct MockDevices) {
+        .trace = trace,
+        .reservoir = reservoir,
+        .probe = *probe,
+        .noise_counts = 16,
+        .noise_state = 1,
+    };
+}
+
+// Steps the reservoir by `dt_s` seconds while the pumps are in their current state
+static void reservoir_step(struct Reservoir *res, const bool *pump_on, double dt_s) {
+    if (pump_on[PUMP_ID_PH_UP]) {
+        res->unmixed += res->gain_up * dt_s;
+    }
+    if (pump_on[PUMP_ID_PH_DOWN]) {
+        res->unmixed -= res->gain_down * dt_s;
+    }
+
+    double mixed = res->unmixed * (1.0 - exp(-dt_s / res->mixing_tau_s));
+    res->unmixed -= mixed;
+    res->ph += mixed + res->drift_per_hour * dt_s / 3600.0;
+    if (res->ph < 0.0) {
+        res->ph = 0.0;
+    } else if (res->ph > 14.0) {
+        res->ph = 14.0;
+    }
+}
+
+void mock_devices_advance(struct MockDevices *dev, int64_t now_us) {
+    if (now_us <= dev->now_us) {
+        return;
+    }
+    int64_t dt_us = now_us - dev->now_us;
+    dev->now_us = now_us;
+
+    for (int i = 0; i < 4; ++i) {
+        if (dev->pump_on[i]) {
+            dev->pump_on_us[i] += dt_us;
+        }
+    }
+    if (dev->reservoir != NULL) {
+        reservoir_step(dev->reservoir, dev->pump_on, dt_us / 1e6);
+    }
+
+    if (dev->trace != NULL) {
+        const struct SensorTrace *trace = dev->trace;
+        uint32_t duration_s = trace->rows[trace->count - 1].time_s + 1;
+        uint32_t time_s = (uint32_t)((now_us / 1000000) % duration_s);
+        if (time_s < trace->rows[dev->row].time_s) {
+            dev->row = 0;
+        }
+        while (dev->row + 1 < trace->count && trace->rows[dev->row + 1].time_s <= time_s) {
+            ++dev->row;
+        }
+    }
+}
+
+static const struct TraceRow *mock_row(const struct MockDevices *dev) {
+    return dev->trace != NULL ? &dev->trace->rows[dev->row] : &CONSTANT_ROW;
+}
+
+int32_t mock_ph_to_mv(const struct PhCalibration *probe, double ph) {
+    // The inverse of the conversion in sensor_math.c; one slope on each side of pH 7
+    double mv = (ph < 7.0)
+        ? probe->ph_7 + (7.0 - ph) / 3.0 * (probe->ph_4 - probe->ph_7)
+        : probe->ph_7 - (ph - 7.0) / 3.0 * (probe->ph_7 - probe->ph_10);
+    return (int32_t)lround(mv);
+}
+
+// Uniform noise in [-noise_counts, noise_counts]
+static int32_t mock_noise(struct MockDevices *dev) {
+    if (dev->noise_counts == 0) {
+        return 0;
+    }
+    dev->noise_state = dev->noise_state * 1103515245 + 12345;
+    return (int32_t)((dev->noise_state >> 16) % (2 * dev->noise_counts + 1)) - dev->noise_counts;
+}
+
+static int16_t mock_adc_convert(void *ctx, int mux) {
+    struct MockDevices *dev = ctx;
+    const struct TraceRow *row = mock_row(dev);
+
+    int32_t mv;
+    if (mux == SENSOR_ADC_CHANNEL_INPUT[SENSOR_ADC_CHANNEL_PH]) {
+        double ph = dev->reservoir != NULL ? dev->reservoir->ph : row->ph_centi / 100.0;
+        mv = mock_ph_to_mv(&dev->probe, ph);
+    } else if (mux == SENSOR_ADC_CHANNEL_INPUT[SENSOR_ADC_CHANNEL_TDS]) {
+        // The TDS probe outputs 1 ppm per millivolt
+        mv = row->tds;
+    } else {
+        mv = 0;
+    }
+
+    int32_t raw = (mv << 15) / ADS1115_FULL_SCALE_MV + mock_noise(dev);
+    if (raw > INT16_MAX) {
+        raw = INT16_MAX;
+    } else if (raw < INT16_MIN) {
+        raw = INT16_MIN;
+    }
+    return (int16_t)raw;
+}
+
+static void mock_bme280_read(void *ctx, int32_t *temp_centi, uint32_t *humidity_q10) {
+    const struct TraceRow *row = mock_row(ctx);
+    *temp_centi = row->temp_centi;
+    *humidity_q10 = (uint32_t)(((int64_t)row->humidity_centi << 10) / 100);
+}
+
+static void mock_pump_set(void *ctx, uint8_t pump_id, bool on) {
+    struct MockDevices *dev = ctx;
+    if (pump_id < 4) {
+        dev->pump_on[pump_id] = on;
+    }
+}
+
+static bool mock_overflow_read(void *ctx) {
+    return mock_row(ctx)->overflow;
+}
+
+struct HydroHal mock_devices_hal(struct MockDevices *dev) {
+    return (struct HydroHal) {
+        .ctx = dev,
+        .adc_convert = mock_adc_convert,
+        .bme280_read = mock_bme280_read,
+        .pump_set = mock_pump_set,
+        .overflow_read = mock_overflow_read,
+    };
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal.h"
+#include "hydro_types.h"
+
+// One row of a recorded sensor trace, in the units of /api/readings.json
+struct TraceRow {
+    uint32_t time_s;            // Seconds since the start of the recording
+    int32_t ph_centi;
+    int32_t tds;                // ppm
+    int32_t temp_centi;
+    int32_t humidity_centi;
+    bool overflow;
+};
+
+struct SensorTrace {
+    struct TraceRow *rows;
+    size_t count;
+};
+
+// Loads a CSV trace with a header row and the columns `time,ph,tds,temp,humidity,overflow`.
+// Times must increase. Returns false if the file cannot be read or has no rows.
+bool sensor_trace_load(struct SensorTrace *trace, const char *path);
+
+void sensor_trace_free(struct SensorTrace *trace);
+
+// Reservoir that pH up and pH down are dosed into.
+//
+// A second of dose changes the pH by `gain` of its pump once it has mixed in. Doses mix in
+// exponentially with a time constant of `mixing_tau_s`, and the pH drifts by
+// `drift_per_hour` on its own, like a reservoir that nutrients are taken up from.
+struct Reservoir {
+    double ph;
+    double drift_per_hour;
+    double gain_up;
+    double gain_down;
+    double mixing_tau_s;
+    // Change of pH from doses that have not mixed in yet
+    double unmixed;
+};
+
+// Mocked ADS1115, BME280, pump relays and overflow sensor.
+//
+// Readings are replayed from a trace, looping at its end, or are constant without one.
+// With a reservoir, the pH probe follows the reservoir instead and the pumps dose into it.
+// Conversions have a deterministic pseudo-random noise of up to `noise_counts`.
+struct MockDevices {
+    const struct SensorTrace *trace;
+    struct Reservoir *reservoir;
+    // Calibration of the mocked pH probe
+    struct PhCalibration probe;
+    int32_t noise_counts;
+
+    int64_t now_us;
+    size_t row;
+    uint32_t noise_state;
+    // Indexed by PumpId
+    bool pump_on[4];
+    int64_t pump_on_us[4];
+};
+
+// `trace` and `reservoir` may be NULL
+void mock_devices_init(struct MockDevices *dev, const struct SensorTrace *trace,
+        struct Reservoir *reservoir, const struct PhCalibration *probe);
+
+// Advances simulated time to `now_us`; the reservoir is dosed by every pump that is on
+void mock_devices_advance(struct MockDevices *dev, int64_t now_us);
+
+// HAL that is backed by `dev`
+struct HydroHal mock_devices_hal(struct MockDevices *dev);
+
+// Millivolts of the mocked pH probe at a pH
+int32_t mock_ph_to_mv(const struct PhCalibration *probe, double ph);
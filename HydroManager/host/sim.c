@@ -0,0 +1,138 @@
+#include "sim.h"
+
+static void sim_schedule(struct Simulation *sim, enum SimJob job, int64_t deadline_us) {
+    // Pump pulses end first, so they are never longer than requested
+    static const uint8_t priorities[] = {
+        [SIM_JOB_PUMP_PULSE_END] = 2,
+        [SIM_JOB_SAMPLE] = 1,
+        [SIM_JOB_PH_CHECK] = 0,
+    };
+    scheduler_schedule(&sim->scheduler, job, priorities[job], deadline_us);
+}
+
+void sim_init(struct Simulation *sim, struct HydroHal hal, const struct PhCalibration *cal,
+        const struct SystemSettings *settings) {
+    *sim = (struct Simulation) {
+        .hal = hal,
+        .ph_stabilize_interval = settings->ph_stabilize_interval,
+    };
+
+    for (int i = 0; i < SENSOR_ADC_NUM_CHANNELS; ++i) {
+        sensor_filter_init(&sim->adc_filters[i], CONFIG_HYDRO_MANAGER_FILTER_OVERSAMPLE,
+                CONFIG_HYDRO_MANAGER_FILTER_MEDIAN_SIZE, CONFIG_HYDRO_MANAGER_FILTER_EMA_SHIFT);
+    }
+    sensor_ph_table_init(&sim->ph_table, cal);
+    sensor_snapshot_init(&sim->snapshot);
+    event_ring_init(&sim->events);
+    ph_control_init(&sim->dosing, settings->ph_dose_length);
+
+    scheduler_init(&sim->scheduler);
+    sim_schedule(sim, SIM_JOB_SAMPLE, 0);
+    sim_schedule(sim, SIM_JOB_PH_CHECK, (int64_t)sim->ph_stabilize_interval * 1000);
+}
+
+void sim_convert(struct Simulation *sim) {
+    for (int channel = 0; channel < SENSOR_ADC_NUM_CHANNELS; ++channel) {
+        for (int i = 0; i < CONFIG_HYDRO_MANAGER_FILTER_OVERSAMPLE; ++i) {
+            int32_t filtered;
+            int16_t raw = sim->hal.adc_convert(sim->hal.ctx, SENSOR_ADC_CHANNEL_INPUT[channel]);
+            if (sensor_filter_add(&sim->adc_filters[channel], raw, &filtered)) {
+                sim->adc_raw[channel] = filtered;
+            }
+        }
+    }
+}
+
+bool sim_sample(struct Simulation *sim, struct SensorReading *reading) {
+    sim_convert(sim);
+    for (int channel = 0; channel < SENSOR_ADC_NUM_CHANNELS; ++channel) {
+        if (!sim->adc_filters[channel].primed) {
+            return false;
+        }
+    }
+
+    int32_t temp;
+    uint32_t humidity_q10;
+    sim->hal.bme280_read(sim->hal.ctx, &temp, &humidity_q10);
+
+    sensor_reading_convert(reading, &sim->ph_table, sim->adc_raw, ADS1115_FULL_SCALE_MV, temp,
+            sensor_humidity_to_centi(humidity_q10), (time_t)(sim->now_us / 1000000));
+    sensor_snapshot_publish(&sim->snapshot, reading);
+    return true;
+}
+
+static void sim_pulse_start(struct Simulation *sim, uint8_t pump_id, uint32_t length) {
+    if (!pump_pulse_begin(&sim->pulse, pump_id, length, true, sim->now_us)) {
+        return;
+    }
+
+    sim->hal.pump_set(sim->hal.ctx, pump_id, true);
+    sim_schedule(sim, SIM_JOB_PUMP_PULSE_END, pump_pulse_end_us(&sim->pulse));
+}
+
+static void sim_pulse_update(struct Simulation *sim) {
+    struct PumpPulseEvent event;
+    if (!pump_pulse_poll(&sim->pulse, sim->hal.overflow_read(sim->hal.ctx), sim->now_us,
+                (time_t)(sim->now_us / 1000000), &event)) {
+        return;
+    }
+
+    sim->hal.pump_set(sim->hal.ctx, event.pump_id, false);
+    scheduler_cancel(&sim->scheduler, SIM_JOB_PUMP_PULSE_END);
+    ++sim->pulse_count;
+    event_ring_push(&sim->events, &event);
+
+    struct SensorReading reading;
+    if (sensor_snapshot_read(&sim->snapshot, &reading)) {
+        ph_control_record_pulse(&sim->dosing, &event, reading.ph_centi, sim->now_us);
+    }
+}
+
+static void sim_reading_ready(struct Simulation *sim, const struct SensorReading *reading) {
+    ph_dosing_observe(&sim->dosing, reading->ph_centi, sim->now_us);
+    if (!sim->ph_check_due) {
+        return;
+    }
+    sim->ph_check_due = false;
+
+    uint8_t pump_id;
+    uint32_t dose = ph_control_plan(&sim->dosing, reading->ph_centi, sim->now_us, &pump_id);
+    if (dose != 0) {
+        sim_pulse_start(sim, pump_id, dose);
+    }
+}
+
+bool sim_run_due(struct Simulation *sim, int64_t now_us) {
+    sim->now_us = now_us;
+
+    bool published = false;
+    struct ScheduledJob jobs[SCHEDULER_MAX_JOBS];
+    size_t job_count = scheduler_take_due(&sim->scheduler, now_us, jobs, SCHEDULER_MAX_JOBS);
+    for (size_t i = 0; i < job_count; ++i) {
+        struct SensorReading reading;
+        switch (jobs[i].id) {
+            case SIM_JOB_PUMP_PULSE_END:
+                sim_pulse_update(sim);
+                break;
+            case SIM_JOB_SAMPLE:
+                sim_pulse_update(sim);
+                if (sim_sample(sim, &reading)) {
+                    published = true;
+                    sim_reading_ready(sim, &reading);
+                }
+                sim_schedule(sim, SIM_JOB_SAMPLE, scheduler_next_period(jobs[i].deadline_us,
+                            (int64_t)SIM_SAMPLE_INTERVAL * 1000, now_us));
+                break;
+            case SIM_JOB_PH_CHECK:
+                sim->ph_check_due = true;
+                sim_schedule(sim, SIM_JOB_PH_CHECK, scheduler_next_period(jobs[i].deadline_us,
+                            (int64_t)sim->ph_stabilize_interval * 1000, now_us));
+                break;
+        }
+    }
+    return published;
+}
+
+int64_t sim_next_deadline(const struct Simulation *sim) {
+    return scheduler_next_deadline(&sim->scheduler);
+}
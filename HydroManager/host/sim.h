@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "event_ring.h"
+#include "hal.h"
+#include "hydro_types.h"
+#include "ph_dosing.h"
+#include "pump_control.h"
+#include "scheduler.h"
+#include "sensor_filter.h"
+#include "sensor_math.h"
+#include "sensor_snapshot.h"
+
+// Milliseconds between sensor samples, like SAMPLE_INTERVAL of hydro_manager_main.c
+#define SIM_SAMPLE_INTERVAL CONFIG_HYDRO_MANAGER_SAMPLE_INTERVAL_MS
+
+enum SimJob {
+    SIM_JOB_PUMP_PULSE_END,
+    SIM_JOB_SAMPLE,
+    SIM_JOB_PH_CHECK,
+};
+
+// The sampling and pH control code of the firmware, run on simulated time against a HAL.
+//
+// The task structure of the firmware is flattened into jobs of one scheduler: the ADC task
+// and the sampler become a SIM_JOB_SAMPLE every sample interval, and the system control
+// task runs the pump pulse and pH check jobs. Every module that does the work is the same
+// one the firmware is built with; pump pulses and pH checks are decided by pump_control.h,
+// so only the HAL calls are done here.
+struct Simulation {
+    struct HydroHal hal;
+    int64_t now_us;
+
+    struct SensorFilter adc_filters[SENSOR_ADC_NUM_CHANNELS];
+    int32_t adc_raw[SENSOR_ADC_NUM_CHANNELS];
+    struct PhTable ph_table;
+    struct SensorSnapshot snapshot;
+    struct EventRing events;
+    struct PhDosing dosing;
+    struct Scheduler scheduler;
+    uint32_t ph_stabilize_interval;
+    bool ph_check_due;
+
+    struct PumpPulse pulse;
+    uint32_t pulse_count;
+};
+
+// `settings` gives the pH stabilize interval and the dose that the initial gain is based on
+void sim_init(struct Simulation *sim, struct HydroHal hal, const struct PhCalibration *cal,
+        const struct SystemSettings *settings);
+
+// Runs `oversample` conversions of every ADC channel through its filter, like the ADC task
+// does between samples
+void sim_convert(struct Simulation *sim);
+
+// Samples every sensor and publishes the reading, like the sampler task. Returns false if
+// an ADC channel has no filtered value yet.
+bool sim_sample(struct Simulation *sim, struct SensorReading *reading);
+
+// Runs every job that is due at `now_us`; returns true if a reading was published
+bool sim_run_due(struct Simulation *sim, int64_t now_us);
+
+// Deadline of the next job
+int64_t sim_next_deadline(const struct Simulation *sim);
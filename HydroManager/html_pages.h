@@ -0,0 +1,119 @@
+// Generated by pages/generate_pages.py from pages/*.html; do not edit.
+#pragma once
+
+// Gzip compressed HTML page stored in flash
+struct StaticPage {
+  const uint8_t *gzip;
+  size_t length;
+  const char *etag;
+};
+
+// auto_pulse.html: 184 bytes, 151 bytes compressed
+const uint8_t PAGE_AUTO_PULSE_GZIP[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x4d, 0x8e, 0x41, 0x0a, 0xc2, 0x30,
+  0x10, 0x45, 0xf7, 0x3d, 0xc5, 0x38, 0x17, 0xc8, 0x05, 0x92, 0x82, 0xa8, 0xe0, 0xce, 0x2e, 0xdc,
+  0xb8, 0x92, 0xd4, 0x44, 0x1a, 0x48, 0x3a, 0xa1, 0x99, 0x2c, 0x7a, 0x7b, 0x33, 0xb6, 0x82, 0xab,
+  0x07, 0xc3, 0xff, 0xef, 0x8f, 0x3e, 0x9c, 0x6f, 0xa7, 0xfb, 0x63, 0xb8, 0xc0, 0xc4, 0x29, 0xf6,
+  0x9d, 0xfe, 0xc1, 0x5b, 0xd7, 0xc0, 0x81, 0xa3, 0xef, 0x8f, 0x95, 0x09, 0x86, 0x1a, 0x8b, 0x87,
+  0x7c, 0xd5, 0x6a, 0x3b, 0x76, 0x5a, 0xed, 0xa1, 0x91, 0xdc, 0xda, 0xf0, 0xa6, 0x25, 0x41, 0xf2,
+  0x3c, 0x91, 0x33, 0x98, 0xa9, 0x30, 0x82, 0x7d, 0x71, 0xa0, 0xd9, 0xa0, 0xcd, 0x41, 0xd9, 0x26,
+  0x79, 0x66, 0x91, 0xa0, 0x74, 0x2a, 0x33, 0xcd, 0xc0, 0x6b, 0xf6, 0x06, 0x4b, 0x1d, 0x53, 0x60,
+  0xfc, 0xdb, 0xd1, 0x6a, 0x0b, 0xc8, 0x8a, 0x78, 0x85, 0xfb, 0x8c, 0xfa, 0x7e, 0xf8, 0x01, 0x90,
+  0x53, 0x5c, 0xe2, 0xb8, 0x00, 0x00, 0x00
+};
+const StaticPage PAGE_AUTO_PULSE = {PAGE_AUTO_PULSE_GZIP, sizeof(PAGE_AUTO_PULSE_GZIP), "\"5101ee331667145d\""};
+
+// pulse.html: 614 bytes, 370 bytes compressed
+const uint8_t PAGE_PULSE_GZIP[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x65, 0x52, 0x3d, 0x4f, 0xc3, 0x30,
+  0x10, 0xdd, 0xf3, 0x2b, 0x0e, 0x4f, 0xed, 0x12, 0x97, 0x8e, 0x34, 0xcd, 0x00, 0xad, 0x54, 0xa4,
+  0x4a, 0x74, 0x80, 0x81, 0x31, 0x89, 0xaf, 0x89, 0x91, 0xbf, 0x88, 0xcf, 0x40, 0x85, 0xf8, 0xef,
+  0xd8, 0x49, 0x0a, 0x15, 0x4c, 0x77, 0xbe, 0x7b, 0xbe, 0x7b, 0xef, 0xd9, 0xc5, 0xd5, 0xe6, 0xe1,
+  0xee, 0xf1, 0xf9, 0xb0, 0x85, 0x8e, 0xb4, 0x2a, 0xb3, 0xe2, 0x1c, 0xb0, 0x12, 0x31, 0x90, 0x24,
+  0x85, 0xe5, 0x21, 0x28, 0x8f, 0xe0, 0x76, 0x05, 0x1f, 0xcf, 0x59, 0xc1, 0xa7, 0x7e, 0x6d, 0xc5,
+  0x29, 0x86, 0xa3, 0xed, 0x35, 0x68, 0xa4, 0xce, 0x8a, 0x35, 0x73, 0xd6, 0x13, 0x83, 0xaa, 0x21,
+  0x69, 0xcd, 0x9a, 0x55, 0x4e, 0x72, 0x97, 0xee, 0xb3, 0x88, 0x53, 0x55, 0x8d, 0x0a, 0x22, 0x3a,
+  0xa2, 0x82, 0x76, 0xac, 0x74, 0x3b, 0x78, 0x72, 0x7c, 0x63, 0xdf, 0xcd, 0x4d, 0xc1, 0x87, 0x6e,
+  0x44, 0x79, 0x54, 0xd8, 0x10, 0x48, 0x31, 0xa1, 0xc0, 0x54, 0x1a, 0xcf, 0x37, 0xb2, 0xc2, 0xba,
+  0x34, 0x19, 0xde, 0x2a, 0x15, 0x62, 0xf5, 0x7a, 0x18, 0x92, 0x26, 0x14, 0x7c, 0xec, 0xfc, 0x83,
+  0x2c, 0xa7, 0x3d, 0x17, 0x00, 0x3e, 0xee, 0x48, 0x0a, 0xfa, 0xbf, 0xbc, 0x22, 0xd7, 0x3d, 0x1a,
+  0x56, 0xee, 0xb1, 0x35, 0xd4, 0x81, 0x3d, 0xc2, 0x50, 0x03, 0x69, 0x40, 0x4b, 0xa5, 0xa4, 0xc7,
+  0xc6, 0x1a, 0xe1, 0x2f, 0x08, 0x4b, 0xe3, 0x02, 0x01, 0x9d, 0x5c, 0x5c, 0x66, 0x82, 0xae, 0xb1,
+  0x67, 0x13, 0xfb, 0x69, 0xd6, 0x8f, 0x82, 0xf3, 0x59, 0xcb, 0x68, 0xcd, 0x72, 0xb1, 0x88, 0x59,
+  0xf5, 0x11, 0x45, 0x2c, 0x16, 0x29, 0xef, 0xf1, 0x35, 0xc8, 0x1e, 0xc5, 0x99, 0x56, 0x1d, 0x88,
+  0xa2, 0x8c, 0x71, 0xb0, 0x0f, 0xb5, 0x96, 0xc4, 0xc6, 0xc7, 0x28, 0xf8, 0xd8, 0x4b, 0x52, 0x92,
+  0xf9, 0xc9, 0xb5, 0xa6, 0x97, 0x2e, 0x2a, 0x3a, 0x22, 0x35, 0xdd, 0x8c, 0xf1, 0x64, 0xbc, 0x47,
+  0x22, 0x69, 0x5a, 0xcf, 0xe6, 0x39, 0x75, 0x68, 0x66, 0x3d, 0xac, 0x4b, 0xe8, 0xf3, 0x17, 0x6f,
+  0xcd, 0x6c, 0x3e, 0xd5, 0x44, 0xaa, 0x7d, 0x66, 0xc2, 0x36, 0x41, 0xa3, 0xa1, 0xbc, 0x45, 0xda,
+  0x2a, 0x4c, 0xe9, 0xed, 0xe9, 0x5e, 0xcc, 0x7e, 0x49, 0xcf, 0xf3, 0xc1, 0x4f, 0x58, 0x83, 0xc8,
+  0x5d, 0x77, 0x88, 0xaf, 0xb1, 0xb1, 0x43, 0xa7, 0xa5, 0x6e, 0x95, 0x7d, 0xcd, 0x57, 0xc9, 0xd6,
+  0x89, 0x44, 0xe4, 0x37, 0xfe, 0x0c, 0x3e, 0xfc, 0xa7, 0x6f, 0x04, 0x7c, 0x8b, 0x65, 0x66, 0x02,
+  0x00, 0x00
+};
+const StaticPage PAGE_PULSE = {PAGE_PULSE_GZIP, sizeof(PAGE_PULSE_GZIP), "\"214d8ee631add174\""};
+
+// read.html: 385 bytes, 259 bytes compressed
+const uint8_t PAGE_READ_GZIP[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x75, 0x90, 0x3d, 0x4f, 0xc3, 0x30,
+  0x10, 0x86, 0xf7, 0xfc, 0x0a, 0x93, 0xc9, 0x61, 0xb0, 0xd3, 0xac, 0x38, 0x1e, 0x48, 0x5b, 0x15,
+  0x09, 0x09, 0x24, 0xba, 0x30, 0x86, 0xf8, 0xda, 0x18, 0x25, 0xb6, 0xe5, 0x5c, 0x45, 0x2b, 0xc4,
+  0x7f, 0xe7, 0x9c, 0x86, 0x01, 0x24, 0x06, 0xeb, 0x7c, 0xcf, 0xbd, 0xf7, 0xa9, 0x6e, 0xd6, 0x4f,
+  0xcd, 0xfe, 0xf5, 0x79, 0xc3, 0x7a, 0x1c, 0x07, 0x9d, 0xa9, 0x1f, 0x03, 0xad, 0x21, 0x83, 0x16,
+  0x07, 0xd0, 0xcd, 0x29, 0x46, 0x70, 0xc8, 0xc2, 0x4e, 0xc9, 0x2b, 0xc9, 0x94, 0x5c, 0x14, 0x6f,
+  0xde, 0x5c, 0x92, 0x7e, 0xf5, 0x4b, 0x45, 0x2e, 0xb1, 0x8a, 0x59, 0x53, 0xe7, 0x68, 0x47, 0xc8,
+  0x35, 0xb1, 0x8a, 0x58, 0xd0, 0x6a, 0x0a, 0xad, 0x9b, 0x03, 0xa1, 0x4f, 0x38, 0xb9, 0x7a, 0x4e,
+  0x0a, 0x14, 0x9f, 0xba, 0x68, 0x03, 0xea, 0xec, 0x00, 0xd8, 0xf5, 0x3c, 0x97, 0x6d, 0xb0, 0x32,
+  0x52, 0xa7, 0xbc, 0x10, 0xd8, 0x83, 0xe3, 0x91, 0xd5, 0x9a, 0x45, 0xf1, 0x3e, 0x79, 0xc7, 0x8b,
+  0x85, 0x99, 0xc4, 0x3e, 0x33, 0xe3, 0xbb, 0xd3, 0x48, 0x03, 0x88, 0x23, 0xe0, 0x66, 0x80, 0xf4,
+  0xbd, 0xbf, 0x3c, 0x18, 0x7e, 0x1d, 0x80, 0xb4, 0x70, 0xc6, 0xc6, 0x3b, 0x4c, 0x33, 0xd6, 0xcc,
+  0xc1, 0x07, 0x5b, 0xb7, 0x08, 0xdc, 0x88, 0x14, 0x67, 0xb7, 0x6c, 0x55, 0x96, 0x25, 0xa9, 0xfc,
+  0xa3, 0xef, 0xda, 0x01, 0xf6, 0x04, 0x5f, 0x30, 0x5a, 0x77, 0xe4, 0xc5, 0xdd, 0xff, 0xb5, 0x69,
+  0x87, 0xbf, 0x95, 0x8d, 0x08, 0x3d, 0x95, 0xd9, 0xda, 0x33, 0x18, 0x5e, 0x51, 0xf2, 0x17, 0x3d,
+  0xda, 0x73, 0xd9, 0x4c, 0xc9, 0xe5, 0x64, 0x72, 0x3e, 0xf5, 0x37, 0xd8, 0x08, 0x68, 0x21, 0x81,
+  0x01, 0x00, 0x00
+};
+const StaticPage PAGE_READ = {PAGE_READ_GZIP, sizeof(PAGE_READ_GZIP), "\"54c62da1a7a18675\""};
+
+// settings.html: 1650 bytes, 614 bytes compressed
+const uint8_t PAGE_SETTINGS_GZIP[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xa5, 0x55, 0xdf, 0x6f, 0xd3, 0x30,
+  0x10, 0x7e, 0xcf, 0x5f, 0x71, 0xf8, 0x29, 0x15, 0x53, 0x53, 0x18, 0x08, 0x69, 0x4b, 0x82, 0xa0,
+  0x9d, 0xc4, 0x24, 0x10, 0x13, 0xe3, 0x05, 0x4d, 0x13, 0x4a, 0x93, 0x6b, 0x63, 0x9a, 0xd8, 0x51,
+  0x7c, 0xe9, 0x36, 0xa1, 0xfd, 0xef, 0x9c, 0xf3, 0xa3, 0x4d, 0xd2, 0x0e, 0xa1, 0xf1, 0x12, 0xc7,
+  0xe7, 0xbb, 0xfb, 0xbe, 0xcf, 0xbe, 0xb3, 0xfd, 0x17, 0x8b, 0xaf, 0xf3, 0xef, 0x3f, 0xae, 0x2e,
+  0x20, 0xa5, 0x3c, 0x0b, 0x1d, 0xbf, 0x1b, 0x30, 0x4a, 0x78, 0x20, 0x49, 0x19, 0x86, 0xd7, 0x48,
+  0x24, 0xd5, 0xda, 0xf8, 0x5e, 0x33, 0x77, 0x7c, 0xaf, 0x5d, 0x5f, 0xea, 0xe4, 0x81, 0x87, 0x95,
+  0x2e, 0x73, 0xc8, 0x91, 0x52, 0x9d, 0x04, 0xa2, 0xd0, 0x86, 0x04, 0x44, 0x31, 0x49, 0xad, 0x02,
+  0x11, 0x15, 0xd2, 0xbb, 0x2b, 0x25, 0xe1, 0x4f, 0xd3, 0x66, 0x11, 0x1c, 0x90, 0x45, 0x4b, 0xcc,
+  0x80, 0xc3, 0xd8, 0xa1, 0x22, 0x7d, 0x95, 0x8a, 0xf0, 0x03, 0x8f, 0x50, 0x7c, 0x02, 0x37, 0xc1,
+  0x55, 0x54, 0x65, 0x74, 0x06, 0xbe, 0x29, 0x22, 0x05, 0x32, 0xe9, 0x7c, 0x16, 0xcd, 0x82, 0x08,
+  0x7d, 0xcf, 0xae, 0x84, 0x13, 0x38, 0xf3, 0xbd, 0x3a, 0x13, 0x67, 0x94, 0xaa, 0xa8, 0x08, 0xe8,
+  0xa1, 0xc0, 0x40, 0xc4, 0x29, 0xc6, 0x9b, 0xa5, 0xbe, 0x17, 0xbd, 0x60, 0x01, 0x2a, 0xca, 0x71,
+  0x0f, 0xc7, 0xdc, 0xcb, 0x21, 0x91, 0x12, 0x57, 0x32, 0xcb, 0xbe, 0xe8, 0x04, 0x45, 0x38, 0x97,
+  0x65, 0x5c, 0x65, 0x11, 0x21, 0x7c, 0x43, 0x83, 0xe5, 0x56, 0xcb, 0xf2, 0x28, 0xb1, 0x7d, 0xcc,
+  0x33, 0xc9, 0xf5, 0x40, 0x5b, 0x82, 0x7d, 0x1a, 0x87, 0x24, 0x8b, 0x74, 0x6e, 0xe3, 0x2f, 0x15,
+  0x31, 0xab, 0x28, 0x13, 0xe1, 0xc8, 0x70, 0x94, 0xe5, 0xc8, 0xe7, 0x9f, 0xa9, 0xaa, 0x2a, 0x5f,
+  0x62, 0x29, 0x8e, 0xe5, 0xe8, 0xd8, 0x1e, 0x98, 0x73, 0xc9, 0x87, 0x7e, 0x3a, 0xe3, 0x9f, 0xe8,
+  0x3e, 0x10, 0x6f, 0x4e, 0x5f, 0xcf, 0x66, 0xc7, 0x75, 0x5c, 0x55, 0x79, 0xb1, 0xd0, 0x06, 0x3f,
+  0xa3, 0x5a, 0x53, 0x6a, 0x85, 0x0c, 0x2d, 0x4f, 0x28, 0x19, 0x3a, 0x3d, 0x53, 0xca, 0x08, 0x7b,
+  0xa7, 0x65, 0x6c, 0xaf, 0xc5, 0x58, 0x05, 0x8d, 0x9a, 0x57, 0xb3, 0xd9, 0x71, 0x35, 0xcd, 0x99,
+  0xf5, 0xd5, 0x8c, 0x2d, 0x7f, 0xa9, 0x9e, 0xff, 0x54, 0x73, 0x80, 0x3d, 0xa8, 0xa3, 0x03, 0x35,
+  0x6f, 0x5b, 0x2d, 0xef, 0xf6, 0x42, 0x96, 0x15, 0x91, 0x56, 0x6d, 0x6a, 0x53, 0x2d, 0x73, 0xc9,
+  0x14, 0xae, 0xeb, 0x11, 0xf6, 0xad, 0xdf, 0x78, 0x75, 0x31, 0x9e, 0x6d, 0xf9, 0xae, 0xf3, 0xbb,
+  0x5e, 0xf7, 0x6c, 0xb3, 0x9b, 0x68, 0xdb, 0xeb, 0xf5, 0xe1, 0xad, 0xf0, 0x24, 0x18, 0xc7, 0xec,
+  0xa0, 0x20, 0x32, 0xd0, 0xee, 0x44, 0x0f, 0xb5, 0x03, 0x34, 0x71, 0x29, 0x0b, 0x0a, 0x9d, 0x58,
+  0x2b, 0x43, 0x60, 0x52, 0x7d, 0x07, 0x01, 0xb8, 0x9b, 0x13, 0xd8, 0x4e, 0x20, 0x08, 0x61, 0x03,
+  0x41, 0x00, 0x83, 0xae, 0x7a, 0x0f, 0x5b, 0x6b, 0x3b, 0x85, 0x33, 0xd8, 0x9e, 0x3b, 0x2b, 0xa4,
+  0x38, 0x75, 0x5b, 0xa6, 0x1d, 0xc9, 0xc9, 0x94, 0x52, 0x54, 0x6e, 0x69, 0x13, 0x94, 0xd3, 0x5f,
+  0x46, 0x2b, 0x77, 0xd2, 0xda, 0x12, 0x6b, 0xfb, 0xed, 0x30, 0x38, 0xb8, 0x0d, 0xe4, 0x06, 0xf4,
+  0x0a, 0x6e, 0xba, 0x7b, 0xe4, 0x64, 0x00, 0xc6, 0xb3, 0x71, 0x43, 0xd4, 0xa6, 0x51, 0x5d, 0xed,
+  0x82, 0x7a, 0xb6, 0xdb, 0x09, 0xc3, 0x34, 0x08, 0xc8, 0x8a, 0x12, 0x1d, 0x57, 0x39, 0x2a, 0x9a,
+  0xae, 0x91, 0x2e, 0x32, 0xb4, 0xbf, 0x1f, 0x1f, 0x2e, 0x13, 0x77, 0x33, 0x39, 0x77, 0xe4, 0x0a,
+  0x5c, 0x9c, 0xda, 0x1d, 0xac, 0xc5, 0xee, 0x2e, 0x14, 0x9b, 0x01, 0xa7, 0xf5, 0x14, 0x99, 0x77,
+  0xbd, 0x39, 0x76, 0x67, 0x92, 0x9b, 0xcd, 0x2d, 0x87, 0x3d, 0x02, 0x66, 0x06, 0x6b, 0x1f, 0x26,
+  0x56, 0xd5, 0x28, 0xbc, 0xc2, 0x0b, 0xce, 0x93, 0x68, 0xf0, 0x12, 0x44, 0x57, 0x95, 0xbc, 0x23,
+  0x78, 0x4f, 0x73, 0xcd, 0xca, 0x14, 0xf5, 0xd3, 0x4f, 0xdb, 0xd2, 0x36, 0x2d, 0x8e, 0xf3, 0xc8,
+  0x5f, 0x2e, 0xe1, 0xf6, 0xa4, 0xf8, 0x10, 0x9b, 0x57, 0xc2, 0xab, 0xdf, 0x96, 0x3f, 0xc0, 0xd5,
+  0x7d, 0x40, 0x72, 0x06, 0x00, 0x00
+};
+const StaticPage PAGE_SETTINGS = {PAGE_SETTINGS_GZIP, sizeof(PAGE_SETTINGS_GZIP), "\"0bf83ba05a7b2ef4\""};
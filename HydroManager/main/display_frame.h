@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Size of the SSD1306 display; each page is a row of 8 pixel tall columns
+#define DISPLAY_WIDTH 128
+#define DISPLAY_PAGES 8
+
+// Width of a character of the 5x7 font, including its spacing column
+#define DISPLAY_CHAR_WIDTH 6
+
+// Frame buffer of the SSD1306 display, laid out like its GRAM: one byte per column of each
+// page, with the top pixel in the lowest bit.
+//
+// A copy of what was last sent to the display is kept, so a frame can be redrawn from
+// scratch and only the columns that changed are sent. Pages that were never sent have
+// `force_full` set, since the display GRAM may hold anything at power-on.
+struct DisplayFrame {
+    uint8_t pixels[DISPLAY_PAGES][DISPLAY_WIDTH];
+    uint8_t sent[DISPLAY_PAGES][DISPLAY_WIDTH];
+    bool force_full[DISPLAY_PAGES];
+};
+
+// Clears the frame. Every page is sent in full on the first update, since the display may
+// hold anything.
+void display_frame_init(struct DisplayFrame *frame);
+
+// Clears the pixels of the frame without changing what was sent
+void display_frame_clear(struct DisplayFrame *frame);
+
+// Draws text at `column` of `page`, with every pixel scaled by `scale` (1 or more); text
+// with a scale of `n` spans `n` pages. Text past the edge of the display is cut off.
+void display_frame_draw_text(struct DisplayFrame *frame, uint8_t page, uint8_t column,
+        const char *text, uint8_t scale);
+
+// Finds the first and last columns of `page` that changed since they were sent, or the
+// whole page if it was never sent. Returns false if nothing on the page changed.
+bool display_frame_dirty_span(const struct DisplayFrame *frame, uint8_t page,
+        uint8_t *first, uint8_t *last);
+
+// Records that columns `first` to `last` of `page` were sent to the display
+void display_frame_mark_sent(struct DisplayFrame *frame, uint8_t page, uint8_t first,
+        uint8_t last);
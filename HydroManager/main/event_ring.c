@@ -0,0 +1,62 @@
+#include "event_ring.h"
+
+void event_ring_init(struct EventRing *ring) {
+    atomic_init(&ring->head, 1);
+    atomic_init(&ring->tail, 1);
+    atomic_init(&ring->dropped, 0);
+}
+
+bool event_ring_push(struct EventRing *ring, struct PumpPulseEvent *event) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail >= EVENT_RING_SIZE) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    // Fill the slot before publishing it to the consumer
+    event->seq = head;
+    ring->events[head % EVENT_RING_SIZE] = *event;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    return true;
+}
+
+bool event_ring_get(struct EventRing *ring, uint32_t seq, struct PumpPulseEvent *out) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    // Unsigned arithmetic keeps this correct when sequence numbers wrap around
+    if (seq - tail >= head - tail) {
+        return false;
+    }
+
+    *out = ring->events[seq % EVENT_RING_SIZE];
+    return true;
+}
+
+void event_ring_release(struct EventRing *ring, uint32_t seq) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    // Ignore sequence numbers that were already released or have not been produced yet
+    if (seq - tail > head - tail) {
+        return;
+    }
+
+    // Finish reading the released slots before handing them back to the producer
+    atomic_store_explicit(&ring->tail, seq, memory_order_release);
+}
+
+uint32_t event_ring_first_seq(struct EventRing *ring) {
+    return atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+uint32_t event_ring_next_seq(struct EventRing *ring) {
+    return atomic_load_explicit(&ring->head, memory_order_acquire);
+}
+
+uint32_t event_ring_dropped(struct EventRing *ring) {
+    return atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+}
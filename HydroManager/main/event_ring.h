@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hydro_types.h"
+
+#define EVENT_RING_SIZE CONFIG_HYDRO_MANAGER_EVENT_RING_SIZE
+
+// Slots are indexed by `seq % EVENT_RING_SIZE`, which only stays in order across the wrap
+// of a uint32_t sequence number if the size divides 2^32
+_Static_assert(EVENT_RING_SIZE > 0 && (EVENT_RING_SIZE & (EVENT_RING_SIZE - 1)) == 0,
+        "EVENT_RING_SIZE must be a power of 2");
+
+// Fixed capacity, lock-free ring buffer of pump pulse events.
+//
+// There must be only one producer (the system control task on core 0) and one consumer
+// (the HTTP server task on core 1). Every event is given a sequence number that increases
+// by 1 for each stored event, starting at 1. Events stay in the ring until the consumer
+// releases them; events produced while the ring is full are dropped and counted.
+struct EventRing {
+    struct PumpPulseEvent events[EVENT_RING_SIZE];
+    // Sequence number of the next event; only written by the producer
+    _Atomic uint32_t head;
+    // Sequence number of the oldest event that has not been released; only written by
+    // the consumer
+    _Atomic uint32_t tail;
+    // Number of events dropped because the ring was full
+    _Atomic uint32_t dropped;
+};
+
+void event_ring_init(struct EventRing *ring);
+
+// Producer: stores a copy of `event` and sets `event->seq` to its sequence number.
+// Returns false if the ring is full and the event was dropped.
+bool event_ring_push(struct EventRing *ring, struct PumpPulseEvent *event);
+
+// Consumer: copies the event with sequence number `seq` into `out`.
+// Returns false if that event was released or has not been produced yet.
+bool event_ring_get(struct EventRing *ring, uint32_t seq, struct PumpPulseEvent *out);
+
+// Consumer: releases all events with a sequence number less than `seq`
+void event_ring_release(struct EventRing *ring, uint32_t seq);
+
+// Sequence number of the oldest event that has not been released
+uint32_t event_ring_first_seq(struct EventRing *ring);
+
+// Sequence number that the next produced event will have
+uint32_t event_ring_next_seq(struct EventRing *ring);
+
+uint32_t event_ring_dropped(struct EventRing *ring);
@@ -0,0 +1,227 @@
+#include "flash_log.h"
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+static const char *TAG = "flash_log";
+
+static uint32_t flash_log_page_crc(const struct FlashLogPage *page) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&page->header,
+            offsetof(struct FlashLogPageHeader, crc32));
+    return esp_rom_crc32_le(crc, page->data, page->header.used);
+}
+
+static bool flash_log_page_is_valid(const struct FlashLogPage *page) {
+    return page->header.magic == FLASH_LOG_PAGE_MAGIC
+        && page->header.format == FLASH_LOG_PAGE_FORMAT
+        && page->header.used <= FLASH_LOG_PAGE_DATA_SIZE
+        && page->header.crc32 == flash_log_page_crc(page);
+}
+
+static void flash_log_reset_pending(struct FlashLog *log) {
+    log->pending.header = (struct FlashLogPageHeader) {
+        .magic = FLASH_LOG_PAGE_MAGIC,
+        .seq = log->next_seq,
+        .used = 0,
+        .format = FLASH_LOG_PAGE_FORMAT,
+    };
+    ts_codec_reset(&log->state);
+}
+
+// Oldest page that can still be in flash. It shares its sector with the pending page, so it
+// is only lost once the pending page is written. Must be called with the mutex held.
+static uint32_t flash_log_oldest_seq(const struct FlashLog *log) {
+    return (log->next_seq > log->page_count) ? log->next_seq - log->page_count : 1;
+}
+
+// Erases the sector of the pending page and programs it
+static esp_err_t flash_log_write_pending(struct FlashLog *log) {
+    size_t offset = (log->next_seq % log->page_count) * FLASH_LOG_PAGE_SIZE;
+    log->pending.header.crc32 = flash_log_page_crc(&log->pending);
+
+    esp_err_t err = esp_partition_erase_range(log->partition, offset, FLASH_LOG_PAGE_SIZE);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return esp_partition_write(log->partition, offset, &log->pending, FLASH_LOG_PAGE_SIZE);
+}
+
+static int16_t clamp_i16(int32_t value) {
+    return (value < INT16_MIN) ? INT16_MIN : (value > INT16_MAX) ? INT16_MAX : value;
+}
+
+static uint16_t clamp_u16(uint32_t value) {
+    return (value > UINT16_MAX) ? UINT16_MAX : value;
+}
+
+void flash_log_record_from_reading(struct LogRecord *record, const struct SensorReading *reading) {
+    *record = (struct LogRecord) {
+        .type = LOG_RECORD_READING,
+        .timestamp = (uint32_t)reading->timestamp,
+        .reading = {
+            .ph_centi = clamp_i16(reading->ph_centi),
+            .temp_centi = clamp_i16(reading->temp_centi),
+            .humidity_centi = clamp_u16(reading->humidity_centi < 0 ? 0 : reading->humidity_centi),
+            .tds = clamp_u16(reading->tds),
+        },
+    };
+}
+
+void flash_log_record_from_event(struct LogRecord *record, const struct PumpPulseEvent *event) {
+    *record = (struct LogRecord) {
+        .type = LOG_RECORD_PUMP_EVENT,
+        .pump_id = event->pump_id,
+        .was_interrupted = event->was_interrupted,
+        .was_automatic = event->was_automatic,
+        .timestamp = (uint32_t)event->timestamp,
+        .pump_event = {
+            .seq = event->seq,
+            .pulse_length = event->pulse_length,
+        },
+    };
+}
+
+esp_err_t flash_log_init(struct FlashLog *log, const char *partition_label) {
+    log->partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+            ESP_PARTITION_SUBTYPE_ANY, partition_label);
+    if (log->partition == NULL) {
+        ESP_LOGE(TAG, "Partition '%s' not found", partition_label);
+        return ESP_ERR_NOT_FOUND;
+    }
+    log->page_count = log->partition->size / FLASH_LOG_PAGE_SIZE;
+    if (log->page_count < 2) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    log->mutex = xSemaphoreCreateMutex();
+    if (log->mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Find the newest valid page; the pending page is used as a buffer while scanning
+    uint32_t newest_seq = 0;
+    for (uint32_t i = 0; i < log->page_count; ++i) {
+        esp_err_t err = esp_partition_read(log->partition, i * FLASH_LOG_PAGE_SIZE,
+                &log->pending, FLASH_LOG_PAGE_SIZE);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (flash_log_page_is_valid(&log->pending)
+                && log->pending.header.seq % log->page_count == i
+                && log->pending.header.seq > newest_seq) {
+            newest_seq = log->pending.header.seq;
+        }
+    }
+
+    log->next_seq = newest_seq + 1;
+    flash_log_reset_pending(log);
+    ESP_LOGI(TAG, "Opened log with %" PRIu32 " pages; next page is %" PRIu32,
+            log->page_count, log->next_seq);
+
+    return ESP_OK;
+}
+
+esp_err_t flash_log_append(struct FlashLog *log, const struct LogRecord *record) {
+    xSemaphoreTake(log->mutex, portMAX_DELAY);
+
+    // Encode with a copy of the state, since the record is encoded again from a reset
+    // state if it starts a new page
+    esp_err_t err = ESP_OK;
+    uint8_t encoded[TS_CODEC_RECORD_MAX_SIZE];
+    struct TsCodecState state = log->state;
+    size_t len = ts_codec_encode(&state, record, TS_CODEC_CHANNEL_ALL, encoded);
+    if (log->pending.header.used + len > FLASH_LOG_PAGE_DATA_SIZE) {
+        err = flash_log_write_pending(log);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write page %" PRIu32 ": %s", log->next_seq,
+                    esp_err_to_name(err));
+        }
+
+        // A page that failed to write is skipped, so the log does not stall on a bad sector
+        ++log->next_seq;
+        flash_log_reset_pending(log);
+
+        state = log->state;
+        len = ts_codec_encode(&state, record, TS_CODEC_CHANNEL_ALL, encoded);
+    }
+
+    memcpy(log->pending.data + log->pending.header.used, encoded, len);
+    log->pending.header.used += len;
+    log->state = state;
+
+    xSemaphoreGive(log->mutex);
+    return err;
+}
+
+esp_err_t flash_log_read_page(struct FlashLog *log, uint32_t seq, struct FlashLogPage *out) {
+    xSemaphoreTake(log->mutex, portMAX_DELAY);
+    uint32_t first_seq = flash_log_oldest_seq(log);
+    bool in_range = seq >= first_seq && seq < log->next_seq;
+    xSemaphoreGive(log->mutex);
+
+    if (!in_range) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Reading does not need the mutex; a page that is overwritten while it is read is
+    // detected by its sequence number or CRC
+    size_t offset = (seq % log->page_count) * FLASH_LOG_PAGE_SIZE;
+    esp_err_t err = esp_partition_read(log->partition, offset, out, FLASH_LOG_PAGE_SIZE);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!flash_log_page_is_valid(out)) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    if (out->header.seq != seq) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    return ESP_OK;
+}
+
+void flash_log_read_pending(struct FlashLog *log, struct FlashLogPage *out) {
+    xSemaphoreTake(log->mutex, portMAX_DELAY);
+    out->header = log->pending.header;
+    memcpy(out->data, log->pending.data, log->pending.header.used);
+    xSemaphoreGive(log->mutex);
+}
+
+void flash_log_reader_init(struct FlashLogReader *reader, const struct FlashLogPage *page) {
+    reader->page = page;
+    reader->offset = 0;
+    ts_codec_reset(&reader->state);
+}
+
+bool flash_log_reader_next(struct FlashLogReader *reader, struct LogRecord *record) {
+    size_t used = reader->page->header.used;
+    if (reader->offset >= used) {
+        return false;
+    }
+
+    size_t len = ts_codec_decode(&reader->state, reader->page->data + reader->offset,
+            used - reader->offset, record);
+    if (len == 0) {
+        return false;
+    }
+    reader->offset += len;
+    return true;
+}
+
+uint32_t flash_log_first_seq(struct FlashLog *log) {
+    xSemaphoreTake(log->mutex, portMAX_DELAY);
+    uint32_t first_seq = flash_log_oldest_seq(log);
+    xSemaphoreGive(log->mutex);
+    return first_seq;
+}
+
+uint32_t flash_log_next_seq(struct FlashLog *log) {
+    xSemaphoreTake(log->mutex, portMAX_DELAY);
+    uint32_t next_seq = log->next_seq;
+    xSemaphoreGive(log->mutex);
+    return next_seq;
+}
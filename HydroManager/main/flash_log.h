@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "hydro_types.h"
+#include "ts_codec.h"
+
+// Size of a flash log page; one flash sector
+#define FLASH_LOG_PAGE_SIZE 4096
+
+// Identifies a flash log page; "HLOG"
+#define FLASH_LOG_PAGE_MAGIC 0x474f4c48
+
+// Version of the page format; pages of other formats are ignored
+#define FLASH_LOG_PAGE_FORMAT 2
+
+struct FlashLogPageHeader {
+    uint32_t magic;
+    // Sequence number of the page; increases by 1 for every written page, starting at 1
+    uint32_t seq;
+    uint16_t used;      // Number of bytes of encoded records in the page
+    uint16_t format;
+    // CRC32 of the header fields above and the encoded records in the page
+    uint32_t crc32;
+};
+
+#define FLASH_LOG_PAGE_DATA_SIZE (FLASH_LOG_PAGE_SIZE - sizeof(struct FlashLogPageHeader))
+
+// Records are encoded with ts_codec, starting from a reset state in every page, so each
+// page can be decoded on its own
+struct FlashLogPage {
+    struct FlashLogPageHeader header;
+    uint8_t data[FLASH_LOG_PAGE_DATA_SIZE];
+};
+_Static_assert(sizeof(struct FlashLogPage) == FLASH_LOG_PAGE_SIZE,
+        "flash log pages must fill a flash sector");
+
+// Append-only ring log of records on a flash partition.
+//
+// Records are batched in a RAM page, and a page is only erased and programmed once it is
+// full, so every sector is erased once per pass around the partition. The page with
+// sequence number `seq` is always stored at sector `seq % page_count`, so pages are
+// written in a ring and wear is spread evenly. Records that were not written yet are lost
+// on a reset.
+struct FlashLog {
+    const esp_partition_t *partition;
+    uint32_t page_count;
+    // Sequence number of the page being batched in RAM
+    uint32_t next_seq;
+    struct FlashLogPage pending;
+    // Encoder state of the pending page
+    struct TsCodecState state;
+    SemaphoreHandle_t mutex;
+};
+
+// Decodes the records of a page in order
+struct FlashLogReader {
+    const struct FlashLogPage *page;
+    size_t offset;
+    struct TsCodecState state;
+};
+
+// Builds the log record of a sensor reading or pump pulse event
+void flash_log_record_from_reading(struct LogRecord *record, const struct SensorReading *reading);
+void flash_log_record_from_event(struct LogRecord *record, const struct PumpPulseEvent *event);
+
+// Finds the log partition and the newest page written to it
+esp_err_t flash_log_init(struct FlashLog *log, const char *partition_label);
+
+// Adds a record to the RAM page; when the record does not fit, the page is written to flash
+// and the record starts the next page
+esp_err_t flash_log_append(struct FlashLog *log, const struct LogRecord *record);
+
+// Reads the page with sequence number `seq` from flash. Returns ESP_ERR_NOT_FOUND if the
+// page was overwritten or not written yet, and ESP_ERR_INVALID_CRC if it is corrupted.
+esp_err_t flash_log_read_page(struct FlashLog *log, uint32_t seq, struct FlashLogPage *out);
+
+// Copies the page being batched in RAM, which is not in flash yet
+void flash_log_read_pending(struct FlashLog *log, struct FlashLogPage *out);
+
+void flash_log_reader_init(struct FlashLogReader *reader, const struct FlashLogPage *page);
+
+// Decodes the next record of the page. Returns false at the end of the page, or if the rest
+// of the page is malformed.
+bool flash_log_reader_next(struct FlashLogReader *reader, struct LogRecord *record);
+
+// Sequence number of the oldest page that can still be in flash
+uint32_t flash_log_first_seq(struct FlashLog *log);
+
+// Sequence number of the page being batched in RAM
+uint32_t flash_log_next_seq(struct FlashLog *log);
@@ -0,0 +1,77 @@
+#include "history.h"
+
+#include <string.h>
+#include <strings.h>
+
+static const struct {
+    const char *name;
+    uint8_t field;
+} HISTORY_FIELD_NAMES[] = {
+    {"ph", HISTORY_FIELD_PH},
+    {"temp", HISTORY_FIELD_TEMP},
+    {"humidity", HISTORY_FIELD_HUMIDITY},
+    {"tds", HISTORY_FIELD_TDS},
+    {"pulses", HISTORY_FIELD_PULSES},
+};
+
+uint8_t history_parse_fields(const char *fields) {
+    uint8_t mask = 0;
+    while (*fields != '\0') {
+        size_t len = strcspn(fields, ",%");
+
+        uint8_t field = 0;
+        for (size_t i = 0; i < sizeof(HISTORY_FIELD_NAMES) / sizeof(HISTORY_FIELD_NAMES[0]); ++i) {
+            if (strlen(HISTORY_FIELD_NAMES[i].name) == len
+                    && strncmp(HISTORY_FIELD_NAMES[i].name, fields, len) == 0) {
+                field = HISTORY_FIELD_NAMES[i].field;
+                break;
+            }
+        }
+        if (field == 0) {
+            return 0;
+        }
+        mask |= field;
+
+        // Commas may be URL encoded
+        fields += len;
+        if (*fields == ',') {
+            ++fields;
+        } else if (strncasecmp(fields, "%2C", 3) == 0) {
+            fields += 3;
+        } else if (*fields != '\0') {
+            return 0;
+        }
+    }
+
+    return mask;
+}
+
+size_t history_encoder_init(struct HistoryEncoder *encoder, uint8_t fields, uint8_t *out) {
+    encoder->fields = fields;
+    ts_codec_reset(&encoder->state);
+
+    out[0] = HISTORY_FORMAT;
+    out[1] = fields;
+    return HISTORY_HEADER_SIZE;
+}
+
+size_t history_encode_record(struct HistoryEncoder *encoder, const struct LogRecord *record,
+        uint8_t *out) {
+    uint8_t channels = encoder->fields & TS_CODEC_CHANNEL_ALL;
+    switch (record->type) {
+        case LOG_RECORD_READING:
+            if (channels == 0) {
+                return 0;
+            }
+            break;
+        case LOG_RECORD_PUMP_EVENT:
+            if (!(encoder->fields & HISTORY_FIELD_PULSES)) {
+                return 0;
+            }
+            break;
+        default:
+            return 0;
+    }
+
+    return ts_codec_encode(&encoder->state, record, channels, out);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hydro_types.h"
+#include "ts_codec.h"
+
+// Binary history export format.
+//
+// A history starts with a 2-byte header: the format version and a mask of the exported
+// fields. It is followed by the exported records, encoded as a single ts_codec stream (see
+// ts_codec.h) that starts from a reset state. Only the exported reading channels are ever
+// stored, and pump pulse events are only exported with HISTORY_FIELD_PULSES.
+
+#define HISTORY_FORMAT 2
+
+// Reading fields match the ts_codec channels
+#define HISTORY_FIELD_PH        (1 << 0)
+#define HISTORY_FIELD_TEMP      (1 << 1)
+#define HISTORY_FIELD_HUMIDITY  (1 << 2)
+#define HISTORY_FIELD_TDS       (1 << 3)
+#define HISTORY_FIELD_PULSES    (1 << 4)
+#define HISTORY_FIELD_ALL       0x1f
+
+#define HISTORY_HEADER_SIZE 2
+
+// Largest encoded record
+#define HISTORY_RECORD_MAX_SIZE TS_CODEC_RECORD_MAX_SIZE
+
+struct HistoryEncoder {
+    uint8_t fields;
+    struct TsCodecState state;
+};
+
+// Parses a comma separated list of field names (ph, temp, humidity, tds, pulses) into a
+// field mask; the commas may be URL encoded. Returns 0 if a name is unknown.
+uint8_t history_parse_fields(const char *fields);
+
+// Starts a history export; writes its header to `out` and returns the header size
+size_t history_encoder_init(struct HistoryEncoder *encoder, uint8_t fields, uint8_t *out);
+
+// Encodes a log record to `out`, which must fit HISTORY_RECORD_MAX_SIZE bytes. Returns the
+// encoded size, or 0 if the record is not exported.
+size_t history_encode_record(struct HistoryEncoder *encoder, const struct LogRecord *record,
+        uint8_t *out);
@@ -0,0 +1,19 @@
+#include "hydro_json.h"
+
+void hydro_json_add_reading(struct JsonWriter *w, const struct SensorReading *reading) {
+    json_add_int(w, "time", reading->timestamp);
+#define HYDRO_JSON_READING_FIELD(member, key, decimals) \
+    json_add_fixed(w, key, (int32_t)reading->member, decimals);
+    SENSOR_READING_FIELDS(HYDRO_JSON_READING_FIELD)
+#undef HYDRO_JSON_READING_FIELD
+}
+
+void hydro_json_add_pulse_event(struct JsonWriter *w, const struct PumpPulseEvent *event,
+        const char *pump_key) {
+    json_add_uint(w, "seq", event->seq);
+    json_add_int(w, "time", event->timestamp);
+    json_add_uint(w, pump_key, event->pump_id);
+    json_add_uint(w, "len", event->pulse_length);
+    json_add_bool(w, "interrupt", event->was_interrupted);
+    json_add_bool(w, "auto", event->was_automatic);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "hydro_types.h"
+#include "json_writer.h"
+
+// JSON fields of the HydroManager types, shared by every endpoint that sends them.
+// Fields are added to the object that is currently open in the writer.
+
+// Size of the buffer used to serialize JSON responses; longer responses are sent in chunks
+#define HTTP_JSON_BUFFER_SIZE 512
+
+// Max number of pump pulse events sent in a single events response
+#define EVENTS_PAGE_SIZE 16
+
+// Adds "time" and every field of SENSOR_READING_FIELDS
+void hydro_json_add_reading(struct JsonWriter *w, const struct SensorReading *reading);
+
+// Adds "seq", "time", the pump ID under `pump_key`, "len", "interrupt" and "auto"
+void hydro_json_add_pulse_event(struct JsonWriter *w, const struct PumpPulseEvent *event,
+        const char *pump_key);
@@ -5,12 +5,16 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
+#include <stdatomic.h>
 #include <time.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 #include <freertos/semphr.h>
 #include <freertos/task.h>
+#include <driver/gpio.h>
 #include <driver/i2c.h>
 #include <ads111x.h>
 #include <bmp280.h>
@@ -18,65 +22,33 @@
 #include <nvs_flash.h>
 #include <esp_netif.h>
 #include <esp_netif_sntp.h>
+#include <esp_cpu.h>
 #include <esp_event.h>
+#include <esp_heap_caps.h>
 #include <esp_log.h>
+#include <esp_system.h>
+#include <esp_task_wdt.h>
+#include <esp_timer.h>
 #include <esp_wifi.h>
 #include <esp_http_server.h>
-#include <cJSON.h>
-
-//#include <esp_system.h>
-
-//---------------------
-// Type Definitions
-//---------------------
-
-struct StructVersion {
-    uint8_t major;
-    uint8_t minor;
-};
-
-struct SystemSettings {
-    uint32_t magic;
-    struct StructVersion version;
-    uint8_t auto_ph;
-    uint8_t refill_mode;
-    uint32_t ph_stabilize_interval;
-    uint32_t ph_dose_length;
-    uint32_t refill_dose_length;
-};
-
-enum SystemCommandType {
-    CMD_READING_REQUEST,
-    CMD_SETTINGS_UPDATE,
-};
-
-struct SystemCommand {
-    enum SystemCommandType cmd_type;
-    union {
-        struct SystemSettings updated_settings;
-    };
-};
-
-struct SensorReading {
-    time_t timestamp;
-    float ph;
-    float temp;
-    float humidity;
-    uint32_t tds;
-};
-
-struct SystemResponse {
-    enum SystemCommandType cmd_type;
-    union {
-        struct SensorReading reading;
-    };
-};
-
-struct PhCalibration {
-    float ph_7;
-    float ph_4;
-    float ph_10;
-};
+#include <lwip/sockets.h>
+
+#include "display_frame.h"
+#include "event_ring.h"
+#include "flash_log.h"
+#include "history.h"
+#include "hydro_json.h"
+#include "hydro_types.h"
+#include "json_writer.h"
+#include "metrics.h"
+#include "ph_dosing.h"
+#include "pump_control.h"
+#include "sensor_filter.h"
+#include "sensor_math.h"
+#include "scheduler.h"
+#include "sensor_snapshot.h"
+#include "settings_store.h"
+#include "telemetry.h"
 
 //------------------
 // Pin definitions
@@ -90,22 +62,91 @@ struct PhCalibration {
 
 // I2C1 is used for display (SSD1306)
 #define I2C1_PORT 1
-#define I2C1_FREQ_HZ (100 * 1000) // 100kHz
+#define I2C1_FREQ_HZ (400 * 1000) // 400kHz
 #define I2C1_SDA 23
 #define I2C1_SCL 22
 
+// Pump relays; the relay module is active low
+#define PUMP0 CONFIG_HYDRO_MANAGER_PUMP0_GPIO
+#define PUMP1 CONFIG_HYDRO_MANAGER_PUMP1_GPIO
+#define PUMP2 CONFIG_HYDRO_MANAGER_PUMP2_GPIO
+#define PUMP_PH_DOWN PUMP0
+#define PUMP_PH_UP PUMP1
+#define PUMP_REFILL PUMP2
+
+// Overflow water level sensor; high when underwater
+#define OVERFLOW_SENSOR CONFIG_HYDRO_MANAGER_OVERFLOW_SENSOR_GPIO
+
+// ADS1115 ALERT/RDY pin; pulses low when a conversion is ready
+#define ADS1115_ALERT CONFIG_HYDRO_MANAGER_ADS1115_ALERT_GPIO
+
 //---------------
 // Constants
 //---------------
 
-// Auto ph mode values
-#define AUTO_PH_OFF 0
-#define AUTO_PH_ON 1
+// Pump relay levels
+#define PUMP_ON 0
+#define PUMP_OFF 1
+
+// Max number of registered HTTP URI handlers
+#define HTTP_MAX_URI_HANDLERS 16
+
+// Events pages of '/api/events.json' and '/api/telemetry' have the same size
+_Static_assert(EVENTS_PAGE_SIZE <= TELEMETRY_MAX_EVENTS,
+        "an events page must fit in a telemetry frame");
+
+// Collector that telemetry frames are pushed to over UDP; pushing is disabled if the
+// address is empty
+#define TELEMETRY_HOST CONFIG_HYDRO_MANAGER_TELEMETRY_HOST
+#define TELEMETRY_PORT CONFIG_HYDRO_MANAGER_TELEMETRY_PORT
+
+// Milliseconds between telemetry pushes; a frame is only pushed if there is a new reading
+#define TELEMETRY_INTERVAL CONFIG_HYDRO_MANAGER_TELEMETRY_INTERVAL_MS
+
+// Max number of live channel clients; more are refused
+#define LIVE_MAX_CLIENTS 4
+
+// Sockets of the HTTP server that are left for requests, once every live channel client is
+// connected. Only when all of them are kept open too is the least recently used socket
+// closed, which may then be a live channel client.
+#define HTTP_REQUEST_SOCKETS 8
+
+// Max number of open HTTP server sockets; must be at most CONFIG_LWIP_MAX_SOCKETS minus
+// the 3 sockets the HTTP server uses itself and the telemetry socket
+#define HTTP_MAX_SOCKETS (LIVE_MAX_CLIENTS + HTTP_REQUEST_SOCKETS)
+_Static_assert(HTTP_MAX_SOCKETS + 3 + 1 <= CONFIG_LWIP_MAX_SOCKETS,
+        "HTTP server sockets do not fit CONFIG_LWIP_MAX_SOCKETS");
+
+// Max size of a message received from a live channel client
+#define LIVE_MAX_MESSAGE_SIZE 64
+
+// Limits of the pH stabilize interval in milliseconds
+#define PH_STABILIZE_INTERVAL_MIN (30 * 1000)
+#define PH_STABILIZE_INTERVAL_MAX (12 * 60 * 60 * 1000)
+
+// Limits of a refill dose in milliseconds
+#define REFILL_DOSE_MIN (5 * 1000)
+#define REFILL_DOSE_MAX (70 * 1000)
 
-// Refill mode values
-#define REFILL_OFF 0
-#define REFILL_ON 1
-#define REFILL_CIRCULATE 2
+// Every setting that can be changed through /api/settings:
+//
+//     X(member, key, type, min, max)
+//
+// `key` is the name of the setting in forms and JSON, and `type` is `bool` or `uint`.
+// Validation, the JSON fields and form parsing are generated from this list.
+#define SYSTEM_SETTINGS_FIELDS(X) \
+    X(auto_ph, "autoPh", bool, AUTO_PH_OFF, AUTO_PH_ON) \
+    X(refill_mode, "refillMode", uint, REFILL_OFF, REFILL_CIRCULATE) \
+    X(ph_stabilize_interval, "phStabilizeInterval", uint, PH_STABILIZE_INTERVAL_MIN, \
+            PH_STABILIZE_INTERVAL_MAX) \
+    X(ph_dose_length, "phDoseLength", uint, PH_DOSE_MIN, PH_DOSE_MAX) \
+    X(refill_dose_length, "refillDoseLength", uint, REFILL_DOSE_MIN, REFILL_DOSE_MAX)
+
+// Namespace and keys of the blobs stored in NVS
+#define NVS_NAMESPACE "HydroManager"
+#define NVS_KEY_PH_CALIBRATION "PhCalibration"
+#define NVS_KEY_SYSTEM_SETTINGS "SystemSettings"
+#define NVS_KEY_BOOT_COUNT "BootCount"
 
 // Local timezone
 #define TIMEZONE "EST5EDT" 
@@ -113,16 +154,30 @@ struct PhCalibration {
 // NTP server address
 #define NTP_SERVER_ADDR "pool.ntp.org"
 
-// Timeout when waiting for NTP response
-#define NTP_TIMEOUT (pdMS_TO_TICKS(30000))
+// Milliseconds between SNTP time refreshes
+#define SNTP_REFRESH_INTERVAL (6 * 60 * 60 * 1000)
+
+// Timestamps before this time (2023-01-01) were taken before the clock was synced, and
+// count seconds from boot
+#define MIN_SYNCED_TIME 1672531200
 
 // I2C Address for ADS1115 when ADDR is connected to GND
 #define ADS1115_ADDR ADS111X_ADDR_GND
-// Use +-4.096v gain; there will be no signals above 3.3v or below 0v
+// Use +-4.096v gain; there will be no signals above 3.3v or below 0v. ADS1115_FULL_SCALE_MV
+// in sensor_math.h must match it.
 #define ADS1115_GAIN ADS111X_GAIN_4V096
 
-// Readings from the ADS1115 should take a maximux of 40 milliseconds
-#define ADS1115_TIMEOUT (pdMS_TO_TICKS(40 * 2))
+// Conversions are run continuously at 250 samples per second, rotating through the input of
+// every channel in SENSOR_ADC_CHANNELS
+#define ADS1115_DATA_RATE ADS111X_DATA_RATE_250
+
+// A conversion at 250 samples per second takes 4 milliseconds; if the ALERT/RDY interrupt
+// does not arrive by then, the conversion is read anyway
+#define ADS1115_TIMEOUT (pdMS_TO_TICKS(4 * 2) + 1)
+
+// ADS1115 channels of the sensors are listed in SENSOR_ADC_CHANNELS (sensor_math.h); each
+// one is a single-ended input against GND. Unused inputs are not converted.
+#define ADC_NUM_CHANNELS SENSOR_ADC_NUM_CHANNELS
 
 // I2C address for BME280 when SDO is connected to GND
 #define BME280_ADDR BMP280_I2C_ADDRESS_0
@@ -130,20 +185,100 @@ struct PhCalibration {
 // Readings from the BME280 should take a maximum of 10 milliseconds
 #define BME280_TIMEOUT (pdMS_TO_TICKS(10 * 2))
 
-/* The event group allows multiple bits for each event, but we only care about two events:
- * - we are connected to the AP with an IP
- * - we failed to connect after the maximum amount of retries */
+// Set in the WiFi event group while the station is connected to the AP with an IP
 #define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT      BIT1
 
 #define WIFI_SSID CONFIG_HYDRO_MANAGER_SSID
 #define WIFI_PASSWORD CONFIG_HYDRO_MANAGER_PASSWORD
 
-// Max number of WiFi connection attempts
-#define MAX_WIFI_RETRIES 10
+// Milliseconds before the first WiFi reconnection attempt; the delay doubles after every
+// failed attempt, up to `WIFI_RETRY_MAX_DELAY`
+#define WIFI_RETRY_MIN_DELAY 1000
+#define WIFI_RETRY_MAX_DELAY (5 * 60 * 1000)
+
+// Max number of commands waiting for the system control task
+#define SYSTEM_COMMAND_QUEUE_SIZE 8
+
+// Max number of tasks that can send system commands
+#define MAX_SYSTEM_REQUESTERS 4
+
+// Max number of responses waiting for a requesting task; a response that arrives after its
+// request timed out takes a slot until it is discarded
+#define SYSTEM_REPLY_QUEUE_SIZE 2
 
-// Stack size for each task
-#define STACK_SIZE 2048
+// Task topology. Core 0 only runs sampling and control: the ADC, sampler and system
+// control tasks. Core 1 runs everything that writes flash or waits on the network: the I/O
+// and network tasks, the HTTP server, the display and telemetry. The WiFi and lwIP tasks are
+// pinned to core 1 in sdkconfig.defaults. Priorities only order the tasks of the same core.
+//
+// Erasing or programming flash disables the flash cache of both cores, so core 0 is paused
+// for every flash operation of the I/O task too; only code and data in IRAM can run until
+// it finishes. The overflow interrupt is in IRAM, so the pumps are still turned off on
+// time, but the ADC, sampler and control tasks are delayed by up to one flash operation.
+#define CONTROL_CORE 0
+#define IO_CORE 1
+
+// The ADC task has the highest priority on core 0 so conversions are read on time. The
+// sampler is above the control task so it is never preempted by it while publishing a
+// reading.
+#define ADC_TASK_PRIORITY 5
+#define SAMPLER_TASK_PRIORITY 4
+#define CONTROL_TASK_PRIORITY 3
+
+// The network task is above the I/O task so live broadcasts, SNTP and starting or stopping
+// the HTTP server are not delayed by flash writes. The I/O task is above the display and
+// telemetry so records and settings are written first.
+#define NET_TASK_PRIORITY 3
+#define IO_TASK_PRIORITY 2
+#define DISPLAY_TASK_PRIORITY 1
+#define TELEMETRY_TASK_PRIORITY 1
+
+// Stack size of each task in bytes. /api/metrics reports the least free stack of every
+// task to check the margins.
+#define ADC_STACK_SIZE 4096
+#define SAMPLER_STACK_SIZE 3072     // Room for formatting floats in logs
+#define CONTROL_STACK_SIZE 4096     // Pulses, dosing and replies to system commands
+#define IO_STACK_SIZE 4096          // NVS and flash log writes
+#define NET_STACK_SIZE 4096         // Starting and stopping the HTTP server
+#define DISPLAY_STACK_SIZE 4096
+#define TELEMETRY_STACK_SIZE 4096   // lwIP sendto()
+
+// The ADC, sampler and system control tasks are subscribed to the task watchdog and
+// reset it at least this often in milliseconds; it must be well below
+// CONFIG_ESP_TASK_WDT_TIMEOUT_S
+#define WATCHDOG_FEED_INTERVAL 1000
+
+// Milliseconds between sensor samples
+#define SAMPLE_INTERVAL CONFIG_HYDRO_MANAGER_SAMPLE_INTERVAL_MS
+
+// Seconds between readings written to the flash log
+#define LOG_INTERVAL CONFIG_HYDRO_MANAGER_LOG_INTERVAL_S
+
+// Label of the flash log partition in partitions.csv
+#define LOG_PARTITION_LABEL "hydrolog"
+
+// Max number of work items waiting for the I/O task
+#define IO_QUEUE_SIZE 32
+
+// Max number of work items waiting for the network task
+#define NET_QUEUE_SIZE 8
+
+// Events that wake the system control task; sent as bits of its task notification
+#define CONTROL_EVENT_COMMAND (1 << 0)
+#define CONTROL_EVENT_OVERFLOW (1 << 1)
+#define CONTROL_EVENT_READING (1 << 2)
+
+// Milliseconds between checks of the overflow sensor while it is set
+#define OVERFLOW_POLL_INTERVAL 100
+
+// Milliseconds between refill doses in refill mode
+#define REFILL_INTERVAL (60 * 60 * 1000)
+
+// Milliseconds between display refreshes
+#define DISPLAY_REFRESH_INTERVAL 1000
+
+// Timeout of each I2C transfer to the display
+#define DISPLAY_I2C_TIMEOUT (pdMS_TO_TICKS(50))
 
 // Tag used for ESP logging functions
 const char *TAG = "HydroManager";
@@ -170,46 +305,200 @@ bmp280_params_t bme280_params = {0};
 // SSD1306 display
 ssd1306_handle_t ssd1306_dev = NULL;
 
+// Frame buffer of the display; owned by the display task
+struct DisplayFrame g_display_frame;
+
 // Global system settings
-struct SystemSettings g_system_settings = {
-    .magic = 0xc0ffee15,
-    .version = {
-        .major = 1,
-        .minor = 0
-    },
-    .auto_ph = AUTO_PH_ON,
-    .refill_mode = REFILL_OFF,
-    .ph_stabilize_interval = 30 * 60 * 1000,    // 30 minutes
-    .ph_dose_length = 1000,                     // 1 second
-    .refill_dose_length = 30 * 1000             // 30 seconds
-};
+// Current system settings; only published by the system control task and read without
+// locks from any task
+struct SettingsStore g_settings;
 
 // Global pH calibration
-struct PhCalibration g_ph_cal = {
-    .ph_7 = 1500.0f,
-    .ph_4 = 2030.0f,
-    .ph_10 = 975.0f,
-};
+struct PhCalibration g_ph_cal;
 
-// FreeRTOS event group to signal when we are connected
+// pH lookup tables of the calibration. The sampler uses the table pointed to by
+// `g_ph_table`; a new calibration is built into the other table before it is swapped in.
+struct PhTable g_ph_tables[2];
+struct PhTable *_Atomic g_ph_table;
+
+// FreeRTOS event group with the current WiFi connection state
 EventGroupHandle_t g_wifi_event_group;
 
+// Number of failed WiFi connection attempts in a row; only used by the event loop task
+uint32_t g_wifi_retried = 0;
+
+// Reconnects to the AP once the backoff delay of a failed attempt has passed
+esp_timer_handle_t g_wifi_retry_timer;
+
+// Number of times the station connected to the AP since boot
+_Atomic uint32_t g_wifi_connections = 0;
+
+// Set once the system time has been synced from the SNTP server
+atomic_bool g_time_synced = false;
+
+// Wall clock time of boot in seconds; found on the first SNTP sync, and 0 until then
+_Atomic uint32_t g_boot_time = 0;
+
 // Queue of system commands
 QueueHandle_t g_system_command_queue;
 
-// Queue of system responses; one for each async worker and one
-// for a single synchronous worker
-QueueHandle_t g_system_response_queue;
+// Reply queue of each task that sent a system command; entries are created on a task's
+// first command and kept, so a late response never goes to a deleted queue
+struct SystemRequester {
+    TaskHandle_t task;
+    QueueHandle_t reply_queue;
+} g_system_requesters[MAX_SYSTEM_REQUESTERS];
+SemaphoreHandle_t g_system_requesters_mutex;
+
+// ID of the next system command
+_Atomic uint32_t g_system_next_request_id = 1;
+
+// Filter of each ADC channel; only used by the ADC task
+struct SensorFilter g_adc_filters[ADC_NUM_CHANNELS];
 
-// Current number of WiFi connection attempts
-int g_wifi_retried = 0;
+// Latest filtered conversion of each ADC channel; written only by the ADC task
+_Atomic int32_t g_adc_raw[ADC_NUM_CHANNELS];
 
-// Mutex for reading from ADC
-SemaphoreHandle_t g_adc_mutex;
+// Number of filtered values of each ADC channel so far
+_Atomic uint32_t g_adc_conversions[ADC_NUM_CHANNELS];
 
 // Mutex for reading from BME280
 SemaphoreHandle_t g_bme280_mutex;
 
+// Latched by the overflow sensor interrupt; cleared by the system control task once the
+// sensor is no longer set. No pump can be turned on while this is set.
+volatile bool g_overflow_fault = false;
+
+// Pump pulse in progress; owned by the system control task
+struct PumpPulse g_pump_pulse = {0};
+
+// System control task; woken by its task notification whenever it has work
+TaskHandle_t g_system_control_task;
+
+// Jobs run by the system control task at their deadlines
+enum ControlJob {
+    JOB_PUMP_PULSE_END,
+    JOB_OVERFLOW_POLL,
+    JOB_PH_CHECK,
+    JOB_REFILL,
+    JOB_SNTP_REFRESH,
+};
+
+// Priority of each control job; jobs that keep the pumps accurate come first
+const uint8_t CONTROL_JOB_PRIORITY[] = {
+    [JOB_PUMP_PULSE_END] = 3,
+    [JOB_OVERFLOW_POLL] = 3,
+    [JOB_PH_CHECK] = 2,
+    [JOB_REFILL] = 2,
+    [JOB_SNTP_REFRESH] = 1,
+};
+
+// Deadlines of the control jobs; owned by the system control task
+struct Scheduler g_control_scheduler;
+
+// Set when a pH check is due; the check runs on the next reading. Owned by the system
+// control task.
+bool g_ph_check_due = false;
+
+// Sizes pH doses and learns the response of the reservoir to them. Owned by the system
+// control task.
+struct PhDosing g_ph_dosing;
+
+// Number of this boot, counted in NVS. Sequence numbers of the event ring restart on every
+// boot, so clients send the boot ID with their event cursor.
+uint32_t g_boot_id;
+
+// Pump pulse events; produced by the system control task and consumed by the HTTP server
+struct EventRing g_pump_events;
+
+// Latest sensor reading; published by the sampler task on core 0 and read without locks
+// from any task
+struct SensorSnapshot g_sensor_snapshot;
+
+// History of readings and pump pulse events in flash; only appended to by the I/O task
+struct FlashLog g_flash_log;
+
+// Set on boot if the flash log was opened
+bool g_flash_log_ready = false;
+
+// Sequence number of the first flash log page of this boot
+uint32_t g_boot_log_seq;
+
+// Work queues of core 1: flash writes are drained by the I/O task and networking by the
+// network task. The system command queue is the work queue of core 0.
+QueueHandle_t g_io_queue;
+QueueHandle_t g_net_queue;
+
+// Number of work items dropped because the I/O or network queue was full
+_Atomic uint32_t g_io_work_dropped = 0;
+
+// Set while a settings save is queued for the I/O task
+atomic_bool g_settings_save_queued = false;
+
+// Buffer used to serialize JSON responses. The HTTP server runs one handler at a time on
+// a single task, so every handler can share it.
+char g_http_json_buffer[HTTP_JSON_BUFFER_SIZE];
+
+// Flash log page read by the history handler; shared for the same reason
+struct FlashLogPage g_http_history_page;
+
+// Stages of the program whose CPU cycles are counted for /api/metrics
+enum MetricsStage {
+    STAGE_ADC_CONVERSION,
+    STAGE_BME280_READ,
+    STAGE_QUEUE_WAIT,
+    STAGE_JSON_BUILD,
+    STAGE_HTTPD_SEND,
+    STAGE_COUNT,
+};
+
+const char *const METRICS_STAGE_NAMES[] = {
+    [STAGE_ADC_CONVERSION] = "adc_conversion",
+    [STAGE_BME280_READ] = "bme280_read",
+    [STAGE_QUEUE_WAIT] = "queue_wait",
+    [STAGE_JSON_BUILD] = "json_build",
+    [STAGE_HTTPD_SEND] = "httpd_send",
+};
+
+struct StageCounter g_stage_counters[STAGE_COUNT];
+
+// Cycle count when the JSON response that is being built was started, and the cycles spent
+// sending it so far. Only used by the HTTP server task.
+uint32_t g_http_json_start_cycles;
+uint32_t g_http_json_send_cycles;
+
+// An HTTP endpoint and the latencies of its requests
+struct HttpEndpoint {
+    const char *uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t *req);
+    bool is_websocket;
+    struct LatencyHistogram latency;
+};
+
+// Endpoints registered with the HTTP server; set by start_http_server
+struct HttpEndpoint *g_http_endpoints;
+size_t g_http_endpoint_count;
+
+// Tasks whose stack high water marks are reported in /api/metrics
+TaskHandle_t g_adc_task;
+TaskHandle_t g_sampler_task;
+TaskHandle_t g_display_task;
+TaskHandle_t g_io_task;
+TaskHandle_t g_net_task;
+TaskHandle_t g_telemetry_task;
+
+// HTTP server; started when WiFi connects and stopped when it disconnects
+httpd_handle_t _Atomic g_http_server = NULL;
+
+// Set while a live broadcast is queued on the HTTP server task
+atomic_bool g_live_broadcast_queued = false;
+
+// Latest snapshot generation and pump event sent to live clients; only used by the HTTP
+// server task
+uint32_t g_live_generation = 0;
+uint32_t g_live_event_seq = 0;
+
 // Much of this code is based off the examples in https://github.com/espressif/esp-idf/tree/master/examples
 //
 // * Wifi connection - https://github.com/espressif/esp-idf/blob/4fc2e5cb95/examples/wifi/getting_started/station/main/station_example_main.c
@@ -219,32 +508,47 @@ SemaphoreHandle_t g_bme280_mutex;
 // WiFi Functions
 //------------------------
 
+// Milliseconds to wait before reconnecting after `retried` failed attempts in a row
+uint32_t wifi_retry_delay(uint32_t retried) {
+    uint32_t delay = WIFI_RETRY_MIN_DELAY;
+    for (; retried > 0 && delay < WIFI_RETRY_MAX_DELAY; --retried) {
+        delay *= 2;
+    }
+    return delay < WIFI_RETRY_MAX_DELAY ? delay : WIFI_RETRY_MAX_DELAY;
+}
+
+void wifi_retry_timer_handler(void *arg) {
+    esp_wifi_connect();
+}
+
 void wifi_system_event_handler(void *arg, esp_event_base_t event_base,
         int32_t event_id, void *event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         // Connect to AP when WiFi station has started
         esp_wifi_connect();
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        // Try to reconnect to WiFi when it disconnects
-        if (g_wifi_retried < MAX_WIFI_RETRIES) {
-            esp_wifi_connect();
+        // Every failed connection attempt also ends here. The system keeps running while
+        // disconnected, so it keeps retrying with exponential backoff instead of giving up.
+        xEventGroupClearBits(g_wifi_event_group, WIFI_CONNECTED_BIT);
+        uint32_t delay = wifi_retry_delay(g_wifi_retried);
+        if (delay < WIFI_RETRY_MAX_DELAY) {
             g_wifi_retried += 1;
-            ESP_LOGI(TAG, "Trying to reconnect to AP");
-        } else {
-            // Signal if WiFi fails to disconnect many times in a row
-            xEventGroupSetBits(g_wifi_event_group, WIFI_FAIL_BIT);
         }
-        ESP_LOGI(TAG, "Failed to reconnect to the AP");
+        ESP_LOGI(TAG, "Disconnected from AP; reconnecting in %" PRIu32 " ms", delay);
+        esp_timer_stop(g_wifi_retry_timer);
+        ESP_ERROR_CHECK(esp_timer_start_once(g_wifi_retry_timer, (uint64_t)delay * 1000));
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         // Signal if IP address was assigned
         ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
         ESP_LOGI(TAG, "Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
         g_wifi_retried = 0;
+        atomic_fetch_add(&g_wifi_connections, 1);
         xEventGroupSetBits(g_wifi_event_group, WIFI_CONNECTED_BIT);
     }
 }
 
-// TODO: Find better way to signal if device is currently connected to WiFi AP
+// Initializes the WiFi station; it connects once `esp_wifi_start()` is called, and never
+// blocks the caller
 void wifi_init() {
     // Initialize WiFi event group
     g_wifi_event_group = xEventGroupCreate();
@@ -262,6 +566,13 @@ void wifi_init() {
     wifi_init_config_t init_config = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&init_config));
 
+    // Create the reconnection timer; it runs on the esp_timer task
+    const esp_timer_create_args_t retry_timer_args = {
+        .callback = &wifi_retry_timer_handler,
+        .name = "wifi_retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&retry_timer_args, &g_wifi_retry_timer));
+
     // Register WiFi system event handlers
     esp_event_handler_instance_t instance_any_id;
     esp_event_handler_instance_t instance_got_ip;
@@ -281,325 +592,1901 @@ void wifi_init() {
     };
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-    ESP_ERROR_CHECK(esp_wifi_start());
     ESP_LOGI(TAG, "WiFi station initialized");
-
-    // Wait for AP to assign IP
-    EventBits_t bits = xEventGroupWaitBits(g_wifi_event_group,
-            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdFALSE, pdFALSE,
-            portMAX_DELAY);
-
-    /* xEventGroupWaitBits() returns the bits before the call returned, hence we can test which event actually
-     * happened. */
-    if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "Connected to AP");
-    } else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGI(TAG, "Failed to connect to AP");
-    } else {
-        ESP_LOGE(TAG, "UNEXPECTED EVENT");
-    }
 }
 
 //------------------
 // Sensor Functions
 //------------------
 
-esp_err_t adc_read(int mux, int16_t *raw_out) {
-    if (mux < 0 || mux > 3) {
-        ESP_LOGE(TAG, "adc_read: invalid mux (%d)", mux);
-        return ESP_ERR_INVALID_STATE;
-    }
-
-    ESP_LOGI(TAG, "Start ADC reading from mux %d", mux);
+// ADS1115 ALERT/RDY interrupt; wakes the ADC task passed in `arg`
+void IRAM_ATTR adc_ready_isr_handler(void *arg) {
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    vTaskNotifyGiveFromISR((TaskHandle_t)arg, &higher_priority_task_woken);
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+}
 
-    if (xSemaphoreTake(g_adc_mutex, ADS1115_TIMEOUT) == pdFALSE) {
-        return ESP_ERR_TIMEOUT;
+// Latest filtered conversion of an ADC channel. Returns ESP_ERR_INVALID_STATE if the channel
+// was not converted yet.
+esp_err_t adc_read(enum SensorAdcChannel channel, int32_t *raw_out) {
+    if (channel >= ADC_NUM_CHANNELS) {
+        ESP_LOGE(TAG, "adc_read: invalid channel (%d)", channel);
+        return ESP_ERR_INVALID_ARG;
     }
 
-    ESP_ERROR_CHECK(ads111x_set_input_mux(&i2c0_dev, ADS111X_MUX_0_GND + mux));
-    ESP_ERROR_CHECK(ads111x_start_conversion(&i2c0_dev));
-
-    bool busy = true;
-    while (busy) {
-        ESP_ERROR_CHECK(ads111x_is_busy(&i2c0_dev, &busy));
+    if (atomic_load(&g_adc_conversions[channel]) == 0) {
+        return ESP_ERR_INVALID_STATE;
     }
 
-    ESP_ERROR_CHECK(ads111x_get_value(&i2c0_dev, raw_out));
-
-    xSemaphoreGive(g_adc_mutex);
-
-    ESP_LOGI(TAG, "Finished ADC reading on mux %d; got raw value %d", mux, *raw_out);
-
+    *raw_out = atomic_load(&g_adc_raw[channel]);
     return ESP_OK;
 }
 
-float adc_raw_to_volts(int16_t raw) {
-    return ads111x_gain_values[ADS1115_GAIN] / ADS111X_MAX_VALUE * raw;
+int32_t adc_raw_to_mv(int32_t raw) {
+    return sensor_raw_to_mv(raw, ADS1115_FULL_SCALE_MV);
 }
 
-esp_err_t bme280_read(float *temp, float *humidity) {
-    ESP_LOGI(TAG, "Start BME280 reading");
-
+// Reads the temperature in centi-degrees Celsius and humidity in centi-%RH
+esp_err_t bme280_read(int32_t *temp, int32_t *humidity) {
     if (xSemaphoreTake(g_bme280_mutex, BME280_TIMEOUT) == pdFALSE) {
         return ESP_ERR_TIMEOUT;
     }
 
-    float _pressure;
-    ESP_ERROR_CHECK(bmp280_read_float(&bme280_dev, temp, &_pressure, humidity));
+    uint32_t _pressure, humidity_q10;
+    uint32_t start_cycles = esp_cpu_get_cycle_count();
+    ESP_ERROR_CHECK(bmp280_read_fixed(&bme280_dev, temp, &_pressure, &humidity_q10));
+    stage_counter_add(&g_stage_counters[STAGE_BME280_READ],
+            esp_cpu_get_cycle_count() - start_cycles);
 
     xSemaphoreGive(g_bme280_mutex);
 
-    ESP_LOGI(TAG, "Finished BME280 reading: T(%f C), H(%f %%)", *temp, *humidity);
+    *humidity = sensor_humidity_to_centi(humidity_q10);
+
+    ESP_LOGD(TAG, "BME280 reading: T(%" PRId32 " cC), H(%" PRId32 " c%%)", *temp, *humidity);
 
     return ESP_OK;
 }
 
-//------------------------
-// HTTP Server Functions
-//------------------------
+// Takes a reading from every sensor
+esp_err_t sensor_sample(struct SensorReading *reading) {
+    int32_t raw[ADC_NUM_CHANNELS];
+    for (int i = 0; i < ADC_NUM_CHANNELS; ++i) {
+        esp_err_t err = adc_read(i, &raw[i]);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
 
-esp_err_t handle_http_api_readings(httpd_req_t *req) {
-    ESP_LOGI(TAG, "/api/readings.json");
+    int32_t temp, humidity;
+    esp_err_t err = bme280_read(&temp, &humidity);
+    if (err != ESP_OK) {
+        return err;
+    }
 
-    // 15 second timeout
-    const TickType_t timeout = pdMS_TO_TICKS(15000);
+    sensor_reading_convert(reading, atomic_load(&g_ph_table), raw, ADS1115_FULL_SCALE_MV, temp,
+            humidity, time(NULL));
 
-    // Send system command to core 0
-    struct SystemCommand cmd = {
-        .cmd_type = CMD_READING_REQUEST,
-    };
-    if (xQueueSendToBack(g_system_command_queue, &cmd, timeout) == errQUEUE_FULL) {
-        ESP_LOGE(TAG, "System command queue is full");
-        return ESP_ERR_TIMEOUT;
-    }
+    return ESP_OK;
+}
 
-    // Wait for sensor reading from core 0
-    struct SystemResponse response;
-    if (xQueueReceive(g_system_response_queue, &response, timeout) == pdFALSE) {
-        ESP_LOGE(TAG, "Timeout while waiting for system response");
-        return ESP_ERR_TIMEOUT;
+// Builds the lookup table of `g_ph_cal` and swaps it in. Must only be called from the
+// system control task, or before it starts.
+void ph_calibration_apply() {
+    struct PhTable *table = atomic_load(&g_ph_table);
+    struct PhTable *next = (table == &g_ph_tables[0]) ? &g_ph_tables[1] : &g_ph_tables[0];
+
+    sensor_ph_table_init(next, &g_ph_cal);
+    atomic_store(&g_ph_table, next);
+}
+
+// Writes `g_ph_cal` to flash
+esp_err_t ph_calibration_save() {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
     }
 
-    if (response.cmd_type != CMD_READING_REQUEST) {
-        ESP_LOGE(TAG, "System response is an unexepcted type");
-        return ESP_ERR_INVALID_STATE;
+    err = nvs_set_blob(nvs_handle, NVS_KEY_PH_CALIBRATION, (const void *)&g_ph_cal,
+            sizeof(struct PhCalibration));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
     }
+    nvs_close(nvs_handle);
 
-    // Serialize JSON response
-    cJSON *json = cJSON_CreateObject();
-    cJSON_AddNumberToObject(json, "time", time(NULL));
-    cJSON_AddNumberToObject(json, "ph", response.reading.ph);
-    cJSON_AddNumberToObject(json, "tds", response.reading.tds);
-    cJSON_AddNumberToObject(json, "temp", response.reading.temp);
-    cJSON_AddNumberToObject(json, "humidity", response.reading.humidity);
-    char *json_response = cJSON_Print(json);
+    return err;
+}
 
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json_response, HTTPD_RESP_USE_STRLEN);
-    return ESP_OK;
+// Delays like vTaskDelayUntil(), but resets the task watchdog at least every
+// `WATCHDOG_FEED_INTERVAL` while waiting, so long sample intervals do not trigger it
+void watchdog_delay_until(TickType_t *last_wake, TickType_t period) {
+    const TickType_t feed_interval = pdMS_TO_TICKS(WATCHDOG_FEED_INTERVAL);
+    while (period > feed_interval) {
+        vTaskDelayUntil(last_wake, feed_interval);
+        esp_task_wdt_reset();
+        period -= feed_interval;
+    }
+    vTaskDelayUntil(last_wake, period);
+    esp_task_wdt_reset();
 }
 
-httpd_handle_t start_http_server() {
-    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+// Runs ADS1115 conversions continuously, rotating through the input of every channel.
+//
+// The task sleeps until the ALERT/RDY interrupt signals that a conversion is ready, so the
+// I2C bus is not polled and core 0 is free between conversions. Changing the mux restarts
+// the conversion, but the first conversion after a change can still be settling, so it is
+// discarded. Every other conversion is passed through the channel's filter.
+//
+// The task watchdog resets the system if conversions stop, for example if the I2C bus
+// hangs.
+void adc_task(void *pvParameters) {
+    ESP_ERROR_CHECK(esp_task_wdt_add(NULL));
+    for (int i = 0; i < ADC_NUM_CHANNELS; ++i) {
+        sensor_filter_init(&g_adc_filters[i], CONFIG_HYDRO_MANAGER_FILTER_OVERSAMPLE,
+                CONFIG_HYDRO_MANAGER_FILTER_MEDIAN_SIZE, CONFIG_HYDRO_MANAGER_FILTER_EMA_SHIFT);
+    }
 
-    // Set HTTP server to run only on core 1
-    config.core_id = 1;
+    ESP_ERROR_CHECK(gpio_isr_handler_add(ADS1115_ALERT, adc_ready_isr_handler,
+                xTaskGetCurrentTaskHandle()));
 
-    httpd_handle_t server = NULL;
+    int channel = 0;
+    ESP_ERROR_CHECK(ads111x_set_input_mux(&i2c0_dev,
+                ADS111X_MUX_0_GND + SENSOR_ADC_CHANNEL_INPUT[channel]));
+    ESP_ERROR_CHECK(ads111x_set_mode(&i2c0_dev, ADS111X_MODE_CONTINUOUS));
 
-    // Start http server
-    ESP_ERROR_CHECK(httpd_start(&server, &config));
+    bool settling = true;
+    bool alert_missing = false;
+    for (;;) {
+        esp_task_wdt_reset();
 
-    const httpd_uri_t api_readings_uri = {
-        .uri = "/api/readings.json",
-        .method = HTTP_GET,
-        .handler = handle_http_api_readings,
-    };
+        // Fall back to reading after a timeout in case the ALERT/RDY pin is not connected
+        if (ulTaskNotifyTake(pdTRUE, ADS1115_TIMEOUT) == 0 && !alert_missing) {
+            ESP_LOGW(TAG, "ADS1115 ALERT/RDY interrupt timed out; falling back to timed reads");
+            alert_missing = true;
+        }
 
-    // Register URI handlers
-    httpd_register_uri_handler(server, &api_readings_uri);
+        if (settling) {
+            settling = false;
+            continue;
+        }
 
-    ESP_LOGI(TAG, "HTTP server started.");
+        int16_t raw;
+        int32_t filtered;
+        uint32_t start_cycles = esp_cpu_get_cycle_count();
+        esp_err_t err = ads111x_get_value(&i2c0_dev, &raw);
+        stage_counter_add(&g_stage_counters[STAGE_ADC_CONVERSION],
+                esp_cpu_get_cycle_count() - start_cycles);
+        if (err == ESP_OK) {
+            if (sensor_filter_add(&g_adc_filters[channel], raw, &filtered)) {
+                atomic_store(&g_adc_raw[channel], filtered);
+                atomic_fetch_add(&g_adc_conversions[channel], 1);
+            }
+        } else {
+            ESP_LOGE(TAG, "Failed to read ADC channel %d: %s", channel, esp_err_to_name(err));
+        }
 
-    return server;
+        // Move on to the next channel
+        channel = (channel + 1) % ADC_NUM_CHANNELS;
+        err = ads111x_set_input_mux(&i2c0_dev,
+                ADS111X_MUX_0_GND + SENSOR_ADC_CHANNEL_INPUT[channel]);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to set ADC channel %d: %s", channel, esp_err_to_name(err));
+        }
+        settling = true;
+    }
 }
 
-esp_err_t stop_http_server(httpd_handle_t server) {
-    return httpd_stop(server);
+//------------------
+// Settings Functions
+//------------------
+
+bool system_setting_in_range(uint32_t value, uint32_t min, uint32_t max) {
+    return value >= min && value <= max;
 }
 
-void refresh_sntp() {
-    // Connect to SNTP server
-    if (esp_netif_sntp_sync_wait(NTP_TIMEOUT) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to get system time from SNTP server");
-        return;
+bool system_settings_is_valid(const struct SystemSettings *settings) {
+#define SYSTEM_SETTING_IN_RANGE(member, key, type, min, max) \
+        && system_setting_in_range(settings->member, min, max)
+    return settings->magic == SYSTEM_SETTINGS_MAGIC
+        && settings->version.major == SYSTEM_SETTINGS_VERSION_MAJOR
+        SYSTEM_SETTINGS_FIELDS(SYSTEM_SETTING_IN_RANGE);
+#undef SYSTEM_SETTING_IN_RANGE
+}
+
+// Writes settings to flash
+esp_err_t system_settings_save(const struct SystemSettings *settings) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
     }
 
-    time_t timestamp;
-    time(&timestamp);
-    char strftime_buf[64];
-    struct tm timeinfo;
+    err = nvs_set_blob(nvs_handle, NVS_KEY_SYSTEM_SETTINGS, (const void *)settings,
+            sizeof(struct SystemSettings));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
 
-    localtime_r(&timestamp, &timeinfo);
-    strftime(strftime_buf, sizeof(strftime_buf), "%c", &timeinfo);
-    ESP_LOGI(TAG, "Datetime: %s", strftime_buf);
+    return err;
 }
 
-void wifi_connect_handler(void *arg, esp_event_base_t event_base,
-        int32_t event_id, void *event_data) {
-    // Get time from SNTP server
-    refresh_sntp();
+// Saves the latest published settings to flash unless generation `*saved_generation` is
+// the latest. Updates published while a save is queued or running are merged into the
+// next save.
+void system_settings_persist(uint32_t *saved_generation) {
+    atomic_store(&g_settings_save_queued, false);
 
-    // Start HTTP server
-    httpd_handle_t *server = (httpd_handle_t *)arg;
-    if (*server == NULL) {
-        ESP_LOGI(TAG, "Starting HTTP server");
-        *server = start_http_server();
+    struct SystemSettings settings;
+    uint32_t generation = settings_store_read(&g_settings, &settings);
+    if (generation == *saved_generation) {
+        return;
     }
-}
 
-void wifi_disconnect_handler(void *arg, esp_event_base_t event_base,
-        int32_t event_id, void *event_data) {
-    httpd_handle_t *server = (httpd_handle_t *)arg;
-    if (*server) {
-        ESP_LOGI(TAG, "Stopping HTTP server");
-        if (stop_http_server(*server) == ESP_OK) {
-            *server = NULL;
-        } else {
-            ESP_LOGE(TAG, "Failed to stop HTTP server");
-        }
+    esp_err_t err = system_settings_save(&settings);
+    if (err == ESP_OK) {
+        *saved_generation = generation;
+        ESP_LOGI(TAG, "Saved settings generation %" PRIu32, generation);
+    } else {
+        ESP_LOGE(TAG, "Failed to save settings: %s", esp_err_to_name(err));
     }
 }
 
-//-----------------------------
-// System Command Functions
-//-----------------------------
+//------------------
+// Time Functions
+//------------------
+
+// Records logged while offline on boot are timestamped before the first SNTP sync, so their
+// timestamps count from 1970. They are moved to the wall clock when they are sent, once the
+// time of boot is known.
+
+// Moves a timestamp of this boot that was taken before the first SNTP sync to the wall
+// clock. Synced timestamps are returned unchanged, and so is every timestamp until the
+// first sync.
+uint32_t time_from_boot(uint32_t timestamp) {
+    uint32_t boot_time = atomic_load(&g_boot_time);
+    if (timestamp >= MIN_SYNCED_TIME || boot_time == 0) {
+        return timestamp;
+    }
+    return boot_time + timestamp;
+}
 
-void system_send_reading() {
-    ESP_LOGI(TAG, "Sending system reading to queue");
+// Gets a pump pulse event like event_ring_get(), with its timestamp moved to the wall clock.
+// The event ring is in RAM, so every event in it is from this boot.
+bool pump_event_get(uint32_t seq, struct PumpPulseEvent *event) {
+    if (!event_ring_get(&g_pump_events, seq, event)) {
+        return false;
+    }
+    event->timestamp = time_from_boot(event->timestamp);
+    return true;
+}
 
-    int16_t ph_raw, tds_raw;
-    ESP_ERROR_CHECK(adc_read(0, &ph_raw));
-    ESP_ERROR_CHECK(adc_read(1, &tds_raw));
+//------------------
+// Live Functions
+//------------------
 
-    float ph = adc_raw_to_volts(ph_raw) * 4.0f;
-    float tds = adc_raw_to_volts(tds_raw) * 1000.0f;
+// Live readings and pump events are pushed to every client of the `/api/live` WebSocket.
+//
+// Producers call live_notify(), which has the network task queue a single broadcast on the
+// HTTP server task.
+// The broadcast sends the latest reading from the snapshot and every pump event that was
+// not sent yet, so any number of clients costs one sample and notifications that arrive
+// while a broadcast is queued are merged into it.
+
+// Finds the sockets of the WebSocket clients among the HTTP server's sockets and returns
+// their number
+size_t live_get_clients(httpd_handle_t server, int fds[HTTP_MAX_SOCKETS]) {
+    size_t fd_count = HTTP_MAX_SOCKETS;
+    if (httpd_get_client_list(server, &fd_count, fds) != ESP_OK) {
+        return 0;
+    }
 
-    float temp, humidity;
-    ESP_ERROR_CHECK(bme280_read(&temp, &humidity));
-    // TODO: Figure out how to round floats without using division.
-    // ESP32s implement floating point division in software and it is not precise at all.
-    // This makes rounding to even 1 or 2 decimal digits impossible using a simple round()
-    // implementation.
-    struct SystemResponse response = {
-        .cmd_type = CMD_READING_REQUEST,
-        .reading = {
-            .ph = ph,
-            .tds = (uint32_t)tds,
-            .temp = temp,
-            .humidity = humidity
+    size_t count = 0;
+    for (size_t i = 0; i < fd_count; ++i) {
+        if (httpd_ws_get_fd_info(server, fds[i]) == HTTPD_WS_CLIENT_WEBSOCKET) {
+            fds[count++] = fds[i];
         }
-    };
-    const TickType_t timeout = 10;
-    if (xQueueSendToBack(g_system_response_queue, &response, timeout) == errQUEUE_FULL) {
-        ESP_LOGE(TAG, "Failed to send system response; queue full");
-        return;
     }
+    return count;
 }
 
-//--------------------------------------------------
-// Initialization, Event loops, and Main Function
-//--------------------------------------------------
+// Sends `w`'s buffer as a text frame to the WebSocket client of socket `fd`
+void live_send(httpd_handle_t server, int fd, struct JsonWriter *w) {
+    httpd_ws_frame_t frame = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)w->buf,
+        .len = w->len,
+    };
+    httpd_ws_send_frame_async(server, fd, &frame);
+}
 
-void initialize_hardware() {
-    // Initialize flash storage
-    ESP_ERROR_CHECK(nvs_flash_init());
+// Sends `w`'s buffer as a text frame to every WebSocket client
+void live_send_all(httpd_handle_t server, struct JsonWriter *w) {
+    int fds[HTTP_MAX_SOCKETS];
+    size_t count = live_get_clients(server, fds);
+    for (size_t i = 0; i < count; ++i) {
+        live_send(server, fds[i], w);
+    }
+}
 
-    // Initialize WiFi; blocks until IP is assigned
-    // TODO: How should this system function when disconnected from WiFi?
-    wifi_init();
+// Writes a reading message of the live channel to `w`
+void live_write_reading(struct JsonWriter *w, const struct SensorReading *reading) {
+    json_writer_init(w, g_http_json_buffer, sizeof(g_http_json_buffer), NULL, NULL);
+    json_object_begin(w);
+    json_add_string(w, "type", "reading");
+    hydro_json_add_reading(w, reading);
+    json_object_end(w);
+}
 
-    // Initialize I2C0
-    ESP_ERROR_CHECK(i2cdev_init());
-    ESP_LOGI(TAG, "I2C0 initialized.");
+void live_broadcast(void *arg) {
+    atomic_store(&g_live_broadcast_queued, false);
+    httpd_handle_t server = atomic_load(&g_http_server);
+    if (server == NULL) {
+        return;
+    }
 
-    // Initialize ADS1115 ADC module with the following configuration:
-    //  * Single shot mode
-    //  * 128 samples per second
-    //  * A0-GND mux
-    //  * +-4.096 volt range
-    ESP_ERROR_CHECK(ads111x_init_desc(&i2c0_dev, ADS1115_ADDR, I2C0_PORT, I2C0_SDA,
-                I2C0_SCL));
-    i2c0_dev.cfg.master.clk_speed = I2C0_FREQ_HZ;   // Ensure I2C frequency is set
-    ESP_ERROR_CHECK(ads111x_set_mode(&i2c0_dev, ADS111X_MODE_SINGLE_SHOT));
-    ESP_ERROR_CHECK(ads111x_set_data_rate(&i2c0_dev, ADS111X_DATA_RATE_128));
-    ESP_ERROR_CHECK(ads111x_set_input_mux(&i2c0_dev, ADS111X_MUX_0_GND));
-    ESP_ERROR_CHECK(ads111x_set_gain(&i2c0_dev, ADS1115_GAIN));
-    ESP_LOGI(TAG, "ADS1115 initialized.");
+    // Messages are small enough to always fit the buffer, so no flush function is needed
+    struct JsonWriter w;
 
-    // Initialize BME280 temp/humidity/pressure sensor
-    ESP_ERROR_CHECK(bmp280_init_desc(&bme280_dev, BME280_ADDR, I2C0_PORT, I2C0_SDA,
-                I2C0_SCL));
-    ESP_ERROR_CHECK(bmp280_init_default_params(&bme280_params));
-    ESP_ERROR_CHECK(bmp280_init(&bme280_dev, &bme280_params));
-    ESP_LOGI(TAG, "BME280 initialized.");
+    uint32_t generation = sensor_snapshot_generation(&g_sensor_snapshot);
+    struct SensorReading reading;
+    if (generation != g_live_generation && sensor_snapshot_read(&g_sensor_snapshot, &reading)) {
+        g_live_generation = generation;
+        live_write_reading(&w, &reading);
+        live_send_all(server, &w);
+    }
 
-    // Initialize I2C1
-    ESP_ERROR_CHECK(i2c_param_config(I2C1_PORT, &i2c1_conf));
-    ESP_ERROR_CHECK(i2c_driver_install(I2C1_PORT, i2c1_conf.mode, 0, 0, 0));
-    ESP_LOGI(TAG, "I2C1 initialized.");
+    // Events that were already released by the events endpoint are skipped
+    uint32_t seq = event_ring_first_seq(&g_pump_events);
+    if (seq <= g_live_event_seq) {
+        seq = g_live_event_seq + 1;
+    }
+    struct PumpPulseEvent event;
+    for (; pump_event_get(seq, &event); ++seq) {
+        g_live_event_seq = seq;
+
+        json_writer_init(&w, g_http_json_buffer, sizeof(g_http_json_buffer), NULL, NULL);
+        json_object_begin(&w);
+        json_add_string(&w, "type", "pulse");
+        hydro_json_add_pulse_event(&w, &event, "pump");
+        json_object_end(&w);
+        live_send_all(server, &w);
+    }
+}
 
-    // Initialize SSD1306 display
-    ssd1306_dev = ssd1306_create(I2C1_PORT, SSD1306_I2C_ADDRESS);
-    ESP_ERROR_CHECK(ssd1306_refresh_gram(ssd1306_dev));
-    ssd1306_clear_screen(ssd1306_dev, 0x00);
-    ESP_LOGI(TAG, "SSD1306 initialized.");
+// Queues flash writes for the I/O task and other work for the network task; never blocks
+// the caller. Returns false if the queue is full.
+bool io_queue_work(const struct IoWork *work) {
+    bool is_flash = work->type == IO_WORK_LOG_RECORD || work->type == IO_WORK_SAVE_SETTINGS;
+    QueueHandle_t queue = is_flash ? g_io_queue : g_net_queue;
+    if (xQueueSendToBack(queue, work, 0) == errQUEUE_FULL) {
+        atomic_fetch_add(&g_io_work_dropped, 1);
+        return false;
+    }
+    return true;
+}
 
-    // Test SSD1306 by displaying a string
-    char data_str[10] = {0};
-    sprintf(data_str, "C STR");
-    ssd1306_draw_string(ssd1306_dev, 70, 16, (const uint8_t *)data_str, 16, 1);
-    ESP_ERROR_CHECK(ssd1306_refresh_gram(ssd1306_dev));
+// Queues a live broadcast; safe to call from any task. Queueing work on the HTTP server
+// sends to its control socket, so it is left to the network task.
+void live_notify() {
+    httpd_handle_t server = atomic_load(&g_http_server);
+    if (server == NULL || atomic_exchange(&g_live_broadcast_queued, true)) {
+        return;
+    }
 
-    // Open flash storage handler
-    nvs_handle_t nvs_handle;
-    ESP_ERROR_CHECK(nvs_open("HydroManager", NVS_READWRITE, &nvs_handle));
+    const struct IoWork work = {.type = IO_WORK_LIVE_BROADCAST};
+    if (!io_queue_work(&work)) {
+        atomic_store(&g_live_broadcast_queued, false);
+    }
+}
 
-    // Try to retrieve pH meter calibration
+//------------------
+// Log Functions
+//------------------
+
+// Queues a record to be added to the flash log; never blocks the caller
+void log_queue_record(const struct LogRecord *record) {
+    if (!g_flash_log_ready) {
+        return;
+    }
+    struct IoWork work = {
+        .type = IO_WORK_LOG_RECORD,
+        .log_record = *record,
+    };
+    if (!io_queue_work(&work)) {
+        ESP_LOGW(TAG, "I/O queue is full; dropped log record");
+    }
+}
+
+void log_record_reading(const struct SensorReading *reading) {
+    struct LogRecord record;
+    flash_log_record_from_reading(&record, reading);
+    log_queue_record(&record);
+}
+
+void log_record_event(const struct PumpPulseEvent *event) {
+    struct LogRecord record;
+    flash_log_record_from_event(&record, event);
+    log_queue_record(&record);
+}
+
+//------------------------
+// Telemetry Functions
+//------------------------
+
+// Pushes a telemetry frame with every new reading to the collector at `TELEMETRY_HOST` over
+// UDP while WiFi is connected. Push frames never carry events, since only HTTP requests
+// acknowledge them; the event cursor in the frame tells the collector when there are new
+// events to request.
+void telemetry_task(void *pvParameters) {
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(TELEMETRY_PORT),
+    };
+    int sock = -1;
+    if (inet_pton(AF_INET, TELEMETRY_HOST, &addr.sin_addr) != 1
+            || (sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0) {
+        ESP_LOGE(TAG, "Cannot push telemetry to %s", TELEMETRY_HOST);
+        g_telemetry_task = NULL;
+        vTaskDelete(NULL);
+        return;
+    }
+
+    TickType_t last_wake = xTaskGetTickCount();
+    uint32_t last_generation = sensor_snapshot_generation(&g_sensor_snapshot);
+    for (;;) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(TELEMETRY_INTERVAL));
+
+        uint32_t generation = sensor_snapshot_generation(&g_sensor_snapshot);
+        struct SensorReading reading;
+        if (generation == last_generation
+                || !(xEventGroupGetBits(g_wifi_event_group) & WIFI_CONNECTED_BIT)
+                || !sensor_snapshot_read(&g_sensor_snapshot, &reading)) {
+            continue;
+        }
+        last_generation = generation;
+
+        uint8_t buffer[TELEMETRY_MAX_FRAME_SIZE];
+        struct TelemetryFrame frame;
+        telemetry_frame_begin(&frame, buffer, time(NULL), &reading,
+                event_ring_dropped(&g_pump_events), g_boot_id);
+        size_t len = telemetry_frame_end(&frame, event_ring_next_seq(&g_pump_events) - 1, 0);
+        if (sendto(sock, buffer, len, 0, (const struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            ESP_LOGD(TAG, "Failed to push telemetry: errno %d", errno);
+        }
+    }
+}
+
+//------------------
+// Display Functions
+//------------------
+
+// Sends SSD1306 commands
+esp_err_t display_send_commands(const uint8_t *commands, size_t length) {
+    uint8_t buffer[8] = {0x00};     // Control byte: commands follow
+    memcpy(&buffer[1], commands, length);
+    return i2c_master_write_to_device(I2C1_PORT, SSD1306_I2C_ADDRESS, buffer, length + 1,
+            DISPLAY_I2C_TIMEOUT);
+}
+
+// Sends columns `first` to `last` of a page of the frame to the display GRAM
+esp_err_t display_send_span(uint8_t page, uint8_t first, uint8_t last) {
+    // Limit the GRAM window to the span so the data wraps nowhere
+    const uint8_t window[] = {0x21, first, last, 0x22, page, page};
+    esp_err_t err = display_send_commands(window, sizeof(window));
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    uint8_t buffer[DISPLAY_WIDTH + 1] = {0x40};     // Control byte: data follows
+    size_t length = last - first + 1;
+    memcpy(&buffer[1], &g_display_frame.pixels[page][first], length);
+    return i2c_master_write_to_device(I2C1_PORT, SSD1306_I2C_ADDRESS, buffer, length + 1,
+            DISPLAY_I2C_TIMEOUT);
+}
+
+// Draws the status screen from the latest reading
+void display_render(const struct SensorReading *reading) {
+    struct DisplayFrame *frame = &g_display_frame;
+    display_frame_clear(frame);
+
+    char line[24];
+    snprintf(line, sizeof(line), "pH %d.%02d", (int)(reading->ph_centi / 100),
+            (int)(reading->ph_centi % 100));
+    display_frame_draw_text(frame, 0, 0, line, 2);
+
+    snprintf(line, sizeof(line), "Temp %4d.%01d C", (int)(reading->temp_centi / 100),
+            (int)(abs(reading->temp_centi) % 100 / 10));
+    display_frame_draw_text(frame, 3, 0, line, 1);
+    snprintf(line, sizeof(line), "RH   %4d.%01d %%", (int)(reading->humidity_centi / 100),
+            (int)(reading->humidity_centi % 100 / 10));
+    display_frame_draw_text(frame, 4, 0, line, 1);
+    snprintf(line, sizeof(line), "TDS  %6" PRIu32 " ppm", reading->tds);
+    display_frame_draw_text(frame, 5, 0, line, 1);
+
+    struct SystemSettings settings;
+    settings_store_read(&g_settings, &settings);
+    struct tm timeinfo;
+    localtime_r(&reading->timestamp, &timeinfo);
+    strftime(line, sizeof(line), "%H:%M:%S", &timeinfo);
+    display_frame_draw_text(frame, 7, 0, line, 1);
+    display_frame_draw_text(frame, 7, 9 * DISPLAY_CHAR_WIDTH,
+            g_overflow_fault ? "OVERFLOW" : settings.auto_ph == AUTO_PH_ON ? "AUTO PH" : "",
+            1);
+}
+
+// Sends the columns of the frame that changed to the display and returns the number of
+// columns sent
+size_t display_flush() {
+    size_t sent = 0;
+    for (uint8_t page = 0; page < DISPLAY_PAGES; ++page) {
+        uint8_t first, last;
+        if (!display_frame_dirty_span(&g_display_frame, page, &first, &last)) {
+            continue;
+        }
+        // Columns that failed to send stay dirty and are sent with the next frame
+        if (display_send_span(page, first, last) == ESP_OK) {
+            display_frame_mark_sent(&g_display_frame, page, first, last);
+            sent += last - first + 1;
+        }
+    }
+    return sent;
+}
+
+// Refreshes the status display on core 1. Every frame is drawn from the sensor snapshot,
+// which never blocks the sampler, and only the columns that changed are sent over I2C.
+void display_task(void *pvParameters) {
+    // Address the GRAM horizontally so each span is sent as one write
+    const uint8_t horizontal_addressing[] = {0x20, 0x00};
+    ESP_ERROR_CHECK_WITHOUT_ABORT(display_send_commands(horizontal_addressing,
+                sizeof(horizontal_addressing)));
+
+    // The GRAM holds noise at power-on, so clear it before the first reading
+    display_frame_init(&g_display_frame);
+    display_flush();
+
+    TickType_t last_wake = xTaskGetTickCount();
+    for (;;) {
+        struct SensorReading reading;
+        if (sensor_snapshot_read(&g_sensor_snapshot, &reading)) {
+            int64_t start_us = esp_timer_get_time();
+            display_render(&reading);
+            size_t sent = display_flush();
+            ESP_LOGD(TAG, "Display refresh sent %u bytes in %" PRId64 " us", (unsigned)sent,
+                    esp_timer_get_time() - start_us);
+        }
+
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(DISPLAY_REFRESH_INTERVAL));
+    }
+}
+
+//------------------
+// Pump Functions
+//------------------
+
+// Schedules control job `job` to run at `deadline_us`; must be called by the system control
+// task
+void control_schedule(enum ControlJob job, int64_t deadline_us) {
+    scheduler_schedule(&g_control_scheduler, job, CONTROL_JOB_PRIORITY[job], deadline_us);
+}
+
+// Wakes the system control task to handle `events`
+void system_control_notify(uint32_t events) {
+    if (g_system_control_task != NULL) {
+        xTaskNotify(g_system_control_task, events, eSetBits);
+    }
+}
+
+// Overflow sensor interrupt; turns off all pumps within microseconds of the sensor being
+// set, no matter what any task is doing. Runs from IRAM so it is not delayed by flash writes.
+void IRAM_ATTR overflow_isr_handler(void *arg) {
+    gpio_set_level(PUMP0, PUMP_OFF);
+    gpio_set_level(PUMP1, PUMP_OFF);
+    gpio_set_level(PUMP2, PUMP_OFF);
+    g_overflow_fault = true;
+
+    // Wake the system control task so it records an interrupted pulse right away
+    if (g_system_control_task != NULL) {
+        BaseType_t higher_priority_task_woken = pdFALSE;
+        xTaskNotifyFromISR(g_system_control_task, CONTROL_EVENT_OVERFLOW, eSetBits,
+                &higher_priority_task_woken);
+        portYIELD_FROM_ISR(higher_priority_task_woken);
+    }
+}
+
+// Clears the overflow fault once the overflow sensor is no longer set
+void overflow_fault_update() {
+    if (!g_overflow_fault) {
+        return;
+    }
+
+    // Clear before reading the sensor so an interrupt in between is not lost
+    g_overflow_fault = false;
+    if (gpio_get_level(OVERFLOW_SENSOR) == 1) {
+        g_overflow_fault = true;
+        return;
+    }
+
+    ESP_LOGI(TAG, "Overflow sensor cleared");
+}
+
+// Turns a pump on or off; a pump cannot be turned on while the overflow fault is set
+esp_err_t pump_set(int pump, bool on) {
+    if (on && g_overflow_fault) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return gpio_set_level(pump, on ? PUMP_ON : PUMP_OFF);
+}
+
+// Returns the GPIO of the pump with id `pump_id`, or -1 if there is no such pump
+int pump_gpio(uint8_t pump_id) {
+    switch (pump_id) {
+        case PUMP_ID_PH_DOWN:
+            return PUMP_PH_DOWN;
+        case PUMP_ID_PH_UP:
+            return PUMP_PH_UP;
+        case PUMP_ID_REFILL:
+            return PUMP_REFILL;
+        default:
+            return -1;
+    }
+}
+
+// Starts pulsing a pump for `length` milliseconds. The pulse is stopped by
+// `pump_pulse_update()`, which runs as a control job when the pulse is due to end.
+esp_err_t pump_pulse_start(uint8_t pump_id, uint32_t length, bool automatic) {
+    int pump = pump_gpio(pump_id);
+    if (pump < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Ensure another pulse is not already in progress
+    if (g_pump_pulse.active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = pump_set(pump, true);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    pump_pulse_begin(&g_pump_pulse, pump_id, length, automatic, esp_timer_get_time());
+    control_schedule(JOB_PUMP_PULSE_END, pump_pulse_end_us(&g_pump_pulse));
+
+    ESP_LOGI(TAG, "Started pulse of pump %u for %" PRIu32 " ms", pump_id, length);
+
+    return ESP_OK;
+}
+
+// Stops the finished pulse of `event` and records the event, which gets its seq
+void pump_pulse_finish(struct PumpPulseEvent *event) {
+    pump_set(pump_gpio(event->pump_id), false);
+    scheduler_cancel(&g_control_scheduler, JOB_PUMP_PULSE_END);
+
+    if (!event_ring_push(&g_pump_events, event)) {
+        ESP_LOGE(TAG, "Pump event ring is full; dropped event");
+    }
+    log_record_event(event);
+    live_notify();
+
+    struct SensorReading reading;
+    if (sensor_snapshot_read(&g_sensor_snapshot, &reading)) {
+        ph_control_record_pulse(&g_ph_dosing, event, reading.ph_centi, esp_timer_get_time());
+    }
+
+    ESP_LOGI(TAG, "Finished pulse of pump %u after %" PRIu32 " ms%s", event->pump_id,
+            event->pulse_length, event->was_interrupted ? " (interrupted)" : "");
+}
+
+// Stops the pulse in progress once it has run for its full length, or early if the
+// overflow fault is set
+void pump_pulse_update() {
+    struct PumpPulseEvent event;
+    if (pump_pulse_poll(&g_pump_pulse, g_overflow_fault, esp_timer_get_time(), time(NULL),
+                &event)) {
+        pump_pulse_finish(&event);
+    }
+}
+
+void initialize_pumps() {
+    // Turn off pumps before enabling the outputs so the relays never glitch on
+    const int pumps[] = {PUMP0, PUMP1, PUMP2};
+    for (size_t i = 0; i < sizeof(pumps) / sizeof(pumps[0]); ++i) {
+        ESP_ERROR_CHECK(gpio_set_level(pumps[i], PUMP_OFF));
+    }
+    gpio_config_t pump_conf = {
+        .pin_bit_mask = (1ULL << PUMP0) | (1ULL << PUMP1) | (1ULL << PUMP2),
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&pump_conf));
+
+    // The overflow sensor is high impedance when out of water, so pull it down
+    gpio_config_t overflow_conf = {
+        .pin_bit_mask = 1ULL << OVERFLOW_SENSOR,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_ENABLE,
+        .intr_type = GPIO_INTR_POSEDGE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&overflow_conf));
+    ESP_ERROR_CHECK(gpio_install_isr_service(ESP_INTR_FLAG_IRAM));
+    ESP_ERROR_CHECK(gpio_isr_handler_add(OVERFLOW_SENSOR, overflow_isr_handler, NULL));
+
+    // The interrupt does not fire if the sensor is already set, so latch the fault here too
+    if (gpio_get_level(OVERFLOW_SENSOR) == 1) {
+        overflow_isr_handler(NULL);
+        ESP_LOGE(TAG, "Overflow sensor is set during startup");
+    }
+
+    ESP_LOGI(TAG, "Pumps initialized.");
+}
+
+//---------------------------
+// System Request Functions
+//---------------------------
+
+// Reply queue of the calling task
+QueueHandle_t system_reply_queue() {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    QueueHandle_t reply_queue = NULL;
+
+    xSemaphoreTake(g_system_requesters_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < MAX_SYSTEM_REQUESTERS; ++i) {
+        struct SystemRequester *requester = &g_system_requesters[i];
+        if (requester->task == task) {
+            reply_queue = requester->reply_queue;
+            break;
+        }
+        if (requester->task == NULL) {
+            requester->reply_queue = xQueueCreate(SYSTEM_REPLY_QUEUE_SIZE,
+                    sizeof(struct SystemResponse));
+            if (requester->reply_queue != NULL) {
+                requester->task = task;
+            }
+            reply_queue = requester->reply_queue;
+            break;
+        }
+    }
+    xSemaphoreGive(g_system_requesters_mutex);
+
+    if (reply_queue == NULL) {
+        ESP_LOGE(TAG, "No reply queue for task; too many requesting tasks");
+    }
+    return reply_queue;
+}
+
+// Sends a command to the system control task on core 0 and waits for its response.
+// Responses of earlier commands that timed out are discarded.
+esp_err_t system_request(struct SystemCommand *cmd, struct SystemResponse *response,
+        TickType_t timeout) {
+    cmd->reply_queue = system_reply_queue();
+    if (cmd->reply_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    cmd->request_id = atomic_fetch_add(&g_system_next_request_id, 1);
+
+    TickType_t start = xTaskGetTickCount();
+    if (xQueueSendToBack(g_system_command_queue, cmd, timeout) == errQUEUE_FULL) {
+        ESP_LOGE(TAG, "System command queue is full");
+        return ESP_ERR_TIMEOUT;
+    }
+    system_control_notify(CONTROL_EVENT_COMMAND);
+
+    // The wait is counted even when it times out
+    uint32_t start_cycles = esp_cpu_get_cycle_count();
+    esp_err_t err = ESP_OK;
+    for (;;) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout
+                || xQueueReceive(cmd->reply_queue, response, timeout - elapsed) == pdFALSE) {
+            ESP_LOGE(TAG, "Timeout while waiting for system response");
+            err = ESP_ERR_TIMEOUT;
+            break;
+        }
+        if (response->request_id == cmd->request_id) {
+            break;
+        }
+        ESP_LOGW(TAG, "Discarding stale system response");
+    }
+    stage_counter_add(&g_stage_counters[STAGE_QUEUE_WAIT],
+            esp_cpu_get_cycle_count() - start_cycles);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (response->cmd_type != cmd->cmd_type) {
+        ESP_LOGE(TAG, "System response is an unexepcted type");
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
+// Sends the response of a command to the task that requested it
+void system_reply(const struct SystemCommand *cmd, struct SystemResponse *response) {
+    response->request_id = cmd->request_id;
+    if (xQueueSendToBack(cmd->reply_queue, response, 0) == errQUEUE_FULL) {
+        ESP_LOGE(TAG, "Failed to send system response; queue full");
+    }
+}
+
+//------------------------
+// HTTP Server Functions
+//------------------------
+
+// Handler of every endpoint; runs the endpoint's handler and records its latency
+esp_err_t http_timed_handler(httpd_req_t *req) {
+    struct HttpEndpoint *endpoint = req->user_ctx;
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = endpoint->handler(req);
+    latency_histogram_record(&endpoint->latency, (uint32_t)(esp_timer_get_time() - start_us));
+    return err;
+}
+
+// Sends a chunk of a response; the cycles spent sending are counted as the httpd send stage
+int http_json_flush(void *ctx, const char *data, size_t len) {
+    uint32_t start_cycles = esp_cpu_get_cycle_count();
+    esp_err_t err = httpd_resp_send_chunk((httpd_req_t *)ctx, data, len);
+    uint32_t cycles = esp_cpu_get_cycle_count() - start_cycles;
+    stage_counter_add(&g_stage_counters[STAGE_HTTPD_SEND], cycles);
+    g_http_json_send_cycles += cycles;
+    return err == ESP_OK ? 0 : -1;
+}
+
+// Starts a JSON response that is serialized into `g_http_json_buffer`
+void http_json_begin(httpd_req_t *req, struct JsonWriter *w) {
+    httpd_resp_set_type(req, "application/json");
+    json_writer_init(w, g_http_json_buffer, sizeof(g_http_json_buffer), http_json_flush, req);
+    g_http_json_start_cycles = esp_cpu_get_cycle_count();
+    g_http_json_send_cycles = 0;
+}
+
+// Sends the rest of a JSON response. Responses that fit in the buffer are sent in one
+// piece; longer ones were already partially sent in chunks.
+//
+// Everything since http_json_begin that was not spent sending chunks is counted as the JSON
+// build stage, so it includes the reads that the handler did while serializing.
+esp_err_t http_json_end(httpd_req_t *req, struct JsonWriter *w) {
+    stage_counter_add(&g_stage_counters[STAGE_JSON_BUILD],
+            esp_cpu_get_cycle_count() - g_http_json_start_cycles - g_http_json_send_cycles);
+    if (w->error) {
+        ESP_LOGE(TAG, "Failed to send JSON response");
+        return ESP_FAIL;
+    }
+
+    if (w->flushed == 0) {
+        uint32_t start_cycles = esp_cpu_get_cycle_count();
+        esp_err_t err = httpd_resp_send(req, w->buf, w->len);
+        stage_counter_add(&g_stage_counters[STAGE_HTTPD_SEND],
+                esp_cpu_get_cycle_count() - start_cycles);
+        return err;
+    }
+
+    if (!json_writer_flush(w) || http_json_flush(req, NULL, 0) != 0) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+// Reads a form-encoded request body into `buf` as a null-terminated string
+esp_err_t http_read_form(httpd_req_t *req, char *buf, size_t buf_len) {
+    if (req->content_len >= buf_len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    size_t received = 0;
+    while (received < req->content_len) {
+        int ret = httpd_req_recv(req, buf + received, req->content_len - received);
+        if (ret <= 0) {
+            return ESP_FAIL;
+        }
+        received += ret;
+    }
+    buf[received] = '\0';
+
+    return ESP_OK;
+}
+
+// Reads an unsigned integer value from a form-encoded string
+esp_err_t http_form_get_u32(const char *form, const char *key, uint32_t *value) {
+    char value_str[16];
+    esp_err_t err = httpd_query_key_value(form, key, value_str, sizeof(value_str));
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    char *end;
+    unsigned long parsed = strtoul(value_str, &end, 10);
+    if (end == value_str || *end != '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *value = parsed;
+
+    return ESP_OK;
+}
+
+// Reads an unsigned integer value from the URL query string of a request
+esp_err_t http_query_get_u32(httpd_req_t *req, const char *key, uint32_t *value) {
+    char query[64];
+    esp_err_t err = httpd_req_get_url_query_str(req, query, sizeof(query));
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    return http_form_get_u32(query, key, value);
+}
+
+esp_err_t handle_http_api_readings(httpd_req_t *req) {
+    ESP_LOGD(TAG, "/api/readings.json");
+
+    // Read the latest reading from the sampler, which never waits on the sensors, unless a
+    // fresh reading is requested with `fresh=1`
+    struct SensorReading reading;
+    uint32_t fresh = 0;
+    http_query_get_u32(req, "fresh", &fresh);
+    if (fresh) {
+        struct SystemCommand cmd = {
+            .cmd_type = CMD_READING_REQUEST,
+        };
+        struct SystemResponse response;
+        esp_err_t err = system_request(&cmd, &response, pdMS_TO_TICKS(15000));
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (response.result != ESP_OK) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to read sensors");
+            return ESP_FAIL;
+        }
+        reading = response.reading;
+    } else if (!sensor_snapshot_read(&g_sensor_snapshot, &reading)) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No sensor reading yet");
+        return ESP_FAIL;
+    }
+
+    // Serialize JSON response
+    struct JsonWriter w;
+    http_json_begin(req, &w);
+    json_object_begin(&w);
+    hydro_json_add_reading(&w, &reading);
+    json_object_end(&w);
+    return http_json_end(req, &w);
+}
+
+esp_err_t handle_http_api_pulse(httpd_req_t *req) {
+    ESP_LOGD(TAG, "/api/pulse");
+
+    // Parse ph pump and pulse length
+    char form[64];
+    uint32_t pump_id, pulse_len;
+    if (http_read_form(req, form, sizeof(form)) != ESP_OK
+            || http_form_get_u32(form, "pump", &pump_id) != ESP_OK
+            || http_form_get_u32(form, "pulseLen", &pulse_len) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "POST needs args pulseLen and pump");
+        return ESP_FAIL;
+    }
+    if (!(pump_id == PUMP_ID_PH_DOWN || pump_id == PUMP_ID_PH_UP)
+            || pulse_len < PH_DOSE_MIN || pulse_len > PH_DOSE_MAX) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "pump or pulseLen out of range");
+        return ESP_FAIL;
+    }
+    struct SystemSettings settings;
+    settings_store_read(&g_settings, &settings);
+    if (settings.auto_ph == AUTO_PH_ON) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "cannot pulse in auto ph mode");
+        return ESP_FAIL;
+    }
+
+    // 15 second timeout
+    const TickType_t timeout = pdMS_TO_TICKS(15000);
+
+    // Send system command to core 0 and wait for it to start the pulse; the pulse is
+    // started without waiting for it to finish
+    struct SystemCommand cmd = {
+        .cmd_type = CMD_PUMP_PULSE,
+        .pulse_request = {
+            .pump_id = pump_id,
+            .length = pulse_len,
+        },
+    };
+    struct SystemResponse response;
+    esp_err_t err = system_request(&cmd, &response, timeout);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (response.result != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+                "cannot pulse while another pulse is running or the overflow sensor is set");
+        return ESP_FAIL;
+    }
+
+    // Serialize JSON response
+    struct JsonWriter w;
+    http_json_begin(req, &w);
+    json_object_begin(&w);
+    json_add_int(&w, "time", time(NULL));
+    json_add_uint(&w, "pump", pump_id);
+    json_add_uint(&w, "pulseLen", pulse_len);
+    json_object_end(&w);
+    return http_json_end(req, &w);
+}
+
+// Captures the current pH probe voltage as a calibration point from the `point` form value
+// (4, 7 or 10) and saves the calibration to flash
+esp_err_t handle_http_api_ph_calibration(httpd_req_t *req) {
+    ESP_LOGD(TAG, "/api/ph_calibration");
+
+    // Parse calibration point
+    char form[32];
+    uint32_t point;
+    if (http_read_form(req, form, sizeof(form)) != ESP_OK
+            || http_form_get_u32(form, "point", &point) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "POST needs arg point");
+        return ESP_FAIL;
+    }
+    if (point != 4 && point != 7 && point != 10) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "point must be 4, 7 or 10");
+        return ESP_FAIL;
+    }
+
+    // 15 second timeout
+    const TickType_t timeout = pdMS_TO_TICKS(15000);
+
+    // Send system command to core 0 and wait for it to capture the calibration point
+    struct SystemCommand cmd = {
+        .cmd_type = CMD_PH_CALIBRATE,
+        .ph_calibration_request = {
+            .point = point,
+        },
+    };
+    struct SystemResponse response;
+    esp_err_t err = system_request(&cmd, &response, timeout);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (response.result == ESP_ERR_INVALID_ARG) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                "probe voltage must fall from pH 4 to 7 to 10; capture the other points again");
+        return ESP_FAIL;
+    } else if (response.result != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR,
+                "cannot read the pH probe or save the calibration");
+        return ESP_FAIL;
+    }
+
+    // Serialize JSON response
+    struct PhCalibrationResult *result = &response.ph_calibration;
+    struct JsonWriter w;
+    http_json_begin(req, &w);
+    json_object_begin(&w);
+    json_add_int(&w, "time", time(NULL));
+    json_add_uint(&w, "point", result->point);
+    json_add_int(&w, "mv", result->mv);
+    json_add_int(&w, "ph_4", (int32_t)result->calibration.ph_4);
+    json_add_int(&w, "ph_7", (int32_t)result->calibration.ph_7);
+    json_add_int(&w, "ph_10", (int32_t)result->calibration.ph_10);
+    json_object_end(&w);
+    return http_json_end(req, &w);
+}
+
+// Sends the current system settings
+esp_err_t http_send_settings(httpd_req_t *req, const struct SystemSettings *settings,
+        uint32_t generation) {
+    struct JsonWriter w;
+    http_json_begin(req, &w);
+    json_object_begin(&w);
+    json_add_int(&w, "time", time(NULL));
+    json_add_uint(&w, "generation", generation);
+#define HTTP_SETTING_JSON(member, key, type, min, max) \
+    json_add_##type(&w, key, settings->member);
+    SYSTEM_SETTINGS_FIELDS(HTTP_SETTING_JSON)
+#undef HTTP_SETTING_JSON
+    json_object_end(&w);
+    return http_json_end(req, &w);
+}
+
+esp_err_t handle_http_api_settings_get(httpd_req_t *req) {
+    ESP_LOGD(TAG, "GET /api/settings");
+
+    struct SystemSettings settings;
+    uint32_t generation = settings_store_read(&g_settings, &settings);
+    return http_send_settings(req, &settings, generation);
+}
+
+// A setting from a form; any non-zero value of a bool turns it on
+#define HTTP_SETTING_FROM_FORM_bool(value) ((value) != 0)
+#define HTTP_SETTING_FROM_FORM_uint(value) (value)
+
+// Updates any of the settings in the form; settings that are not in the form are kept
+esp_err_t handle_http_api_settings_post(httpd_req_t *req) {
+    ESP_LOGD(TAG, "POST /api/settings");
+
+    char form[160];
+    if (http_read_form(req, form, sizeof(form)) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "POST needs a form of settings");
+        return ESP_FAIL;
+    }
+
+    struct SystemCommand cmd = {
+        .cmd_type = CMD_SETTINGS_UPDATE,
+    };
+    struct SystemSettings *settings = &cmd.updated_settings;
+    settings_store_read(&g_settings, settings);
+
+    // Values are range checked before they are stored, so they are never truncated to a
+    // narrower member
+    uint32_t value;
+    bool in_range = true;
+#define HTTP_SETTING_FROM_FORM(member, key, type, min, max) \
+    if (http_form_get_u32(form, key, &value) == ESP_OK) { \
+        value = HTTP_SETTING_FROM_FORM_##type(value); \
+        in_range = in_range && system_setting_in_range(value, min, max); \
+        settings->member = value; \
+    }
+    SYSTEM_SETTINGS_FIELDS(HTTP_SETTING_FROM_FORM)
+#undef HTTP_SETTING_FROM_FORM
+    if (!in_range || !system_settings_is_valid(settings)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "settings out of range");
+        return ESP_FAIL;
+    }
+
+    // Send system command to core 0 and wait for it to publish the settings
+    struct SystemResponse response;
+    esp_err_t err = system_request(&cmd, &response, pdMS_TO_TICKS(15000));
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (response.result != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "settings out of range");
+        return ESP_FAIL;
+    }
+
+    return http_send_settings(req, &cmd.updated_settings, response.settings_generation);
+}
+
+// Sends the history records of a log page that are within [from, to]. Records are encoded
+// into the shared JSON buffer, which is sent as a chunk whenever it fills up. Timestamps of
+// pages from this boot (`this_boot`) are moved to the wall clock first; there is no time
+// of boot to move the unsynced timestamps of older pages with.
+esp_err_t http_history_send_page(httpd_req_t *req, const struct FlashLogPage *page,
+        bool this_boot, uint32_t from, uint32_t to, struct HistoryEncoder *encoder,
+        size_t *len) {
+    uint8_t *buf = (uint8_t *)g_http_json_buffer;
+    struct FlashLogReader reader;
+    struct LogRecord record;
+    flash_log_reader_init(&reader, page);
+    while (flash_log_reader_next(&reader, &record)) {
+        if (this_boot) {
+            record.timestamp = time_from_boot(record.timestamp);
+        }
+        if (record.timestamp < from || record.timestamp > to) {
+            continue;
+        }
+
+        if (*len + HISTORY_RECORD_MAX_SIZE > sizeof(g_http_json_buffer)) {
+            esp_err_t err = httpd_resp_send_chunk(req, (const char *)buf, *len);
+            if (err != ESP_OK) {
+                return err;
+            }
+            *len = 0;
+        }
+        *len += history_encode_record(encoder, &record, buf + *len);
+    }
+
+    return ESP_OK;
+}
+
+// Streams logged records in the binary history format (see history.h), straight from the
+// flash log pages
+esp_err_t handle_http_api_history(httpd_req_t *req) {
+    ESP_LOGD(TAG, "/api/history");
+
+    if (!g_flash_log_ready) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "flash log is not available");
+        return ESP_FAIL;
+    }
+
+    // Parse time range and fields; every argument is optional
+    char query[128] = "";
+    char fields_arg[48];
+    uint32_t from = 0, to = UINT32_MAX;
+    uint8_t fields = HISTORY_FIELD_ALL;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        esp_err_t from_err = http_form_get_u32(query, "from", &from);
+        esp_err_t to_err = http_form_get_u32(query, "to", &to);
+        if ((from_err != ESP_OK && from_err != ESP_ERR_NOT_FOUND)
+                || (to_err != ESP_OK && to_err != ESP_ERR_NOT_FOUND)) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "from and to must be unix times");
+            return ESP_FAIL;
+        }
+        if (httpd_query_key_value(query, "fields", fields_arg, sizeof(fields_arg)) == ESP_OK) {
+            fields = history_parse_fields(fields_arg);
+            if (fields == 0) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                        "fields must be a list of ph, temp, humidity, tds and pulses");
+                return ESP_FAIL;
+            }
+        }
+    }
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    struct HistoryEncoder encoder;
+    size_t len = history_encoder_init(&encoder, fields, (uint8_t *)g_http_json_buffer);
+
+    // Send pages from oldest to newest. Pages entirely outside of the time range are skipped;
+    // they are not assumed to be in time order since the clock is unset until SNTP syncs.
+    uint32_t next_seq = flash_log_next_seq(&g_flash_log);
+    for (uint32_t seq = flash_log_first_seq(&g_flash_log); seq < next_seq; ++seq) {
+        esp_err_t err = flash_log_read_page(&g_flash_log, seq, &g_http_history_page);
+        if (err != ESP_OK) {
+            continue;
+        }
+
+        err = http_history_send_page(req, &g_http_history_page, seq >= g_boot_log_seq, from,
+                to, &encoder, &len);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    // Records that are not written to flash yet
+    flash_log_read_pending(&g_flash_log, &g_http_history_page);
+    esp_err_t err = http_history_send_page(req, &g_http_history_page, true, from, to,
+            &encoder, &len);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (len > 0) {
+        err = httpd_resp_send_chunk(req, g_http_json_buffer, len);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// Releases the events acknowledged by the `since` query argument and returns the seq of the
+// first event to send. `reset` is set if `since` is not the seq of a known event, or if the
+// `boot` query argument is not the ID of this boot, since then `since` is a seq of another
+// boot.
+uint32_t http_events_release(httpd_req_t *req, bool *reset) {
+    uint32_t first_seq = event_ring_first_seq(&g_pump_events);
+    uint32_t next_seq = event_ring_next_seq(&g_pump_events);
+
+    uint32_t since, boot;
+    bool other_boot = http_query_get_u32(req, "boot", &boot) == ESP_OK && boot != g_boot_id;
+    *reset = false;
+    if (http_query_get_u32(req, "since", &since) == ESP_OK) {
+        if (!other_boot && since + 1 - first_seq <= next_seq - first_seq) {
+            event_ring_release(&g_pump_events, since + 1);
+            return since + 1;
+        }
+        *reset = true;
+    }
+    return first_seq;
+}
+
+// Sends the client pending pump pulse events.
+//
+// The optional `since` query argument is a cursor; the client acknowledges every event up
+// to and including `since`, which releases them from the ring, and only newer events are
+// sent. The response's `seq` is the cursor to send next time, together with its `boot`
+// as the `boot` query argument. Without `since`, pending events are sent but never
+// released. A `since` that does not match any event, or that is from another boot, is
+// ignored and `reset` is set in the response.
+esp_err_t handle_http_api_events(httpd_req_t *req) {
+    ESP_LOGD(TAG, "/api/events.json");
+
+    bool reset;
+    uint32_t seq = http_events_release(req, &reset);
+
+    // Serialize JSON response; at most `EVENTS_PAGE_SIZE` events are sent and the rest are
+    // sent in the next response
+    struct JsonWriter w;
+    http_json_begin(req, &w);
+    json_object_begin(&w);
+    json_add_int(&w, "time", time(NULL));
+    json_add_uint(&w, "dropped", event_ring_dropped(&g_pump_events));
+    json_add_uint(&w, "boot", g_boot_id);
+    json_add_bool(&w, "reset", reset);
+    json_key(&w, "pulse_events");
+    json_array_begin(&w);
+    for (size_t i = 0; i < EVENTS_PAGE_SIZE; ++i, ++seq) {
+        struct PumpPulseEvent event;
+        if (!pump_event_get(seq, &event)) {
+            break;
+        }
+        json_object_begin(&w);
+        // The pump ID is sent as "type", like the pump type of the Version 0.x HydroManager
+        hydro_json_add_pulse_event(&w, &event, "type");
+        json_object_end(&w);
+    }
+    json_array_end(&w);
+    json_add_uint(&w, "seq", seq - 1);
+    json_add_bool(&w, "more", seq != event_ring_next_seq(&g_pump_events));
+    json_object_end(&w);
+    return http_json_end(req, &w);
+}
+
+// Sends the latest reading and the events after `since` in a binary telemetry frame (see
+// main/telemetry.h). Events are acknowledged like '/api/events.json'.
+esp_err_t handle_http_api_telemetry(httpd_req_t *req) {
+    ESP_LOGD(TAG, "/api/telemetry");
+
+    bool reset;
+    uint32_t seq = http_events_release(req, &reset);
+
+    struct SensorReading reading;
+    bool has_reading = sensor_snapshot_read(&g_sensor_snapshot, &reading);
+    uint8_t buffer[TELEMETRY_MAX_FRAME_SIZE];
+    struct TelemetryFrame frame;
+    telemetry_frame_begin(&frame, buffer, time(NULL), has_reading ? &reading : NULL,
+            event_ring_dropped(&g_pump_events), g_boot_id);
+    for (size_t i = 0; i < EVENTS_PAGE_SIZE; ++i, ++seq) {
+        struct PumpPulseEvent event;
+        if (!pump_event_get(seq, &event)) {
+            break;
+        }
+        telemetry_frame_add_event(&frame, &event);
+    }
+    uint8_t flags = (reset ? TELEMETRY_FLAG_RESET : 0)
+        | (seq != event_ring_next_seq(&g_pump_events) ? TELEMETRY_FLAG_MORE : 0);
+    size_t len = telemetry_frame_end(&frame, seq - 1, flags);
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    return httpd_resp_send(req, (const char *)buffer, len);
+}
+
+// Accepts WebSocket clients of the live channel; messages from clients are ignored
+esp_err_t handle_http_api_live(httpd_req_t *req) {
+    if (req->method == HTTP_GET) {
+        // The new client is already counted; refusing it keeps sockets free for requests
+        int fds[HTTP_MAX_SOCKETS];
+        if (live_get_clients(req->handle, fds) > LIVE_MAX_CLIENTS) {
+            ESP_LOGW(TAG, "/api/live client refused; too many clients");
+            return ESP_FAIL;
+        }
+        ESP_LOGI(TAG, "/api/live client connected");
+
+        // Send the latest reading to the new client only; the others already have it
+        struct SensorReading reading;
+        if (sensor_snapshot_read(&g_sensor_snapshot, &reading)) {
+            struct JsonWriter w;
+            live_write_reading(&w, &reading);
+            live_send(req->handle, httpd_req_to_sockfd(req), &w);
+        }
+        return ESP_OK;
+    }
+
+    uint8_t payload[LIVE_MAX_MESSAGE_SIZE];
+    httpd_ws_frame_t frame = {
+        .payload = payload,
+    };
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (frame.len > sizeof(payload)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return httpd_ws_recv_frame(req, &frame, frame.len);
+}
+
+// Sends performance counters, request latencies, task stacks and heap usage in the
+// Prometheus text format
+esp_err_t handle_http_api_metrics(httpd_req_t *req) {
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    struct MetricsWriter w;
+    metrics_writer_init(&w, g_http_json_buffer, sizeof(g_http_json_buffer), http_json_flush,
+            req);
+
+    metrics_header(&w, "hydro_uptime_seconds", "gauge", "Seconds since boot");
+    metrics_printf(&w, "hydro_uptime_seconds %" PRId64 "\n", esp_timer_get_time() / 1000000);
+    metrics_header(&w, "hydro_readings_total", "counter", "Sensor readings published");
+    metrics_printf(&w, "hydro_readings_total %" PRIu32 "\n",
+            sensor_snapshot_generation(&g_sensor_snapshot));
+    metrics_header(&w, "hydro_pump_events_dropped_total", "counter",
+            "Pump pulse events dropped because the event ring was full");
+    metrics_printf(&w, "hydro_pump_events_dropped_total %" PRIu32 "\n",
+            event_ring_dropped(&g_pump_events));
+
+    metrics_header(&w, "hydro_io_work_dropped_total", "counter",
+            "Work items dropped because the I/O or network queue was full");
+    metrics_printf(&w, "hydro_io_work_dropped_total %" PRIu32 "\n",
+            atomic_load(&g_io_work_dropped));
+    metrics_header(&w, "hydro_wifi_connections_total", "counter",
+            "Times the station connected to the AP");
+    metrics_printf(&w, "hydro_wifi_connections_total %" PRIu32 "\n",
+            atomic_load(&g_wifi_connections));
+    metrics_header(&w, "hydro_time_synced", "gauge",
+            "1 once the system time has been synced from the SNTP server");
+    metrics_printf(&w, "hydro_time_synced %d\n", atomic_load(&g_time_synced) ? 1 : 0);
+
+    metrics_header(&w, "hydro_cpu_frequency_hz", "gauge", "CPU cycles per second");
+    metrics_printf(&w, "hydro_cpu_frequency_hz %d\n", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000000);
+    metrics_header(&w, "hydro_stage_calls_total", "counter", "Times each stage ran");
+    for (int i = 0; i < STAGE_COUNT; ++i) {
+        metrics_printf(&w, "hydro_stage_calls_total{stage=\"%s\"} %" PRIu32 "\n",
+                METRICS_STAGE_NAMES[i], atomic_load(&g_stage_counters[i].calls));
+    }
+    metrics_header(&w, "hydro_stage_cycles_total", "counter", "CPU cycles spent in each stage");
+    for (int i = 0; i < STAGE_COUNT; ++i) {
+        metrics_printf(&w, "hydro_stage_cycles_total{stage=\"%s\"} %" PRIu64 "\n",
+                METRICS_STAGE_NAMES[i], atomic_load(&g_stage_counters[i].cycles));
+    }
+    metrics_header(&w, "hydro_stage_max_cycles", "gauge",
+            "Most CPU cycles of a single run of each stage");
+    for (int i = 0; i < STAGE_COUNT; ++i) {
+        metrics_printf(&w, "hydro_stage_max_cycles{stage=\"%s\"} %" PRIu32 "\n",
+                METRICS_STAGE_NAMES[i], atomic_load(&g_stage_counters[i].max_cycles));
+    }
+
+    metrics_header(&w, "hydro_http_request_duration_seconds", "histogram",
+            "Time spent handling requests of each endpoint");
+    for (size_t i = 0; i < g_http_endpoint_count; ++i) {
+        char labels[64];
+        snprintf(labels, sizeof(labels), "endpoint=\"%s\",method=\"%s\"",
+                g_http_endpoints[i].uri, http_method_str(g_http_endpoints[i].method));
+        metrics_write_histogram(&w, "hydro_http_request_duration_seconds", labels,
+                &g_http_endpoints[i].latency);
+    }
+
+    // The handler runs on the HTTP server task
+    const struct {
+        const char *name;
+        TaskHandle_t handle;
+    } tasks[] = {
+        {"adc", g_adc_task},
+        {"sampler", g_sampler_task},
+        {"system_control", g_system_control_task},
+        {"display", g_display_task},
+        {"io", g_io_task},
+        {"net", g_net_task},
+        {"telemetry", g_telemetry_task},
+        {"httpd", xTaskGetCurrentTaskHandle()},
+    };
+    metrics_header(&w, "hydro_task_stack_free_min_bytes", "gauge",
+            "Least free stack of each task since it started");
+    for (size_t i = 0; i < sizeof(tasks) / sizeof(tasks[0]); ++i) {
+        if (tasks[i].handle != NULL) {
+            metrics_printf(&w, "hydro_task_stack_free_min_bytes{task=\"%s\"} %u\n",
+                    tasks[i].name, (unsigned)uxTaskGetStackHighWaterMark(tasks[i].handle));
+        }
+    }
+
+    metrics_header(&w, "hydro_heap_free_bytes", "gauge", "Free heap");
+    metrics_printf(&w, "hydro_heap_free_bytes %" PRIu32 "\n", esp_get_free_heap_size());
+    metrics_header(&w, "hydro_heap_min_free_bytes", "gauge", "Least free heap since boot");
+    metrics_printf(&w, "hydro_heap_min_free_bytes %" PRIu32 "\n",
+            esp_get_minimum_free_heap_size());
+    metrics_header(&w, "hydro_heap_largest_free_block_bytes", "gauge",
+            "Largest block that can be allocated");
+    metrics_printf(&w, "hydro_heap_largest_free_block_bytes %u\n",
+            (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+
+    if (!metrics_writer_flush(&w)) {
+        ESP_LOGE(TAG, "Failed to send metrics");
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// Every endpoint of the HTTP server; each is registered with http_timed_handler so its
+// latency is recorded
+struct HttpEndpoint g_http_endpoint_table[] = {
+    {.uri = "/api/readings.json", .method = HTTP_GET, .handler = handle_http_api_readings},
+    {.uri = "/api/pulse", .method = HTTP_POST, .handler = handle_http_api_pulse},
+    {.uri = "/api/events.json", .method = HTTP_GET, .handler = handle_http_api_events},
+    {.uri = "/api/telemetry", .method = HTTP_GET, .handler = handle_http_api_telemetry},
+    {.uri = "/api/ph_calibration", .method = HTTP_POST,
+        .handler = handle_http_api_ph_calibration},
+    {.uri = "/api/history", .method = HTTP_GET, .handler = handle_http_api_history},
+    {.uri = "/api/live", .method = HTTP_GET, .handler = handle_http_api_live,
+        .is_websocket = true},
+    {.uri = "/api/settings", .method = HTTP_GET, .handler = handle_http_api_settings_get},
+    {.uri = "/api/settings", .method = HTTP_POST, .handler = handle_http_api_settings_post},
+    {.uri = "/api/metrics", .method = HTTP_GET, .handler = handle_http_api_metrics},
+};
+
+httpd_handle_t start_http_server() {
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+
+    // Set HTTP server to run only on core 1
+    config.core_id = IO_CORE;
+    config.max_uri_handlers = HTTP_MAX_URI_HANDLERS;
+
+    // Collectors keep their connections open between requests; when every socket is in
+    // use, the least recently used one is closed instead of refusing the new client. Live
+    // channel clients are limited so that takes more than HTTP_REQUEST_SOCKETS clients.
+    config.max_open_sockets = HTTP_MAX_SOCKETS;
+    config.lru_purge_enable = true;
+
+    httpd_handle_t server = NULL;
+
+    // Start http server
+    ESP_ERROR_CHECK(httpd_start(&server, &config));
+
+    // Register URI handlers. Latencies are kept when the server is restarted.
+    g_http_endpoints = g_http_endpoint_table;
+    g_http_endpoint_count = sizeof(g_http_endpoint_table) / sizeof(g_http_endpoint_table[0]);
+    for (size_t i = 0; i < g_http_endpoint_count; ++i) {
+        const httpd_uri_t uri = {
+            .uri = g_http_endpoint_table[i].uri,
+            .method = g_http_endpoint_table[i].method,
+            .handler = http_timed_handler,
+            .user_ctx = &g_http_endpoint_table[i],
+            .is_websocket = g_http_endpoint_table[i].is_websocket,
+        };
+        httpd_register_uri_handler(server, &uri);
+    }
+
+    ESP_LOGI(TAG, "HTTP server started.");
+
+    return server;
+}
+
+esp_err_t stop_http_server(httpd_handle_t server) {
+    return httpd_stop(server);
+}
+
+// Called by the SNTP client whenever the system time is synced
+void sntp_sync_handler(struct timeval *tv) {
+    atomic_store(&g_time_synced, true);
+
+    // Until the first sync, the clock counted seconds from boot
+    uint32_t uptime = esp_timer_get_time() / (1000 * 1000);
+    if (atomic_load(&g_boot_time) == 0 && tv->tv_sec >= MIN_SYNCED_TIME + uptime) {
+        atomic_store(&g_boot_time, tv->tv_sec - uptime);
+    }
+
+    char strftime_buf[64];
+    struct tm timeinfo;
+    localtime_r(&tv->tv_sec, &timeinfo);
+    strftime(strftime_buf, sizeof(strftime_buf), "%c", &timeinfo);
+    ESP_LOGI(TAG, "Datetime: %s", strftime_buf);
+}
+
+// The default event loop task is not pinned to a core, so the WiFi handlers only queue
+// their work for the network task
+void wifi_connect_handler(void *arg, esp_event_base_t event_base,
+        int32_t event_id, void *event_data) {
+    // Sync the time right away instead of waiting for the next SNTP retry
+    const struct IoWork sntp_work = {.type = IO_WORK_SNTP_SYNC};
+    if (!io_queue_work(&sntp_work)) {
+        ESP_LOGW(TAG, "Network queue is full; cannot sync time yet");
+    }
+    const struct IoWork http_work = {.type = IO_WORK_HTTP_START};
+    if (!io_queue_work(&http_work)) {
+        ESP_LOGE(TAG, "Network queue is full; cannot start HTTP server");
+    }
+}
+
+void wifi_disconnect_handler(void *arg, esp_event_base_t event_base,
+        int32_t event_id, void *event_data) {
+    const struct IoWork work = {.type = IO_WORK_HTTP_STOP};
+    if (!io_queue_work(&work)) {
+        ESP_LOGE(TAG, "Network queue is full; cannot stop HTTP server");
+    }
+}
+
+//------------------
+// I/O Functions
+//------------------
+
+void io_run(const struct IoWork *work, uint32_t *saved_settings_generation) {
+    switch (work->type) {
+        case IO_WORK_LOG_RECORD:
+            flash_log_append(&g_flash_log, &work->log_record);
+            break;
+        case IO_WORK_SAVE_SETTINGS:
+            system_settings_persist(saved_settings_generation);
+            break;
+        default:
+            ESP_LOGE(TAG, "Unexpected I/O work");
+            break;
+    }
+}
+
+void net_run(const struct IoWork *work) {
+    httpd_handle_t server;
+    switch (work->type) {
+        case IO_WORK_SNTP_SYNC:
+            // The sync finishes in the background
+            if (esp_netif_sntp_start() != ESP_OK) {
+                ESP_LOGW(TAG, "Cannot start time sync from SNTP server");
+            }
+            break;
+        case IO_WORK_HTTP_START:
+            if (atomic_load(&g_http_server) == NULL) {
+                ESP_LOGI(TAG, "Starting HTTP server");
+                atomic_store(&g_http_server, start_http_server());
+            }
+            break;
+        case IO_WORK_HTTP_STOP:
+            server = atomic_exchange(&g_http_server, NULL);
+            if (server) {
+                ESP_LOGI(TAG, "Stopping HTTP server");
+                if (stop_http_server(server) != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed to stop HTTP server");
+                }
+            }
+            break;
+        case IO_WORK_LIVE_BROADCAST:
+            server = atomic_load(&g_http_server);
+            if (server == NULL || httpd_queue_work(server, live_broadcast, NULL) != ESP_OK) {
+                atomic_store(&g_live_broadcast_queued, false);
+            }
+            break;
+        default:
+            ESP_LOGE(TAG, "Unexpected network work");
+            break;
+    }
+}
+
+// Runs the flash writes queued for core 1 in order. Each flash operation pauses both
+// cores, but starting it from core 1 keeps the work itself off the sampling and control
+// core.
+void io_task(void *pvParameters) {
+    uint32_t saved_settings_generation = settings_store_generation(&g_settings);
+    for (;;) {
+        struct IoWork work;
+        if (xQueueReceive(g_io_queue, &work, portMAX_DELAY) == pdTRUE) {
+            io_run(&work, &saved_settings_generation);
+        }
+    }
+}
+
+// Runs the networking work queued for core 1 in order. It preempts the I/O task, so it
+// only waits for the flash operation that is in progress, not for the queued flash writes.
+void net_task(void *pvParameters) {
+    for (;;) {
+        struct IoWork work;
+        if (xQueueReceive(g_net_queue, &work, portMAX_DELAY) == pdTRUE) {
+            net_run(&work);
+        }
+    }
+}
+
+//-----------------------------
+// System Command Functions
+//-----------------------------
+
+// Takes one reading for every waiting reading request
+void system_send_reading(const struct SystemCommand *requests, size_t count) {
+    ESP_LOGD(TAG, "Sending system reading to %u requests", (unsigned)count);
+
+    struct SystemResponse response = {
+        .cmd_type = CMD_READING_REQUEST,
+    };
+    response.result = sensor_sample(&response.reading);
+    for (size_t i = 0; i < count; ++i) {
+        system_reply(&requests[i], &response);
+    }
+}
+
+void system_start_pulse(const struct SystemCommand *cmd) {
+    ESP_LOGI(TAG, "Starting pump pulse");
+
+    const struct PumpPulseRequest *request = &cmd->pulse_request;
+    struct SystemResponse response = {
+        .cmd_type = CMD_PUMP_PULSE,
+        .result = pump_pulse_start(request->pump_id, request->length, false),
+    };
+    system_reply(cmd, &response);
+}
+
+//--------------------------------------------------
+// Initialization, Event loops, and Main Function
+//--------------------------------------------------
+
+// Publishes updated settings and queues them to be saved to flash
+void system_update_settings(const struct SystemCommand *cmd) {
+    ESP_LOGI(TAG, "Updating system settings");
+
+    struct SystemResponse response = {
+        .cmd_type = CMD_SETTINGS_UPDATE,
+        .result = ESP_OK,
+    };
+    if (system_settings_is_valid(&cmd->updated_settings)) {
+        settings_store_publish(&g_settings, &cmd->updated_settings);
+        const struct IoWork work = {.type = IO_WORK_SAVE_SETTINGS};
+        if (!atomic_exchange(&g_settings_save_queued, true) && !io_queue_work(&work)) {
+            atomic_store(&g_settings_save_queued, false);
+            ESP_LOGE(TAG, "I/O queue is full; settings are saved with the next update");
+        }
+
+        // A shorter interval takes effect now; a longer one after the next check
+        int64_t ph_check_us = esp_timer_get_time()
+            + (int64_t)cmd->updated_settings.ph_stabilize_interval * 1000;
+        if (ph_check_us < scheduler_deadline(&g_control_scheduler, JOB_PH_CHECK)) {
+            control_schedule(JOB_PH_CHECK, ph_check_us);
+        }
+    } else {
+        response.result = ESP_ERR_INVALID_ARG;
+    }
+    response.settings_generation = settings_store_generation(&g_settings);
+    system_reply(cmd, &response);
+}
+
+// Captures the filtered pH probe voltage as a calibration point, then rebuilds and saves the
+// calibration
+void system_calibrate_ph(const struct SystemCommand *cmd) {
+    const struct PhCalibrationRequest *request = &cmd->ph_calibration_request;
+    ESP_LOGI(TAG, "Capturing pH %u calibration point", request->point);
+
+    struct SystemResponse response = {
+        .cmd_type = CMD_PH_CALIBRATE,
+        .ph_calibration = {
+            .point = request->point,
+        },
+    };
+
+    int32_t raw;
+    response.result = adc_read(SENSOR_ADC_CHANNEL_PH, &raw);
+    if (response.result == ESP_OK) {
+        int32_t mv = adc_raw_to_mv(raw);
+        struct PhCalibration calibration = g_ph_cal;
+        switch (request->point) {
+            case 4:
+                calibration.ph_4 = mv;
+                break;
+            case 7:
+                calibration.ph_7 = mv;
+                break;
+            case 10:
+                calibration.ph_10 = mv;
+                break;
+        }
+        response.ph_calibration.mv = mv;
+
+        if (!sensor_ph_calibration_is_valid(&calibration)) {
+            response.result = ESP_ERR_INVALID_ARG;
+        } else {
+            g_ph_cal = calibration;
+            ph_calibration_apply();
+            response.result = ph_calibration_save();
+        }
+    }
+    response.ph_calibration.calibration = g_ph_cal;
+    system_reply(cmd, &response);
+}
+
+void initialize_hardware() {
+    // Initialize pumps and overflow sensor first so the pumps are off as soon as possible
+    initialize_pumps();
+
+    // Initialize flash storage
+    ESP_ERROR_CHECK(nvs_flash_init());
+
+    // Initialize I2C0
+    ESP_ERROR_CHECK(i2cdev_init());
+    ESP_LOGI(TAG, "I2C0 initialized.");
+
+    // Initialize ADS1115 ADC module with the following configuration:
+    //  * Single shot mode until the ADC task starts continuous conversions
+    //  * 250 samples per second
+    //  * A0-GND mux
+    //  * +-4.096 volt range
+    //  * ALERT/RDY pin pulses low after every conversion; this is enabled by setting the
+    //    MSB of the high threshold and clearing the MSB of the low threshold
+    ESP_ERROR_CHECK(ads111x_init_desc(&i2c0_dev, ADS1115_ADDR, I2C0_PORT, I2C0_SDA,
+                I2C0_SCL));
+    i2c0_dev.cfg.master.clk_speed = I2C0_FREQ_HZ;   // Ensure I2C frequency is set
+    ESP_ERROR_CHECK(ads111x_set_mode(&i2c0_dev, ADS111X_MODE_SINGLE_SHOT));
+    ESP_ERROR_CHECK(ads111x_set_data_rate(&i2c0_dev, ADS1115_DATA_RATE));
+    ESP_ERROR_CHECK(ads111x_set_input_mux(&i2c0_dev, ADS111X_MUX_0_GND));
+    ESP_ERROR_CHECK(ads111x_set_gain(&i2c0_dev, ADS1115_GAIN));
+    ESP_ERROR_CHECK(ads111x_set_comp_high_thresh(&i2c0_dev, INT16_MIN));
+    ESP_ERROR_CHECK(ads111x_set_comp_low_thresh(&i2c0_dev, 0));
+    ESP_ERROR_CHECK(ads111x_set_comp_polarity(&i2c0_dev, ADS111X_COMP_POLARITY_LOW));
+    ESP_ERROR_CHECK(ads111x_set_comp_latch(&i2c0_dev, ADS111X_COMP_LATCH_DISABLED));
+    ESP_ERROR_CHECK(ads111x_set_comp_queue(&i2c0_dev, ADS111X_COMP_QUEUE_1));
+
+    // ALERT/RDY is open drain
+    gpio_config_t alert_conf = {
+        .pin_bit_mask = 1ULL << ADS1115_ALERT,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&alert_conf));
+    ESP_LOGI(TAG, "ADS1115 initialized.");
+
+    // Initialize BME280 temp/humidity/pressure sensor
+    ESP_ERROR_CHECK(bmp280_init_desc(&bme280_dev, BME280_ADDR, I2C0_PORT, I2C0_SDA,
+                I2C0_SCL));
+    ESP_ERROR_CHECK(bmp280_init_default_params(&bme280_params));
+    ESP_ERROR_CHECK(bmp280_init(&bme280_dev, &bme280_params));
+    ESP_LOGI(TAG, "BME280 initialized.");
+
+    // Initialize I2C1
+    ESP_ERROR_CHECK(i2c_param_config(I2C1_PORT, &i2c1_conf));
+    ESP_ERROR_CHECK(i2c_driver_install(I2C1_PORT, i2c1_conf.mode, 0, 0, 0));
+    ESP_LOGI(TAG, "I2C1 initialized.");
+
+    // Initialize SSD1306 display; it is cleared by the first frame of the display task
+    ssd1306_dev = ssd1306_create(I2C1_PORT, SSD1306_I2C_ADDRESS);
+    ESP_LOGI(TAG, "SSD1306 initialized.");
+
+    // Open flash storage handler
+    nvs_handle_t nvs_handle;
+    ESP_ERROR_CHECK(nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle));
+
+    // Count boots, so event cursors of an earlier boot are recognized
+    uint32_t boot_count = 0;
+    nvs_get_u32(nvs_handle, NVS_KEY_BOOT_COUNT, &boot_count);
+    g_boot_id = boot_count + 1;
+    ESP_ERROR_CHECK(nvs_set_u32(nvs_handle, NVS_KEY_BOOT_COUNT, g_boot_id));
+    ESP_LOGI(TAG, "Boot %" PRIu32, g_boot_id);
+
+    // Try to retrieve pH meter calibration
     size_t ph_cal_size = sizeof(struct PhCalibration);
-    esp_err_t ph_cal_flash_result = nvs_get_blob(nvs_handle, "PhCalibration",
+    esp_err_t ph_cal_flash_result = nvs_get_blob(nvs_handle, NVS_KEY_PH_CALIBRATION,
             (void *)&g_ph_cal, &ph_cal_size);
     if (ph_cal_flash_result != ESP_OK) {
         // Write default ph calibration values if they dont exist
-        ESP_ERROR_CHECK(nvs_set_blob(nvs_handle, "PhCalibration",
+        g_ph_cal = DEFAULT_PH_CALIBRATION;
+        ESP_ERROR_CHECK(nvs_set_blob(nvs_handle, NVS_KEY_PH_CALIBRATION,
                     (const void *)&g_ph_cal, sizeof(struct PhCalibration)));
         ESP_LOGI(TAG, "Cannot load ph calibration; Wrote default to flash");
     } else {
         ESP_LOGI(TAG, "Loaded ph calibration");
     }
+    ph_calibration_apply();
 
     // Try to retrieve system settings
+    struct SystemSettings settings;
     size_t system_settings_size = sizeof(struct SystemSettings);
-    esp_err_t system_settings_result = nvs_get_blob(nvs_handle, "SystemSettings",
-            (void *)&g_system_settings, &system_settings_size);
-    ESP_ERROR_CHECK(system_settings_result);
-    if (system_settings_result != ESP_OK) {
-        // Write default system settings if they dont exist
-        ESP_ERROR_CHECK(nvs_set_blob(nvs_handle, "SystemSettings",
-                    (const void *)&g_system_settings, sizeof(struct SystemSettings)));
+    esp_err_t system_settings_result = nvs_get_blob(nvs_handle, NVS_KEY_SYSTEM_SETTINGS,
+            (void *)&settings, &system_settings_size);
+    if (system_settings_result != ESP_OK || system_settings_size != sizeof(struct SystemSettings)
+            || !system_settings_is_valid(&settings)) {
+        // Write default system settings if they dont exist or are invalid
+        settings = DEFAULT_SYSTEM_SETTINGS;
+        ESP_ERROR_CHECK(nvs_set_blob(nvs_handle, NVS_KEY_SYSTEM_SETTINGS,
+                    (const void *)&settings, sizeof(struct SystemSettings)));
         ESP_LOGI(TAG, "Cannot load system settings; Wrote default to flash");
     } else {
         ESP_LOGI(TAG, "Loaded system settings");
     }
+    settings_store_init(&g_settings, &settings);
 
+    ESP_ERROR_CHECK(nvs_commit(nvs_handle));
     nvs_close(nvs_handle);
 }
 
 void initialize_resources() {
-    // Create mutex for ADC
-    g_adc_mutex = xSemaphoreCreateMutex();
-    if (g_adc_mutex == NULL) {
-        ESP_LOGE(TAG, "Failed to create mutex for ADC");
+    // Initialize ring of pump pulse events
+    event_ring_init(&g_pump_events);
+
+    // Initialize latest sensor reading
+    sensor_snapshot_init(&g_sensor_snapshot);
+
+    // Open flash log; the system still runs without history if it is missing
+    g_flash_log_ready = flash_log_init(&g_flash_log, LOG_PARTITION_LABEL) == ESP_OK;
+    if (g_flash_log_ready) {
+        g_boot_log_seq = flash_log_next_seq(&g_flash_log);
+    } else {
+        ESP_LOGE(TAG, "Failed to open flash log; history is disabled");
+    }
+
+    // Create work queue of the I/O task
+    g_io_queue = xQueueCreate(IO_QUEUE_SIZE, sizeof(struct IoWork));
+    if (g_io_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create queue for I/O work");
+    }
+
+    // Create work queue of the network task
+    g_net_queue = xQueueCreate(NET_QUEUE_SIZE, sizeof(struct IoWork));
+    if (g_net_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create queue for network work");
     }
 
     // Create mutex for BME280
@@ -609,72 +2496,289 @@ void initialize_resources() {
     }
 
     // Create queue of system commands
-    g_system_command_queue = xQueueCreate(1, sizeof(struct SystemCommand));
+    g_system_command_queue = xQueueCreate(SYSTEM_COMMAND_QUEUE_SIZE, sizeof(struct SystemCommand));
     if (g_system_command_queue == NULL) {
         ESP_LOGE(TAG, "Failed to create queue for system commands");
     }
 
-    // Create queue of system responses
-    g_system_response_queue = xQueueCreate(1, sizeof(struct SystemResponse));
-    if (g_system_response_queue == NULL) {
-        ESP_LOGE(TAG, "Failed to create queue for system responses");
+    // Create mutex for the reply queues of system commands
+    g_system_requesters_mutex = xSemaphoreCreateMutex();
+    if (g_system_requesters_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create mutex for system requesters");
     }
 }
 
+// Starts connecting to WiFi in the background; nothing here waits for the network. The
+// HTTP server is started whenever WiFi connects, and the time is synced from the SNTP
+// server once it is reachable.
 void initialize_networking() {
+    wifi_init();
+
     // Setup handlers to start HTTP server when WiFi connects and stop it when WiFi
     // disconnects
-    httpd_handle_t http_server;
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
-                &wifi_connect_handler, &http_server));
+                &wifi_connect_handler, NULL));
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED,
-                &wifi_disconnect_handler, &http_server));
+                &wifi_disconnect_handler, NULL));
 
-    // Get initial time from SNTP server
+    // The SNTP client keeps retrying on its own until the server is reachable
     esp_sntp_config_t sntp_config = ESP_NETIF_SNTP_DEFAULT_CONFIG(NTP_SERVER_ADDR);
+    sntp_config.sync_cb = sntp_sync_handler;
     setenv("TZ", TIMEZONE, 1);
     tzset();
     ESP_ERROR_CHECK(esp_netif_sntp_init(&sntp_config));
-    refresh_sntp();
 
-    // Initialize HTTP server for the first time
-    http_server = start_http_server();
+    ESP_ERROR_CHECK(esp_wifi_start());
+}
+
+// Samples every sensor every `SAMPLE_INTERVAL` milliseconds and publishes the reading to
+// `g_sensor_snapshot`
+void sampler_task(void *pvParameters) {
+    ESP_ERROR_CHECK(esp_task_wdt_add(NULL));
+    TickType_t last_wake = xTaskGetTickCount();
+    time_t last_log = 0;
+    for (;;) {
+        struct SensorReading reading;
+        esp_err_t err = sensor_sample(&reading);
+        if (err == ESP_OK) {
+            sensor_snapshot_publish(&g_sensor_snapshot, &reading);
+            live_notify();
+            system_control_notify(CONTROL_EVENT_READING);
+
+            if (reading.timestamp - last_log >= LOG_INTERVAL) {
+                last_log = reading.timestamp;
+                log_record_reading(&reading);
+            }
+        } else {
+            ESP_LOGE(TAG, "Failed to sample sensors: %s", esp_err_to_name(err));
+        }
+
+        watchdog_delay_until(&last_wake, pdMS_TO_TICKS(SAMPLE_INTERVAL));
+    }
+}
+
+// Doses pH up or pH down if the latest reading is out of the target range. The dose is
+// sized from the distance to the target and the learned response of the reservoir.
+void system_stabilize_ph() {
+    struct SensorReading reading;
+    if (!sensor_snapshot_read(&g_sensor_snapshot, &reading)) {
+        return;
+    }
+
+    uint8_t pump_id;
+    uint32_t dose = ph_control_plan(&g_ph_dosing, reading.ph_centi, esp_timer_get_time(),
+            &pump_id);
+    if (dose == 0) {
+        return;
+    }
+
+    esp_err_t err = pump_pulse_start(pump_id, dose, true);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot dose pH: %s", esp_err_to_name(err));
+    }
+}
+
+// Learns from the last pH dose once it has mixed into the reservoir
+void system_observe_ph() {
+    struct SensorReading reading;
+    if (!sensor_snapshot_read(&g_sensor_snapshot, &reading)) {
+        return;
+    }
+
+    if (ph_dosing_observe(&g_ph_dosing, reading.ph_centi, esp_timer_get_time())) {
+        ESP_LOGI(TAG, "Learned pH gains: up %" PRId32 ", down %" PRId32 " (centi-pH/s / %d)",
+                g_ph_dosing.gain[PH_DOSE_UP], g_ph_dosing.gain[PH_DOSE_DOWN],
+                1 << PH_DOSING_GAIN_SHIFT);
+    }
+}
+
+// Handles every waiting system command. Reading requests are collected and answered
+// together with a single reading.
+void system_handle_commands() {
+    struct SystemCommand cmd;
+    struct SystemCommand reading_requests[SYSTEM_COMMAND_QUEUE_SIZE];
+    size_t reading_request_count = 0;
+    while (reading_request_count < SYSTEM_COMMAND_QUEUE_SIZE
+            && xQueueReceive(g_system_command_queue, &cmd, 0) == pdTRUE) {
+        ESP_LOGD(TAG, "Received system command");
+
+        // Handle command
+        switch (cmd.cmd_type) {
+            case CMD_READING_REQUEST:
+                reading_requests[reading_request_count++] = cmd;
+                break;
+            case CMD_PUMP_PULSE:
+                system_start_pulse(&cmd);
+                break;
+            case CMD_SETTINGS_UPDATE:
+                system_update_settings(&cmd);
+                break;
+            case CMD_PH_CALIBRATE:
+                system_calibrate_ph(&cmd);
+                break;
+            default:
+                ESP_LOGE(TAG, "Unexpected system command type");
+                break;
+        }
+    }
+    if (reading_request_count > 0) {
+        system_send_reading(reading_requests, reading_request_count);
+    }
+}
+
+// Runs a control job that is due. Periodic jobs are rescheduled from their deadline so
+// they do not drift.
+void control_job_run(const struct ScheduledJob *job, const struct SystemSettings *settings,
+        int64_t now_us) {
+    switch (job->id) {
+        case JOB_PUMP_PULSE_END:
+            pump_pulse_update();
+            break;
+        case JOB_OVERFLOW_POLL:
+            // Pumps are turned off by the overflow interrupt; wait for the sensor to clear
+            overflow_fault_update();
+            if (g_overflow_fault) {
+                control_schedule(JOB_OVERFLOW_POLL, now_us + OVERFLOW_POLL_INTERVAL * 1000);
+            }
+            break;
+        case JOB_PH_CHECK:
+            g_ph_check_due = settings->auto_ph == AUTO_PH_ON;
+            control_schedule(JOB_PH_CHECK, scheduler_next_period(job->deadline_us,
+                        (int64_t)settings->ph_stabilize_interval * 1000, now_us));
+            break;
+        case JOB_REFILL:
+            if (settings->refill_mode == REFILL_ON) {
+                esp_err_t err = pump_pulse_start(PUMP_ID_REFILL, settings->refill_dose_length,
+                        true);
+                if (err != ESP_OK) {
+                    ESP_LOGE(TAG, "Cannot dose refill: %s", esp_err_to_name(err));
+                }
+            }
+            control_schedule(JOB_REFILL, scheduler_next_period(job->deadline_us,
+                        (int64_t)REFILL_INTERVAL * 1000, now_us));
+            break;
+        case JOB_SNTP_REFRESH:
+            {
+                const struct IoWork work = {.type = IO_WORK_SNTP_SYNC};
+                if (!io_queue_work(&work)) {
+                    ESP_LOGW(TAG, "Cannot refresh time from SNTP server");
+                }
+            }
+            control_schedule(JOB_SNTP_REFRESH, scheduler_next_period(job->deadline_us,
+                        (int64_t)SNTP_REFRESH_INTERVAL * 1000, now_us));
+            break;
+        default:
+            ESP_LOGE(TAG, "Unexpected control job");
+            break;
+    }
+}
+
+// Returns the ticks until `deadline_us`, rounded up so the task never wakes before it
+TickType_t control_ticks_until(int64_t deadline_us, int64_t now_us) {
+    if (deadline_us == INT64_MAX) {
+        return portMAX_DELAY;
+    }
+    if (deadline_us <= now_us) {
+        return 0;
+    }
+    const int64_t tick_us = portTICK_PERIOD_MS * 1000;
+    return (deadline_us - now_us + tick_us - 1) / tick_us;
 }
 
+// Blocks until there is work: a system command, an overflow interrupt, a new reading, or
+// the deadline of a control job. Core 0 stays idle otherwise, apart from waking up every
+// `WATCHDOG_FEED_INTERVAL` to reset the task watchdog.
 void system_control_task(void *pvParameters) {
+    ESP_ERROR_CHECK(esp_task_wdt_add(NULL));
+    struct SystemSettings settings;
+    settings_store_read(&g_settings, &settings);
+    int64_t now_us = esp_timer_get_time();
+    scheduler_init(&g_control_scheduler);
+
+    ph_control_init(&g_ph_dosing, settings.ph_dose_length);
+    control_schedule(JOB_PH_CHECK, now_us + (int64_t)settings.ph_stabilize_interval * 1000);
+    control_schedule(JOB_REFILL, now_us + (int64_t)REFILL_INTERVAL * 1000);
+    control_schedule(JOB_SNTP_REFRESH, now_us + (int64_t)SNTP_REFRESH_INTERVAL * 1000);
+
+    // Handle commands and an overflow that happened before the task started
+    uint32_t events = CONTROL_EVENT_COMMAND | CONTROL_EVENT_OVERFLOW;
     for (;;) {
-        // Check for system command
-        if (uxQueueMessagesWaiting(g_system_command_queue) > 0) {
-            // Try to get command from queue
-            struct SystemCommand cmd;
-            const TickType_t timeout = 10;
-            if (xQueueReceive(g_system_command_queue, &cmd, timeout) == pdFALSE) {
-                ESP_LOGE(TAG, "Timeout while receiving system command");
-                continue;
+        esp_task_wdt_reset();
+
+        if (events & CONTROL_EVENT_OVERFLOW) {
+            // Record an interrupted pulse right away, then poll until the sensor clears
+            pump_pulse_update();
+            if (g_overflow_fault
+                    && scheduler_deadline(&g_control_scheduler, JOB_OVERFLOW_POLL) == INT64_MAX) {
+                control_schedule(JOB_OVERFLOW_POLL,
+                        esp_timer_get_time() + OVERFLOW_POLL_INTERVAL * 1000);
             }
+        }
+
+        if (events & CONTROL_EVENT_COMMAND) {
+            system_handle_commands();
+        }
 
-            ESP_LOGI(TAG, "Received system command");
+        settings_store_read(&g_settings, &settings);
 
-            // Handle command
-            switch (cmd.cmd_type) {
-                case CMD_READING_REQUEST:
-                    system_send_reading();
-                    break;
-                default:
-                    ESP_LOGE(TAG, "Unexpected system command type");
-                    break;
+        // A due pH check runs on the first reading sampled after its deadline
+        if (events & CONTROL_EVENT_READING) {
+            system_observe_ph();
+            if (g_ph_check_due) {
+                g_ph_check_due = false;
+                if (settings.auto_ph == AUTO_PH_ON) {
+                    system_stabilize_ph();
+                }
             }
         }
 
-        vTaskDelay(10);
+        now_us = esp_timer_get_time();
+        struct ScheduledJob jobs[SCHEDULER_MAX_JOBS];
+        size_t job_count = scheduler_take_due(&g_control_scheduler, now_us, jobs,
+                SCHEDULER_MAX_JOBS);
+        for (size_t i = 0; i < job_count; ++i) {
+            control_job_run(&jobs[i], &settings, now_us);
+        }
+
+        now_us = esp_timer_get_time();
+        TickType_t timeout = control_ticks_until(scheduler_next_deadline(&g_control_scheduler),
+                now_us);
+        if (timeout > pdMS_TO_TICKS(WATCHDOG_FEED_INTERVAL)) {
+            timeout = pdMS_TO_TICKS(WATCHDOG_FEED_INTERVAL);
+        }
+        if (xTaskNotifyWait(0, UINT32_MAX, &events, timeout) == pdFALSE) {
+            events = 0;
+        }
     }
 }
 
 void app_main(void)
 {
+    // Sensors and control come up first, so the pH is controlled whether or not WiFi is
+    // available. Readings and pump pulse events are kept in the flash log while the system
+    // is offline, and collected from it once WiFi reconnects.
     initialize_hardware();
     initialize_resources();
+
+    // The system control task is created first so every task that wakes it sees its handle.
+    xTaskCreatePinnedToCore(&system_control_task, "system_control", CONTROL_STACK_SIZE, NULL,
+            CONTROL_TASK_PRIORITY, &g_system_control_task, CONTROL_CORE);
+    xTaskCreatePinnedToCore(&adc_task, "adc", ADC_STACK_SIZE, NULL, ADC_TASK_PRIORITY,
+            &g_adc_task, CONTROL_CORE);
+    xTaskCreatePinnedToCore(&sampler_task, "sampler", SAMPLER_STACK_SIZE, NULL,
+            SAMPLER_TASK_PRIORITY, &g_sampler_task, CONTROL_CORE);
+    xTaskCreatePinnedToCore(&io_task, "io", IO_STACK_SIZE, NULL, IO_TASK_PRIORITY, &g_io_task,
+            IO_CORE);
+    xTaskCreatePinnedToCore(&net_task, "net", NET_STACK_SIZE, NULL, NET_TASK_PRIORITY,
+            &g_net_task, IO_CORE);
+    xTaskCreatePinnedToCore(&display_task, "display", DISPLAY_STACK_SIZE, NULL,
+            DISPLAY_TASK_PRIORITY, &g_display_task, IO_CORE);
+
     initialize_networking();
 
-    xTaskCreatePinnedToCore(&system_control_task, "system_control", STACK_SIZE, NULL, 1, NULL, 0);
+    // Telemetry is only pushed if a collector is configured
+    if (strlen(TELEMETRY_HOST) > 0) {
+        xTaskCreatePinnedToCore(&telemetry_task, "telemetry", TELEMETRY_STACK_SIZE, NULL,
+                TELEMETRY_TASK_PRIORITY, &g_telemetry_task, IO_CORE);
+    }
 }
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+//---------------------
+// Type Definitions
+//---------------------
+
+struct StructVersion {
+    uint8_t major;
+    uint8_t minor;
+};
+
+struct SystemSettings {
+    uint32_t magic;
+    struct StructVersion version;
+    uint8_t auto_ph;
+    uint8_t refill_mode;
+    uint32_t ph_stabilize_interval;
+    uint32_t ph_dose_length;
+    uint32_t refill_dose_length;
+};
+
+enum SystemCommandType {
+    CMD_READING_REQUEST,
+    CMD_SETTINGS_UPDATE,
+    CMD_PUMP_PULSE,
+    CMD_PH_CALIBRATE,
+};
+
+// Pump IDs used in events; these match the pump types of the Version 0.x HydroManager
+enum PumpId {
+    PUMP_ID_PH_DOWN = 1,
+    PUMP_ID_PH_UP = 2,
+    PUMP_ID_REFILL = 3,
+};
+
+struct PumpPulseRequest {
+    uint8_t pump_id;
+    uint32_t length;
+};
+
+// Captures the current pH probe voltage as the calibration point of a buffer solution
+struct PhCalibrationRequest {
+    uint8_t point;  // pH of the buffer solution; 4, 7 or 10
+};
+
+struct SystemCommand {
+    enum SystemCommandType cmd_type;
+    // Identifies the response to this command
+    uint32_t request_id;
+    // Queue of the requesting task that the response is sent to
+    QueueHandle_t reply_queue;
+    union {
+        struct SystemSettings updated_settings;
+        struct PumpPulseRequest pulse_request;
+        struct PhCalibrationRequest ph_calibration_request;
+    };
+};
+
+// Sensor values are fixed-point so they can be converted and printed without floats
+struct SensorReading {
+    time_t timestamp;
+    int32_t ph_centi;           // pH * 100
+    int32_t temp_centi;         // Degrees Celsius * 100
+    int32_t humidity_centi;     // %RH * 100
+    uint32_t tds;               // ppm
+};
+
+// Fields of a sensor reading that are sent in JSON, besides its timestamp:
+//
+//     X(member, key, decimals)
+//
+// Each value is sent as `member / 10^decimals`.
+#define SENSOR_READING_FIELDS(X) \
+    X(ph_centi, "ph", 2) \
+    X(tds, "tds", 0) \
+    X(temp_centi, "temp", 2) \
+    X(humidity_centi, "humidity", 2)
+
+// Millivolts of the pH probe in each buffer solution
+struct PhCalibration {
+    float ph_7;
+    float ph_4;
+    float ph_10;
+};
+
+struct PhCalibrationResult {
+    uint8_t point;
+    int32_t mv;     // Captured millivolts
+    struct PhCalibration calibration;
+};
+
+struct SystemResponse {
+    enum SystemCommandType cmd_type;
+    uint32_t request_id;
+    int result;
+    union {
+        struct SensorReading reading;
+        struct PhCalibrationResult ph_calibration;
+        uint32_t settings_generation;
+    };
+};
+
+// A recording of an event where one of the pumps was pulsed by the system
+struct PumpPulseEvent {
+    uint32_t seq;
+    time_t timestamp;
+    uint32_t pulse_length;
+    uint8_t pump_id;
+    uint8_t was_interrupted;
+    uint8_t was_automatic;
+};
+
+enum LogRecordType {
+    LOG_RECORD_READING = 1,
+    LOG_RECORD_PUMP_EVENT = 2,
+};
+
+// Logged sensor reading or pump pulse event
+struct LogRecord {
+    uint8_t type;
+    uint8_t pump_id;
+    uint8_t was_interrupted;
+    uint8_t was_automatic;
+    uint32_t timestamp;
+    union {
+        struct {
+            int16_t ph_centi;
+            int16_t temp_centi;
+            uint16_t humidity_centi;
+            uint16_t tds;
+        } reading;
+        struct {
+            uint32_t seq;
+            uint32_t pulse_length;
+        } pump_event;
+    };
+};
+
+// Work done on core 1 so it never runs on the sampling and control core. Flash writes are
+// done by the I/O task; the rest is networking, done by the network task so it never waits
+// behind flash writes.
+enum IoWorkType {
+    IO_WORK_LOG_RECORD,         // Add a record to the flash log
+    IO_WORK_SAVE_SETTINGS,      // Save the latest published settings to flash
+    IO_WORK_SNTP_SYNC,          // Start syncing the time from the SNTP server
+    IO_WORK_HTTP_START,         // Start the HTTP server; WiFi connected
+    IO_WORK_HTTP_STOP,          // Stop the HTTP server; WiFi disconnected
+    IO_WORK_LIVE_BROADCAST,     // Queue a broadcast to the live channel clients
+};
+
+struct IoWork {
+    enum IoWorkType type;
+    union {
+        struct LogRecord log_record;
+    };
+};
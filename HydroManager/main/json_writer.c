@@ -0,0 +1,183 @@
+#include "json_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void json_writer_init(struct JsonWriter *w, char *buf, size_t cap, json_flush_fn flush,
+        void *flush_ctx) {
+    *w = (struct JsonWriter) {
+        .buf = buf,
+        .cap = cap,
+        .len = 0,
+        .flush = flush,
+        .flush_ctx = flush_ctx,
+        .flushed = 0,
+        .error = false,
+        .need_comma = false,
+    };
+}
+
+bool json_writer_flush(struct JsonWriter *w) {
+    if (w->error) {
+        return false;
+    }
+    if (w->len == 0) {
+        return true;
+    }
+    if (w->flush == NULL || w->flush(w->flush_ctx, w->buf, w->len) != 0) {
+        w->error = true;
+        return false;
+    }
+
+    w->len = 0;
+    w->flushed += 1;
+    return true;
+}
+
+static void json_write(struct JsonWriter *w, const char *data, size_t len) {
+    while (len > 0 && !w->error) {
+        if (w->len == w->cap && !json_writer_flush(w)) {
+            return;
+        }
+
+        size_t n = w->cap - w->len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(w->buf + w->len, data, n);
+        w->len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+static void json_write_char(struct JsonWriter *w, char c) {
+    json_write(w, &c, 1);
+}
+
+static void json_write_escaped(struct JsonWriter *w, const char *str) {
+    json_write_char(w, '"');
+    for (; *str != '\0'; ++str) {
+        char c = *str;
+        if (c == '"' || c == '\\') {
+            json_write_char(w, '\\');
+            json_write_char(w, c);
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[7];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            json_write(w, escaped, 6);
+        } else {
+            json_write_char(w, c);
+        }
+    }
+    json_write_char(w, '"');
+}
+
+// Writes the separator and key before a value
+static void json_value_prefix(struct JsonWriter *w, const char *key) {
+    if (key != NULL) {
+        json_key(w, key);
+    } else if (w->need_comma) {
+        json_write_char(w, ',');
+    }
+    w->need_comma = true;
+}
+
+void json_key(struct JsonWriter *w, const char *key) {
+    if (w->need_comma) {
+        json_write_char(w, ',');
+    }
+    json_write_escaped(w, key);
+    json_write_char(w, ':');
+    w->need_comma = false;
+}
+
+void json_object_begin(struct JsonWriter *w) {
+    json_value_prefix(w, NULL);
+    json_write_char(w, '{');
+    w->need_comma = false;
+}
+
+void json_object_end(struct JsonWriter *w) {
+    json_write_char(w, '}');
+    w->need_comma = true;
+}
+
+void json_array_begin(struct JsonWriter *w) {
+    json_value_prefix(w, NULL);
+    json_write_char(w, '[');
+    w->need_comma = false;
+}
+
+void json_array_end(struct JsonWriter *w) {
+    json_write_char(w, ']');
+    w->need_comma = true;
+}
+
+// Formats `value` into the end of `buf` and returns a pointer to the first digit
+static char *json_format_uint(char *buf_end, uint64_t value) {
+    char *p = buf_end;
+    do {
+        *--p = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    return p;
+}
+
+void json_add_uint(struct JsonWriter *w, const char *key, uint64_t value) {
+    json_value_prefix(w, key);
+
+    char buf[20];
+    char *digits = json_format_uint(buf + sizeof(buf), value);
+    json_write(w, digits, buf + sizeof(buf) - digits);
+}
+
+void json_add_int(struct JsonWriter *w, const char *key, int64_t value) {
+    json_value_prefix(w, key);
+
+    char buf[21];
+    uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    char *digits = json_format_uint(buf + sizeof(buf), magnitude);
+    if (value < 0) {
+        *--digits = '-';
+    }
+    json_write(w, digits, buf + sizeof(buf) - digits);
+}
+
+void json_add_bool(struct JsonWriter *w, const char *key, bool value) {
+    json_value_prefix(w, key);
+
+    if (value) {
+        json_write(w, "true", 4);
+    } else {
+        json_write(w, "false", 5);
+    }
+}
+
+void json_add_string(struct JsonWriter *w, const char *key, const char *value) {
+    json_value_prefix(w, key);
+    json_write_escaped(w, value);
+}
+
+void json_add_fixed(struct JsonWriter *w, const char *key, int32_t value, int decimals) {
+    json_value_prefix(w, key);
+
+    char buf[24];
+    char *end = buf + sizeof(buf);
+    uint32_t magnitude = value < 0 ? -(uint32_t)value : (uint32_t)value;
+
+    // Write the fractional digits, then the integer digits
+    char *p = end;
+    for (int i = 0; i < decimals; ++i) {
+        *--p = '0' + magnitude % 10;
+        magnitude /= 10;
+    }
+    if (decimals > 0) {
+        *--p = '.';
+    }
+    p = json_format_uint(p, magnitude);
+    if (value < 0) {
+        *--p = '-';
+    }
+    json_write(w, p, end - p);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Called when the writer's buffer is full; should write out `len` bytes of `data`.
+// Returns 0 on success.
+typedef int (*json_flush_fn)(void *ctx, const char *data, size_t len);
+
+// Small JSON writer that serializes directly into a caller-provided buffer without any
+// heap allocation. When the buffer fills up, it is passed to the flush function and
+// reused; without a flush function, the writer fails instead.
+//
+// Values are written in order, e.g.:
+//
+//     json_object_begin(&w);
+//     json_add_int(&w, "time", now);
+//     json_add_fixed(&w, "ph", 612, 2);   // "ph":6.12
+//     json_object_end(&w);
+struct JsonWriter {
+    char *buf;
+    size_t cap;
+    size_t len;
+    json_flush_fn flush;
+    void *flush_ctx;
+    // Number of times the buffer was flushed
+    uint32_t flushed;
+    // Set when the buffer overflowed without a flush function or the flush failed
+    bool error;
+    // Set when the next key or value needs to be preceded by a comma
+    bool need_comma;
+};
+
+void json_writer_init(struct JsonWriter *w, char *buf, size_t cap, json_flush_fn flush,
+        void *flush_ctx);
+
+// Writes out the buffered JSON with the flush function. Returns false if there was an error.
+bool json_writer_flush(struct JsonWriter *w);
+
+void json_object_begin(struct JsonWriter *w);
+void json_object_end(struct JsonWriter *w);
+void json_array_begin(struct JsonWriter *w);
+void json_array_end(struct JsonWriter *w);
+
+// Writes the key of the next value; only used for nested objects and arrays
+void json_key(struct JsonWriter *w, const char *key);
+
+// Each of these writes a value. `key` is NULL for array elements.
+void json_add_int(struct JsonWriter *w, const char *key, int64_t value);
+void json_add_uint(struct JsonWriter *w, const char *key, uint64_t value);
+void json_add_bool(struct JsonWriter *w, const char *key, bool value);
+void json_add_string(struct JsonWriter *w, const char *key, const char *value);
+// Writes a fixed-point number `value / 10^decimals` exactly, e.g. (612, 2) -> 6.12
+void json_add_fixed(struct JsonWriter *w, const char *key, int32_t value, int decimals);
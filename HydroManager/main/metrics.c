@@ -0,0 +1,104 @@
+#include "metrics.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+const uint32_t METRICS_LATENCY_BOUNDS_US[METRICS_LATENCY_BUCKETS] = {
+    500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000,
+};
+
+void stage_counter_add(struct StageCounter *counter, uint32_t cycles) {
+    atomic_fetch_add(&counter->calls, 1);
+    atomic_fetch_add(&counter->cycles, cycles);
+
+    uint32_t max = atomic_load(&counter->max_cycles);
+    while (cycles > max && !atomic_compare_exchange_weak(&counter->max_cycles, &max, cycles)) {
+    }
+}
+
+void latency_histogram_record(struct LatencyHistogram *histogram, uint32_t latency_us) {
+    size_t bucket = 0;
+    while (bucket < METRICS_LATENCY_BUCKETS && latency_us > METRICS_LATENCY_BOUNDS_US[bucket]) {
+        ++bucket;
+    }
+    atomic_fetch_add(&histogram->buckets[bucket], 1);
+    atomic_fetch_add(&histogram->count, 1);
+    atomic_fetch_add(&histogram->sum_us, latency_us);
+}
+
+void metrics_writer_init(struct MetricsWriter *w, char *buf, size_t cap, json_flush_fn flush,
+        void *flush_ctx) {
+    *w = (struct MetricsWriter) {
+        .buf = buf,
+        .cap = cap,
+        .flush = flush,
+        .flush_ctx = flush_ctx,
+    };
+}
+
+bool metrics_writer_flush(struct MetricsWriter *w) {
+    if (w->error) {
+        return false;
+    }
+    if (w->len > 0) {
+        if (w->flush == NULL || w->flush(w->flush_ctx, w->buf, w->len) != 0) {
+            w->error = true;
+            return false;
+        }
+        w->len = 0;
+    }
+    return true;
+}
+
+void metrics_printf(struct MetricsWriter *w, const char *fmt, ...) {
+    if (w->error) {
+        return;
+    }
+
+    // Formatted in place; if it does not fit, the buffer is flushed and it is formatted again
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(w->buf + w->len, w->cap - w->len, fmt, args);
+        va_end(args);
+        if (n < 0) {
+            break;
+        }
+        if ((size_t)n < w->cap - w->len) {
+            w->len += n;
+            return;
+        }
+        if (w->len == 0 || !metrics_writer_flush(w)) {
+            break;
+        }
+    }
+    w->error = true;
+}
+
+void metrics_header(struct MetricsWriter *w, const char *name, const char *type,
+        const char *help) {
+    metrics_printf(w, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// Writes microseconds as seconds without floats
+static void metrics_print_seconds(struct MetricsWriter *w, uint64_t us) {
+    metrics_printf(w, "%" PRIu64 ".%06" PRIu64, us / 1000000, us % 1000000);
+}
+
+void metrics_write_histogram(struct MetricsWriter *w, const char *name, const char *labels,
+        struct LatencyHistogram *histogram) {
+    // Buckets of the text format are cumulative
+    uint32_t cumulative = 0;
+    for (size_t i = 0; i < METRICS_LATENCY_BUCKETS; ++i) {
+        cumulative += atomic_load(&histogram->buckets[i]);
+        metrics_printf(w, "%s_bucket{%s,le=\"", name, labels);
+        metrics_print_seconds(w, METRICS_LATENCY_BOUNDS_US[i]);
+        metrics_printf(w, "\"} %" PRIu32 "\n", cumulative);
+    }
+    cumulative += atomic_load(&histogram->buckets[METRICS_LATENCY_BUCKETS]);
+    metrics_printf(w, "%s_bucket{%s,le=\"+Inf\"} %" PRIu32 "\n", name, labels, cumulative);
+
+    metrics_printf(w, "%s_sum{%s} ", name, labels);
+    metrics_print_seconds(w, atomic_load(&histogram->sum_us));
+    metrics_printf(w, "\n%s_count{%s} %" PRIu32 "\n", name, labels, cumulative);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "json_writer.h"
+
+// Number of finite buckets of a latency histogram
+#define METRICS_LATENCY_BUCKETS 12
+
+// Upper bounds of the latency histogram buckets in microseconds
+extern const uint32_t METRICS_LATENCY_BOUNDS_US[METRICS_LATENCY_BUCKETS];
+
+// CPU cycles spent in one stage of the program, e.g. an ADC conversion.
+//
+// Counters can be updated from any task; every field is updated atomically, but a reader
+// can see a call counted before its cycles are added.
+struct StageCounter {
+    _Atomic uint32_t calls;
+    _Atomic uint64_t cycles;
+    _Atomic uint32_t max_cycles;
+};
+
+// Histogram of request latencies. Bucket `i` counts latencies up to
+// METRICS_LATENCY_BOUNDS_US[i] that did not fit an earlier bucket; the last bucket counts
+// the rest.
+struct LatencyHistogram {
+    _Atomic uint32_t buckets[METRICS_LATENCY_BUCKETS + 1];
+    _Atomic uint32_t count;
+    _Atomic uint64_t sum_us;
+};
+
+void stage_counter_add(struct StageCounter *counter, uint32_t cycles);
+
+void latency_histogram_record(struct LatencyHistogram *histogram, uint32_t latency_us);
+
+// Writer of the Prometheus text format that serializes into a caller-provided buffer, like
+// JsonWriter. When the buffer fills up, it is passed to the flush function and reused.
+struct MetricsWriter {
+    char *buf;
+    size_t cap;
+    size_t len;
+    json_flush_fn flush;
+    void *flush_ctx;
+    // Set when a line did not fit the buffer or the flush failed
+    bool error;
+};
+
+void metrics_writer_init(struct MetricsWriter *w, char *buf, size_t cap, json_flush_fn flush,
+        void *flush_ctx);
+
+// Writes out the buffered text with the flush function. Returns false if there was an error.
+bool metrics_writer_flush(struct MetricsWriter *w);
+
+// Appends a formatted line or part of one; a single call must fit the buffer
+void metrics_printf(struct MetricsWriter *w, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Writes the HELP and TYPE lines of a metric
+void metrics_header(struct MetricsWriter *w, const char *name, const char *type,
+        const char *help);
+
+// Writes the samples of a histogram in seconds. `labels` are the labels of the series
+// without braces, e.g. `endpoint="/api/readings.json"`.
+void metrics_write_histogram(struct MetricsWriter *w, const char *name, const char *labels,
+        struct LatencyHistogram *histogram);
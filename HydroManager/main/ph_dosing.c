@@ -0,0 +1,94 @@
+#include "ph_dosing.h"
+
+int32_t ph_dosing_gain(int32_t change_centi, uint32_t dose_ms) {
+    if (dose_ms == 0 || change_centi <= 0) {
+        return PH_DOSING_GAIN_MIN;
+    }
+
+    int64_t gain = ((int64_t)change_centi * 1000 << PH_DOSING_GAIN_SHIFT) / dose_ms;
+    if (gain < PH_DOSING_GAIN_MIN) {
+        return PH_DOSING_GAIN_MIN;
+    }
+    if (gain > PH_DOSING_GAIN_MAX) {
+        return PH_DOSING_GAIN_MAX;
+    }
+    return (int32_t)gain;
+}
+
+void ph_dosing_init(struct PhDosing *dosing, int32_t target_centi, int32_t tolerance_centi,
+        uint32_t min_dose_ms, uint32_t max_dose_ms, int64_t mixing_delay_us,
+        int32_t initial_gain) {
+    *dosing = (struct PhDosing) {
+        .target_centi = target_centi,
+        .tolerance_centi = tolerance_centi,
+        .min_dose_ms = min_dose_ms,
+        .max_dose_ms = max_dose_ms,
+        .mixing_delay_us = mixing_delay_us,
+        .gain = {initial_gain, initial_gain},
+    };
+}
+
+void ph_dosing_record(struct PhDosing *dosing, enum PhDoseDirection direction,
+        uint32_t dose_ms, int32_t ph_centi, int64_t now_us) {
+    dosing->observing = true;
+    dosing->observed_direction = direction;
+    dosing->observed_dose_ms = dose_ms;
+    dosing->observed_ph_centi = ph_centi;
+    dosing->mixed_us = now_us + dosing->mixing_delay_us;
+}
+
+bool ph_dosing_observe(struct PhDosing *dosing, int32_t ph_centi, int64_t now_us) {
+    if (!dosing->observing || now_us < dosing->mixed_us) {
+        return false;
+    }
+    dosing->observing = false;
+
+    // pH up should raise the pH and pH down should lower it; a change the other way is
+    // measured as the minimum gain
+    int32_t change_centi = ph_centi - dosing->observed_ph_centi;
+    if (dosing->observed_direction == PH_DOSE_DOWN) {
+        change_centi = -change_centi;
+    }
+    int32_t measured = ph_dosing_gain(change_centi, dosing->observed_dose_ms);
+
+    int32_t *gain = &dosing->gain[dosing->observed_direction];
+    if (!dosing->learned[dosing->observed_direction]) {
+        dosing->learned[dosing->observed_direction] = true;
+        *gain = measured;
+        return true;
+    }
+
+    // Later measurements are blended in, so one noisy reading cannot swing the dose size
+    *gain += (measured - *gain) / (1 << PH_DOSING_LEARN_SHIFT);
+    if (*gain < PH_DOSING_GAIN_MIN) {
+        *gain = PH_DOSING_GAIN_MIN;
+    }
+    return true;
+}
+
+uint32_t ph_dosing_plan(const struct PhDosing *dosing, int32_t ph_centi, int64_t now_us,
+        enum PhDoseDirection *direction) {
+    if (dosing->observing && now_us < dosing->mixed_us) {
+        return 0;
+    }
+
+    int32_t error_centi = dosing->target_centi - ph_centi;
+    if (error_centi <= dosing->tolerance_centi && error_centi >= -dosing->tolerance_centi) {
+        return 0;
+    }
+    *direction = error_centi > 0 ? PH_DOSE_UP : PH_DOSE_DOWN;
+    if (error_centi < 0) {
+        error_centi = -error_centi;
+    }
+
+    // Dose for the whole error; the tolerance leaves room for a gain that is a bit high
+    int64_t dose_ms = ((int64_t)error_centi * 1000 << PH_DOSING_GAIN_SHIFT)
+        / dosing->gain[*direction];
+    if (dose_ms < dosing->min_dose_ms) {
+        return dosing->min_dose_ms;
+    }
+    if (dose_ms > dosing->max_dose_ms) {
+        return dosing->max_dose_ms;
+    }
+    return (uint32_t)dose_ms;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Fractional bits of the learned dosing gains
+#define PH_DOSING_GAIN_SHIFT 8
+
+// Limits of a learned gain in centi-pH per second of dose, scaled by 2^PH_DOSING_GAIN_SHIFT
+#define PH_DOSING_GAIN_MIN 16
+#define PH_DOSING_GAIN_MAX (100 << PH_DOSING_GAIN_SHIFT)
+
+// Each measured gain is weighted by 1 / 2^shift when it is learned
+#define PH_DOSING_LEARN_SHIFT 2
+
+enum PhDoseDirection {
+    PH_DOSE_UP = 0,
+    PH_DOSE_DOWN = 1,
+};
+
+// Closed-loop pH dosing controller, using only integer math.
+//
+// A dose is sized from the distance between the pH and the target, divided by the
+// learned gain of the pump: how far one second of dose moves the pH of the reservoir.
+// After each dose, no dose is planned until the reagent has had `mixing_delay_us` to mix.
+// The first reading after that is compared to the reading taken when the dose finished,
+// and the measured gain is blended into the learned gain of that pump.
+// The initial gain is only a guess, so the first measured gain of each pump replaces it.
+struct PhDosing {
+    int32_t target_centi;
+    // No dose is planned while the pH is within this distance of the target
+    int32_t tolerance_centi;
+    uint32_t min_dose_ms;
+    uint32_t max_dose_ms;
+    int64_t mixing_delay_us;
+
+    // Learned gain of each pump, in centi-pH per second of dose scaled by
+    // 2^PH_DOSING_GAIN_SHIFT
+    int32_t gain[2];
+    // Whether each gain was measured yet; the first measurement replaces the initial gain
+    bool learned[2];
+
+    // Dose waiting for the reservoir to mix before its response is measured
+    bool observing;
+    enum PhDoseDirection observed_direction;
+    uint32_t observed_dose_ms;
+    int32_t observed_ph_centi;
+    int64_t mixed_us;
+};
+
+// Both gains start as `initial_gain`, in the units of `PhDosing.gain`
+void ph_dosing_init(struct PhDosing *dosing, int32_t target_centi, int32_t tolerance_centi,
+        uint32_t min_dose_ms, uint32_t max_dose_ms, int64_t mixing_delay_us,
+        int32_t initial_gain);
+
+// Records a finished dose of `dose_ms` at `now_us`, with the pH when it finished. Replaces a
+// dose that is still being observed, since their responses cannot be told apart.
+void ph_dosing_record(struct PhDosing *dosing, enum PhDoseDirection direction,
+        uint32_t dose_ms, int32_t ph_centi, int64_t now_us);
+
+// Passes a reading to the controller; learns from the observed dose once it has mixed.
+// Returns true if a gain was updated.
+bool ph_dosing_observe(struct PhDosing *dosing, int32_t ph_centi, int64_t now_us);
+
+// Plans a dose for a reading. Returns the dose length in milliseconds and sets `direction`,
+// or returns 0 if the pH is within tolerance or the last dose is still mixing.
+uint32_t ph_dosing_plan(const struct PhDosing *dosing, int32_t ph_centi, int64_t now_us,
+        enum PhDoseDirection *direction);
+
+// Gain that moves the pH by `change_centi` with a dose of `dose_ms`, clamped to the gain limits
+int32_t ph_dosing_gain(int32_t change_centi, uint32_t dose_ms);
@@ -0,0 +1,68 @@
+#include "pump_control.h"
+
+bool pump_pulse_begin(struct PumpPulse *pulse, uint8_t pump_id, uint32_t length,
+        bool automatic, int64_t now_us) {
+    if (pulse->active) {
+        return false;
+    }
+
+    *pulse = (struct PumpPulse) {
+        .active = true,
+        .pump_id = pump_id,
+        .automatic = automatic,
+        .start_us = now_us,
+        .length = length,
+    };
+    return true;
+}
+
+int64_t pump_pulse_end_us(const struct PumpPulse *pulse) {
+    return pulse->start_us + (int64_t)pulse->length * 1000;
+}
+
+bool pump_pulse_poll(struct PumpPulse *pulse, bool overflow, int64_t now_us, time_t timestamp,
+        struct PumpPulseEvent *event) {
+    if (!pulse->active) {
+        return false;
+    }
+
+    uint32_t elapsed = (now_us - pulse->start_us) / 1000;
+    if (!overflow && elapsed < pulse->length) {
+        return false;
+    }
+
+    pulse->active = false;
+    *event = (struct PumpPulseEvent) {
+        .timestamp = timestamp,
+        .pulse_length = elapsed < pulse->length ? elapsed : pulse->length,
+        .pump_id = pulse->pump_id,
+        .was_interrupted = overflow,
+        .was_automatic = pulse->automatic,
+    };
+    return true;
+}
+
+void ph_control_init(struct PhDosing *dosing, uint32_t ph_dose_length) {
+    ph_dosing_init(dosing, PH_TARGET_CENTI, PH_TOLERANCE_CENTI, PH_DOSE_MIN, PH_DOSE_MAX,
+            (int64_t)PH_MIXING_DELAY * 1000 * 1000,
+            ph_dosing_gain(PH_ACCURACY_CENTI, ph_dose_length));
+}
+
+void ph_control_record_pulse(struct PhDosing *dosing, const struct PumpPulseEvent *event,
+        int32_t ph_centi, int64_t now_us) {
+    if (event->pump_id != PUMP_ID_PH_UP && event->pump_id != PUMP_ID_PH_DOWN) {
+        return;
+    }
+    ph_dosing_record(dosing, event->pump_id == PUMP_ID_PH_UP ? PH_DOSE_UP : PH_DOSE_DOWN,
+            event->pulse_length, ph_centi, now_us);
+}
+
+uint32_t ph_control_plan(const struct PhDosing *dosing, int32_t ph_centi, int64_t now_us,
+        uint8_t *pump_id) {
+    enum PhDoseDirection direction;
+    uint32_t dose = ph_dosing_plan(dosing, ph_centi, now_us, &direction);
+    if (dose != 0) {
+        *pump_id = direction == PH_DOSE_UP ? PUMP_ID_PH_UP : PUMP_ID_PH_DOWN;
+    }
+    return dose;
+}
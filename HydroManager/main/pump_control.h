@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "sdkconfig.h"
+
+#include "hydro_types.h"
+#include "ph_dosing.h"
+
+// Pump pulses and pH control of the system control task.
+//
+// This is the control logic without the hardware: callers turn the pumps on and off,
+// schedule the end of a pulse and record its event. The firmware and the host simulation
+// both run it, so the simulation measures the same decisions the firmware makes.
+
+// Valid range of a single pH pump dose in milliseconds
+#define PH_DOSE_MIN 200
+#define PH_DOSE_MAX 10000
+
+// pH range in centi-pH (pH * 100) kept by auto pH mode
+#define PH_TARGET_MIN_CENTI 550
+#define PH_TARGET_MAX_CENTI 650
+
+// pH readings are accurate within ~0.2 pH
+#define PH_ACCURACY_CENTI 20
+
+// Auto pH mode doses toward the middle of the target range, and stops once the pH is
+// within the accuracy of the readings from either end of the range
+#define PH_TARGET_CENTI ((PH_TARGET_MIN_CENTI + PH_TARGET_MAX_CENTI) / 2)
+#define PH_TOLERANCE_CENTI ((PH_TARGET_MAX_CENTI - PH_TARGET_MIN_CENTI) / 2 - PH_ACCURACY_CENTI)
+
+// Seconds that pH reagent needs to mix into the reservoir after a dose
+#define PH_MIXING_DELAY CONFIG_HYDRO_MANAGER_PH_MIXING_DELAY_S
+
+// Pump pulse in progress; only one pump is pulsed at a time
+struct PumpPulse {
+    bool active;
+    uint8_t pump_id;
+    bool automatic;
+    int64_t start_us;
+    uint32_t length;
+};
+
+// Starts a pulse of `length` milliseconds at `now_us`. Returns false if another pulse is
+// already in progress.
+bool pump_pulse_begin(struct PumpPulse *pulse, uint8_t pump_id, uint32_t length,
+        bool automatic, int64_t now_us);
+
+// Time at which the pulse in progress is due to end
+int64_t pump_pulse_end_us(const struct PumpPulse *pulse);
+
+// Checks the pulse in progress at `now_us`. It finishes once it has run for its full
+// length, or early if `overflow` is set. Returns true if it finished, with its event in
+// `event`; the pump must then be turned off.
+bool pump_pulse_poll(struct PumpPulse *pulse, bool overflow, int64_t now_us, time_t timestamp,
+        struct PumpPulseEvent *event);
+
+// Sets up the pH controller; until a dose has been observed, it assumes that
+// `ph_dose_length` milliseconds of dose moves the pH by the accuracy of the readings
+void ph_control_init(struct PhDosing *dosing, uint32_t ph_dose_length);
+
+// Records a finished pulse with the pH when it finished, so every pH dose, automatic or not,
+// is observed to learn the response of the reservoir. Pulses of other pumps are ignored.
+void ph_control_record_pulse(struct PhDosing *dosing, const struct PumpPulseEvent *event,
+        int32_t ph_centi, int64_t now_us);
+
+// Plans a pH dose for a reading when a pH check is due. Returns the dose length in
+// milliseconds and sets `pump_id`, or returns 0 if no dose is needed.
+uint32_t ph_control_plan(const struct PhDosing *dosing, int32_t ph_centi, int64_t now_us,
+        uint8_t *pump_id);
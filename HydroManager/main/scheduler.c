@@ -0,0 +1,142 @@
+#include "scheduler.h"
+
+// Whether heap entry `a` must be taken before `b`
+static bool job_before(const struct ScheduledJob *a, const struct ScheduledJob *b) {
+    if (a->deadline_us != b->deadline_us) {
+        return a->deadline_us < b->deadline_us;
+    }
+    return a->priority > b->priority;
+}
+
+static void heap_set(struct Scheduler *scheduler, size_t index, const struct ScheduledJob *job) {
+    scheduler->heap[index] = *job;
+    scheduler->position[job->id] = index;
+}
+
+static void sift_up(struct Scheduler *scheduler, size_t index) {
+    struct ScheduledJob job = scheduler->heap[index];
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!job_before(&job, &scheduler->heap[parent])) {
+            break;
+        }
+        heap_set(scheduler, index, &scheduler->heap[parent]);
+        index = parent;
+    }
+    heap_set(scheduler, index, &job);
+}
+
+static void sift_down(struct Scheduler *scheduler, size_t index) {
+    struct ScheduledJob job = scheduler->heap[index];
+    for (;;) {
+        size_t child = index * 2 + 1;
+        if (child >= scheduler->count) {
+            break;
+        }
+        if (child + 1 < scheduler->count
+                && job_before(&scheduler->heap[child + 1], &scheduler->heap[child])) {
+            ++child;
+        }
+        if (!job_before(&scheduler->heap[child], &job)) {
+            break;
+        }
+        heap_set(scheduler, index, &scheduler->heap[child]);
+        index = child;
+    }
+    heap_set(scheduler, index, &job);
+}
+
+// Removes the heap entry at `index`
+static void heap_remove(struct Scheduler *scheduler, size_t index) {
+    scheduler->position[scheduler->heap[index].id] = SCHEDULER_MAX_JOBS;
+    --scheduler->count;
+    if (index == scheduler->count) {
+        return;
+    }
+
+    // Fill the hole with the last entry, which may belong above or below it
+    uint8_t id = scheduler->heap[scheduler->count].id;
+    heap_set(scheduler, index, &scheduler->heap[scheduler->count]);
+    sift_up(scheduler, index);
+    sift_down(scheduler, scheduler->position[id]);
+}
+
+void scheduler_init(struct Scheduler *scheduler) {
+    scheduler->count = 0;
+    for (size_t i = 0; i < SCHEDULER_MAX_JOBS; ++i) {
+        scheduler->position[i] = SCHEDULER_MAX_JOBS;
+    }
+}
+
+bool scheduler_schedule(struct Scheduler *scheduler, uint8_t id, uint8_t priority,
+        int64_t deadline_us) {
+    if (id >= SCHEDULER_MAX_JOBS) {
+        return false;
+    }
+
+    struct ScheduledJob job = {
+        .deadline_us = deadline_us,
+        .priority = priority,
+        .id = id,
+    };
+    size_t index = scheduler->position[id];
+    if (index == SCHEDULER_MAX_JOBS) {
+        index = scheduler->count++;
+        heap_set(scheduler, index, &job);
+        sift_up(scheduler, index);
+        return true;
+    }
+
+    bool earlier = job_before(&job, &scheduler->heap[index]);
+    heap_set(scheduler, index, &job);
+    if (earlier) {
+        sift_up(scheduler, index);
+    } else {
+        sift_down(scheduler, index);
+    }
+    return true;
+}
+
+void scheduler_cancel(struct Scheduler *scheduler, uint8_t id) {
+    if (id < SCHEDULER_MAX_JOBS && scheduler->position[id] != SCHEDULER_MAX_JOBS) {
+        heap_remove(scheduler, scheduler->position[id]);
+    }
+}
+
+int64_t scheduler_deadline(const struct Scheduler *scheduler, uint8_t id) {
+    if (id >= SCHEDULER_MAX_JOBS || scheduler->position[id] == SCHEDULER_MAX_JOBS) {
+        return INT64_MAX;
+    }
+    return scheduler->heap[scheduler->position[id]].deadline_us;
+}
+
+int64_t scheduler_next_deadline(const struct Scheduler *scheduler) {
+    return scheduler->count > 0 ? scheduler->heap[0].deadline_us : INT64_MAX;
+}
+
+size_t scheduler_take_due(struct Scheduler *scheduler, int64_t now_us,
+        struct ScheduledJob *jobs, size_t max_jobs) {
+    size_t count = 0;
+    while (count < max_jobs && scheduler->count > 0
+            && scheduler->heap[0].deadline_us <= now_us) {
+        struct ScheduledJob job = scheduler->heap[0];
+        heap_remove(scheduler, 0);
+
+        // Insertion sort by priority; there are only a few due jobs at a time
+        size_t i = count++;
+        while (i > 0 && jobs[i - 1].priority < job.priority) {
+            jobs[i] = jobs[i - 1];
+            --i;
+        }
+        jobs[i] = job;
+    }
+    return count;
+}
+
+int64_t scheduler_next_period(int64_t deadline_us, int64_t period_us, int64_t now_us) {
+    int64_t next_us = deadline_us + period_us;
+    if (next_us <= now_us) {
+        next_us = now_us + period_us;
+    }
+    return next_us;
+}
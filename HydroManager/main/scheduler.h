@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Max number of distinct jobs; job ids must be below this
+#define SCHEDULER_MAX_JOBS 16
+
+// A job that is due at `deadline_us`, in microseconds since boot
+struct ScheduledJob {
+    int64_t deadline_us;
+    uint8_t priority;
+    uint8_t id;
+};
+
+// Min-heap of jobs ordered by deadline.
+//
+// Each job id is scheduled at most once; scheduling it again moves it to its new deadline.
+// Jobs that are due at the same time are taken in order of priority, highest first, so a
+// slow job never delays a more important one that became due with it. Periodic jobs are
+// rescheduled from their own deadline instead of the time they ran, so they do not drift.
+// Not thread safe; a scheduler is owned by a single task.
+struct Scheduler {
+    struct ScheduledJob heap[SCHEDULER_MAX_JOBS];
+    // Position of each job id in `heap`, or SCHEDULER_MAX_JOBS if it is not scheduled
+    uint8_t position[SCHEDULER_MAX_JOBS];
+    size_t count;
+};
+
+void scheduler_init(struct Scheduler *scheduler);
+
+// Schedules job `id` at `deadline_us`, replacing its deadline if it is already scheduled.
+// Returns false if `id` is out of range.
+bool scheduler_schedule(struct Scheduler *scheduler, uint8_t id, uint8_t priority,
+        int64_t deadline_us);
+
+// Removes job `id` if it is scheduled
+void scheduler_cancel(struct Scheduler *scheduler, uint8_t id);
+
+// Deadline of job `id`, or INT64_MAX if it is not scheduled
+int64_t scheduler_deadline(const struct Scheduler *scheduler, uint8_t id);
+
+// Deadline of the earliest job, or INT64_MAX if no job is scheduled
+int64_t scheduler_next_deadline(const struct Scheduler *scheduler);
+
+// Removes every job that is due at `now_us` and copies up to `max_jobs` of them into `jobs`
+// in order of priority. Jobs that do not fit stay scheduled. Returns the number of jobs.
+size_t scheduler_take_due(struct Scheduler *scheduler, int64_t now_us,
+        struct ScheduledJob *jobs, size_t max_jobs);
+
+// Next deadline of a periodic job that was due at `deadline_us`. Periods that were missed
+// entirely are skipped, so a late job runs once instead of catching up.
+int64_t scheduler_next_period(int64_t deadline_us, int64_t period_us, int64_t now_us);
@@ -0,0 +1,81 @@
+#include "sensor_filter.h"
+
+void sensor_filter_init(struct SensorFilter *filter, uint16_t oversample, uint8_t median_size,
+        uint8_t ema_shift) {
+    if (oversample == 0) {
+        oversample = 1;
+    }
+    if (median_size == 0) {
+        median_size = 1;
+    } else if (median_size > SENSOR_FILTER_MEDIAN_MAX) {
+        median_size = SENSOR_FILTER_MEDIAN_MAX;
+    }
+
+    *filter = (struct SensorFilter) {
+        .oversample = oversample,
+        .median_size = median_size,
+        .ema_shift = ema_shift,
+    };
+}
+
+// Median of the filled part of the window. The window is small, so it is copied and
+// insertion sorted.
+static int32_t sensor_filter_median(const struct SensorFilter *filter) {
+    int32_t sorted[SENSOR_FILTER_MEDIAN_MAX];
+    uint8_t count = filter->window_count;
+    for (uint8_t i = 0; i < count; ++i) {
+        int32_t value = filter->window[i];
+        uint8_t j = i;
+        while (j > 0 && sorted[j - 1] > value) {
+            sorted[j] = sorted[j - 1];
+            --j;
+        }
+        sorted[j] = value;
+    }
+
+    return sorted[count / 2];
+}
+
+bool sensor_filter_add(struct SensorFilter *filter, int32_t raw, int32_t *out) {
+    // Oversample; rounds to the nearest value
+    filter->sum += raw;
+    if (++filter->sum_count < filter->oversample) {
+        return false;
+    }
+    int32_t half = filter->oversample / 2;
+    int32_t sample = (filter->sum >= 0 ? filter->sum + half : filter->sum - half)
+        / filter->oversample;
+    filter->sum = 0;
+    filter->sum_count = 0;
+
+    // Reject spikes
+    filter->window[filter->window_index] = sample;
+    filter->window_index = (filter->window_index + 1) % filter->median_size;
+    if (filter->window_count < filter->median_size) {
+        ++filter->window_count;
+    }
+    int32_t median = sensor_filter_median(filter);
+
+    // Smooth; the first value primes the average so it does not ramp up from 0. Samples can
+    // be negative, which a left shift is undefined for, so the value is scaled with a
+    // multiply.
+    if (!filter->primed) {
+        filter->ema = median * (1 << filter->ema_shift);
+        filter->primed = true;
+    } else {
+        filter->ema += median - (filter->ema >> filter->ema_shift);
+    }
+
+    *out = sensor_filter_value(filter);
+    return true;
+}
+
+int32_t sensor_filter_value(const struct SensorFilter *filter) {
+    if (filter->ema_shift == 0) {
+        return filter->ema;
+    }
+
+    // Round to the nearest value
+    int32_t half = 1 << (filter->ema_shift - 1);
+    return (filter->ema + half) >> filter->ema_shift;
+}
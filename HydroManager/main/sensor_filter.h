@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Upper bound of CONFIG_HYDRO_MANAGER_FILTER_MEDIAN_SIZE
+#define SENSOR_FILTER_MEDIAN_MAX 9
+
+// Filter stage for raw ADC conversions, using only integer math.
+//
+// Conversions pass through three stages:
+//  1. Oversampling: `oversample` conversions are averaged into one sample
+//  2. Spike rejection: the median of the last `median_size` samples is taken
+//  3. Smoothing: an exponential moving average with a weight of 1 / 2^`ema_shift`
+//
+// A stage is bypassed by setting its parameter to 1 (or 0 for `ema_shift`).
+struct SensorFilter {
+    uint16_t oversample;
+    uint8_t median_size;
+    uint8_t ema_shift;
+
+    // Oversampling accumulator
+    int32_t sum;
+    uint16_t sum_count;
+
+    // Ring of the latest oversampled values
+    int32_t window[SENSOR_FILTER_MEDIAN_MAX];
+    uint8_t window_index;
+    uint8_t window_count;
+
+    // Moving average, scaled by 2^`ema_shift`
+    int32_t ema;
+    bool primed;
+};
+
+// `median_size` should be odd and at most SENSOR_FILTER_MEDIAN_MAX
+void sensor_filter_init(struct SensorFilter *filter, uint16_t oversample, uint8_t median_size,
+        uint8_t ema_shift);
+
+// Adds a raw conversion. Returns true and stores the filtered value in `out` when a new
+// oversampled value was completed.
+bool sensor_filter_add(struct SensorFilter *filter, int32_t raw, int32_t *out);
+
+// Latest filtered value; only valid after sensor_filter_add returned true
+int32_t sensor_filter_value(const struct SensorFilter *filter);
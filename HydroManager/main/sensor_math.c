@@ -0,0 +1,110 @@
+#include "sensor_math.h"
+
+// Every 3 pH away from 7 is a calibration point
+#define PH_CAL_SPAN_CENTI 300
+
+// The TDS probe outputs 1 ppm per millivolt
+#define TDS_PPM_PER_MV 1
+
+const struct PhCalibration DEFAULT_PH_CALIBRATION = {
+    .ph_7 = 1500.0f,
+    .ph_4 = 2030.0f,
+    .ph_10 = 975.0f,
+};
+
+// Slope of 3 pH over `mv_span` millivolts, or 0 if the span is not positive
+static int32_t ph_slope(int32_t mv_span) {
+    if (mv_span <= 0) {
+        return 0;
+    }
+    return ((int32_t)PH_CAL_SPAN_CENTI << SENSOR_PH_SLOPE_SHIFT) / mv_span;
+}
+
+void sensor_ph_conversion_init(struct PhConversion *conv, const struct PhCalibration *cal) {
+    int32_t mv_4 = (int32_t)(cal->ph_4 + 0.5f);
+    int32_t mv_7 = (int32_t)(cal->ph_7 + 0.5f);
+    int32_t mv_10 = (int32_t)(cal->ph_10 + 0.5f);
+
+    *conv = (struct PhConversion) {
+        .mv_7 = mv_7,
+        .acid_slope = ph_slope(mv_4 - mv_7),
+        .base_slope = ph_slope(mv_7 - mv_10),
+    };
+}
+
+int32_t sensor_mv_to_centi_ph(const struct PhConversion *conv, int32_t mv) {
+    int32_t delta = mv - conv->mv_7;
+    int32_t slope = (delta > 0) ? conv->acid_slope : conv->base_slope;
+    int32_t half = 1 << (SENSOR_PH_SLOPE_SHIFT - 1);
+
+    // Round towards the nearest centi-pH; delta is negative for basic solutions.
+    // The product is 64-bit since a badly calibrated probe can have a very steep slope.
+    int64_t magnitude = (delta >= 0) ? delta : -delta;
+    int32_t offset = (int32_t)((magnitude * slope + half) >> SENSOR_PH_SLOPE_SHIFT);
+    int32_t centi_ph = (delta >= 0) ? 700 - offset : 700 + offset;
+
+    if (centi_ph < 0) {
+        return 0;
+    } else if (centi_ph > 1400) {
+        return 1400;
+    }
+    return centi_ph;
+}
+
+bool sensor_ph_calibration_is_valid(const struct PhCalibration *cal) {
+    return cal->ph_4 > cal->ph_7 && cal->ph_7 > cal->ph_10;
+}
+
+void sensor_ph_table_init(struct PhTable *table, const struct PhCalibration *cal) {
+    struct PhConversion conv;
+    sensor_ph_conversion_init(&conv, cal);
+
+    for (int32_t i = 0; i < SENSOR_PH_TABLE_SIZE; ++i) {
+        table->centi_ph[i] = sensor_mv_to_centi_ph(&conv, i << SENSOR_PH_TABLE_STEP_SHIFT);
+    }
+}
+
+int32_t sensor_ph_table_lookup(const struct PhTable *table, int32_t mv) {
+    if (mv <= 0) {
+        return table->centi_ph[0];
+    } else if (mv >= SENSOR_PH_TABLE_MAX_MV) {
+        return table->centi_ph[SENSOR_PH_TABLE_SIZE - 1];
+    }
+
+    int32_t index = mv >> SENSOR_PH_TABLE_STEP_SHIFT;
+    int32_t frac = mv & ((1 << SENSOR_PH_TABLE_STEP_SHIFT) - 1);
+    int32_t low = table->centi_ph[index];
+    int32_t high = table->centi_ph[index + 1];
+
+    return low + (((high - low) * frac) >> SENSOR_PH_TABLE_STEP_SHIFT);
+}
+
+int32_t sensor_mv_to_ppm(int32_t mv) {
+    if (mv < 0) {
+        return 0;
+    }
+    return mv * TDS_PPM_PER_MV;
+}
+
+const uint8_t SENSOR_ADC_CHANNEL_INPUT[SENSOR_ADC_NUM_CHANNELS] = {
+#define SENSOR_ADC_CHANNEL_INPUT_ENTRY(name, input, member, convert) \
+    [SENSOR_ADC_CHANNEL_##name] = input,
+    SENSOR_ADC_CHANNELS(SENSOR_ADC_CHANNEL_INPUT_ENTRY)
+#undef SENSOR_ADC_CHANNEL_INPUT_ENTRY
+};
+
+void sensor_reading_convert(struct SensorReading *reading, const struct PhTable *ph_table,
+        const int32_t raw[SENSOR_ADC_NUM_CHANNELS], int32_t full_scale_mv, int32_t temp_centi,
+        int32_t humidity_centi, time_t timestamp) {
+    *reading = (struct SensorReading) {
+        .timestamp = timestamp,
+        .temp_centi = temp_centi,
+        .humidity_centi = humidity_centi
+    };
+
+#define SENSOR_ADC_CHANNEL_CONVERT(name, input, member, convert) \
+    reading->member = convert(ph_table, \
+            sensor_raw_to_mv(raw[SENSOR_ADC_CHANNEL_##name], full_scale_mv));
+    SENSOR_ADC_CHANNELS(SENSOR_ADC_CHANNEL_CONVERT)
+#undef SENSOR_ADC_CHANNEL_CONVERT
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hydro_types.h"
+
+// Fixed-point sensor conversions.
+//
+// Raw ADC counts are converted to millivolts, then to centi-pH (pH * 100) or ppm. Every
+// conversion done per sample is an integer multiply and shift; anything that needs a
+// division is precomputed when the calibration is loaded.
+
+// Fractional bits of the precomputed pH slopes
+#define SENSOR_PH_SLOPE_SHIFT 16
+
+// ADS111X conversions are 16-bit signed, so the full scale range is 2^15 counts
+#define SENSOR_ADC_FULL_SCALE_SHIFT 15
+
+// Full scale range of the ADS1115 in millivolts at the +-4.096v gain (ADS1115_GAIN)
+#define ADS1115_FULL_SCALE_MV 4096
+
+// Precomputed pH calibration. The pH probe voltage falls as pH rises, with a different slope
+// on each side of pH 7, so there is one slope per side.
+struct PhConversion {
+    int32_t mv_7;
+    // Centi-pH per millivolt above `mv_7`, scaled by 2^SENSOR_PH_SLOPE_SHIFT
+    int32_t acid_slope;
+    // Centi-pH per millivolt below `mv_7`, scaled by 2^SENSOR_PH_SLOPE_SHIFT
+    int32_t base_slope;
+};
+
+// Converts a raw ADC conversion to millivolts, given the full scale range of the ADC gain
+static inline int32_t sensor_raw_to_mv(int32_t raw, int32_t full_scale_mv) {
+    return (raw * full_scale_mv + (1 << (SENSOR_ADC_FULL_SCALE_SHIFT - 1)))
+        >> SENSOR_ADC_FULL_SCALE_SHIFT;
+}
+
+// Millivolts between entries of the pH lookup table, as a power of 2
+#define SENSOR_PH_TABLE_STEP_SHIFT 2
+
+// Highest millivolts covered by the pH lookup table
+#define SENSOR_PH_TABLE_MAX_MV 4096
+
+#define SENSOR_PH_TABLE_SIZE ((SENSOR_PH_TABLE_MAX_MV >> SENSOR_PH_TABLE_STEP_SHIFT) + 1)
+
+// Centi-pH of every 2^SENSOR_PH_TABLE_STEP_SHIFT millivolts from 0 to SENSOR_PH_TABLE_MAX_MV,
+// built from the calibration once whenever it changes
+struct PhTable {
+    int16_t centi_ph[SENSOR_PH_TABLE_SIZE];
+};
+
+// Precomputes `conv` from the millivolts measured at pH 4, 7 and 10
+void sensor_ph_conversion_init(struct PhConversion *conv, const struct PhCalibration *cal);
+
+// Converts pH probe millivolts to centi-pH
+int32_t sensor_mv_to_centi_ph(const struct PhConversion *conv, int32_t mv);
+
+// Calibration of a typical pH probe; used until the probe is calibrated
+extern const struct PhCalibration DEFAULT_PH_CALIBRATION;
+
+// Returns true if the calibration points are in order; the probe voltage must fall as the
+// pH rises
+bool sensor_ph_calibration_is_valid(const struct PhCalibration *cal);
+
+// Builds the lookup table of a calibration
+void sensor_ph_table_init(struct PhTable *table, const struct PhCalibration *cal);
+
+// Converts pH probe millivolts to centi-pH with a lookup table. Values between table entries
+// are interpolated with a multiply and shift.
+int32_t sensor_ph_table_lookup(const struct PhTable *table, int32_t mv);
+
+// Converts TDS probe millivolts to ppm
+int32_t sensor_mv_to_ppm(int32_t mv);
+
+// sensor_mv_to_ppm as a channel conversion; the pH table is not used
+static inline int32_t sensor_tds_convert(const struct PhTable *ph_table, int32_t mv) {
+    return sensor_mv_to_ppm(mv);
+}
+
+// Sensors connected to the ADS1115, in the order the ADC task converts them:
+//
+//     X(name, input, member, convert)
+//
+// `input` is the single-ended ADS1115 input of the sensor, `member` is the field of
+// SensorReading that it is stored in, and `convert(ph_table, mv)` converts its millivolts
+// to that field. Every table and loop over the channels is generated from this list, so a
+// sensor is added by adding a line here and a field to SensorReading.
+#define SENSOR_ADC_CHANNELS(X) \
+    X(PH, 0, ph_centi, sensor_ph_table_lookup) \
+    X(TDS, 1, tds, sensor_tds_convert)
+
+enum SensorAdcChannel {
+#define SENSOR_ADC_CHANNEL_ENUM(name, input, member, convert) SENSOR_ADC_CHANNEL_##name,
+    SENSOR_ADC_CHANNELS(SENSOR_ADC_CHANNEL_ENUM)
+#undef SENSOR_ADC_CHANNEL_ENUM
+    SENSOR_ADC_NUM_CHANNELS
+};
+
+// ADS1115 input of each channel
+extern const uint8_t SENSOR_ADC_CHANNEL_INPUT[SENSOR_ADC_NUM_CHANNELS];
+
+// Converts the filtered conversion of every ADC channel and a BME280 reading into a sensor
+// reading. Every conversion is fixed-point; the ESP32 implements float division in software.
+void sensor_reading_convert(struct SensorReading *reading, const struct PhTable *ph_table,
+        const int32_t raw[SENSOR_ADC_NUM_CHANNELS], int32_t full_scale_mv, int32_t temp_centi,
+        int32_t humidity_centi, time_t timestamp);
+
+// Converts BME280 humidity in %RH, scaled by 2^10, to centi-%RH
+static inline int32_t sensor_humidity_to_centi(uint32_t humidity_q10) {
+    return (int32_t)((humidity_q10 * 100 + (1 << 9)) >> 10);
+}
@@ -0,0 +1,44 @@
+#include "sensor_snapshot.h"
+
+void sensor_snapshot_init(struct SensorSnapshot *snapshot) {
+    atomic_init(&snapshot->seq, 0);
+}
+
+void sensor_snapshot_publish(struct SensorSnapshot *snapshot, const struct SensorReading *reading) {
+    uint32_t seq = atomic_load_explicit(&snapshot->seq, memory_order_relaxed);
+
+    // Mark the reading as being written before changing it
+    atomic_store_explicit(&snapshot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    snapshot->reading = *reading;
+
+    // Publish the new reading
+    atomic_store_explicit(&snapshot->seq, seq + 2, memory_order_release);
+}
+
+bool sensor_snapshot_read(struct SensorSnapshot *snapshot, struct SensorReading *out) {
+    uint32_t seq_before, seq_after;
+    do {
+        seq_before = atomic_load_explicit(&snapshot->seq, memory_order_acquire);
+        if (seq_before == 0) {
+            return false;
+        }
+        if (seq_before & 1) {
+            // The writer is in the middle of publishing
+            continue;
+        }
+
+        *out = snapshot->reading;
+
+        // Ensure the copy is finished before checking that it was not changed
+        atomic_thread_fence(memory_order_acquire);
+        seq_after = atomic_load_explicit(&snapshot->seq, memory_order_relaxed);
+    } while ((seq_before & 1) || seq_before != seq_after);
+
+    return true;
+}
+
+uint32_t sensor_snapshot_generation(struct SensorSnapshot *snapshot) {
+    return atomic_load_explicit(&snapshot->seq, memory_order_acquire) / 2;
+}
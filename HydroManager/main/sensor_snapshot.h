@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hydro_types.h"
+
+// Latest sensor reading, shared between cores with a sequence lock.
+//
+// There must be only one writer, and it must not be preempted by a reader running on the
+// same core; the sampler task runs above the system control task on core 0 for this
+// reason. The ADC task, above it, never reads the snapshot.
+// Readers never block the writer and retry if the reading changed while they copied it.
+struct SensorSnapshot {
+    // Odd while the reading is being written; increases by 2 for every published reading
+    _Atomic uint32_t seq;
+    struct SensorReading reading;
+};
+
+void sensor_snapshot_init(struct SensorSnapshot *snapshot);
+
+// Writer: publishes a new reading
+void sensor_snapshot_publish(struct SensorSnapshot *snapshot, const struct SensorReading *reading);
+
+// Reader: copies the latest reading into `out`. Returns false if nothing was published yet.
+bool sensor_snapshot_read(struct SensorSnapshot *snapshot, struct SensorReading *out);
+
+// Number of readings published so far
+uint32_t sensor_snapshot_generation(struct SensorSnapshot *snapshot);
@@ -0,0 +1,67 @@
+#include "settings_store.h"
+
+const struct SystemSettings DEFAULT_SYSTEM_SETTINGS = {
+    .magic = SYSTEM_SETTINGS_MAGIC,
+    .version = {
+        .major = SYSTEM_SETTINGS_VERSION_MAJOR,
+        .minor = 0
+    },
+    .auto_ph = AUTO_PH_ON,
+    .refill_mode = REFILL_OFF,
+    .ph_stabilize_interval = 30 * 60 * 1000,    // 30 minutes
+    .ph_dose_length = 1000,                     // 1 second
+    .refill_dose_length = 30 * 1000             // 30 seconds
+};
+
+void settings_store_init(struct SettingsStore *store, const struct SystemSettings *settings) {
+    for (int i = 0; i < 2; ++i) {
+        store->buffers[i].settings = *settings;
+        store->buffers[i].generation = 0;
+        atomic_init(&store->buffers[i].seq, 0);
+    }
+    atomic_init(&store->current, &store->buffers[0]);
+    atomic_init(&store->generation, 0);
+}
+
+void settings_store_publish(struct SettingsStore *store, const struct SystemSettings *settings) {
+    struct SettingsBuffer *current = atomic_load_explicit(&store->current, memory_order_relaxed);
+    struct SettingsBuffer *next = (current == &store->buffers[0])
+        ? &store->buffers[1] : &store->buffers[0];
+    uint32_t seq = atomic_load_explicit(&next->seq, memory_order_relaxed);
+    uint32_t generation = current->generation + 1;
+
+    // Mark the spare buffer as being written; it may still be copied by a slow reader of
+    // the previous generation
+    atomic_store_explicit(&next->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    next->settings = *settings;
+    next->generation = generation;
+    atomic_store_explicit(&next->seq, seq + 2, memory_order_release);
+
+    // Publish the new generation
+    atomic_store_explicit(&store->current, next, memory_order_release);
+    atomic_store_explicit(&store->generation, generation, memory_order_release);
+}
+
+uint32_t settings_store_read(struct SettingsStore *store, struct SystemSettings *out) {
+    const struct SettingsBuffer *buffer;
+    uint32_t seq_before, seq_after, generation;
+    do {
+        buffer = atomic_load_explicit(&store->current, memory_order_acquire);
+        seq_before = atomic_load_explicit(&buffer->seq, memory_order_acquire);
+
+        *out = buffer->settings;
+        generation = buffer->generation;
+
+        // Ensure the copy is finished before checking that its buffer was not rewritten
+        atomic_thread_fence(memory_order_acquire);
+        seq_after = atomic_load_explicit(&buffer->seq, memory_order_relaxed);
+    } while ((seq_before & 1) || seq_before != seq_after);
+
+    return generation;
+}
+
+uint32_t settings_store_generation(struct SettingsStore *store) {
+    return atomic_load_explicit(&store->generation, memory_order_acquire);
+}
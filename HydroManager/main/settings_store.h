@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "hydro_types.h"
+
+// Auto ph mode values
+#define AUTO_PH_OFF 0
+#define AUTO_PH_ON 1
+
+// Refill mode values
+#define REFILL_OFF 0
+#define REFILL_ON 1
+#define REFILL_CIRCULATE 2
+
+// Magic number and version of stored system settings
+#define SYSTEM_SETTINGS_MAGIC 0xc0ffee15
+#define SYSTEM_SETTINGS_VERSION_MAJOR 1
+
+// Default system settings; used when no valid settings are in flash
+extern const struct SystemSettings DEFAULT_SYSTEM_SETTINGS;
+
+// Published system settings, shared between cores without locks.
+//
+// Every update is written to the buffer that is not current and then published by
+// swapping the current pointer, so a published generation is never modified. Each buffer
+// has its own sequence counter, so readers copy the current settings and retry only if the
+// writer got around to rewriting the buffer they were copying, which takes two updates in
+// a row. There must be only one writer.
+struct SettingsBuffer {
+    struct SystemSettings settings;
+    uint32_t generation;
+    // Odd while the buffer is being written; increases by 2 for every write
+    _Atomic uint32_t seq;
+};
+
+struct SettingsStore {
+    struct SettingsBuffer buffers[2];
+    struct SettingsBuffer *_Atomic current;
+    // Generation of the current buffer
+    _Atomic uint32_t generation;
+};
+
+void settings_store_init(struct SettingsStore *store, const struct SystemSettings *settings);
+
+// Writer: publishes a new generation of settings
+void settings_store_publish(struct SettingsStore *store, const struct SystemSettings *settings);
+
+// Reader: copies the current settings into `out` and returns their generation
+uint32_t settings_store_read(struct SettingsStore *store, struct SystemSettings *out);
+
+// Number of updates published since the store was initialized
+uint32_t settings_store_generation(struct SettingsStore *store);
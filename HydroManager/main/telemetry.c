@@ -0,0 +1,66 @@
+#include "telemetry.h"
+
+#include <string.h>
+
+#include "esp_rom_crc.h"
+
+static uint8_t *put_u32(uint8_t *out, uint32_t value) {
+    out[0] = value;
+    out[1] = value >> 8;
+    out[2] = value >> 16;
+    out[3] = value >> 24;
+    return out + 4;
+}
+
+void telemetry_frame_begin(struct TelemetryFrame *frame, uint8_t *out, uint32_t time,
+        const struct SensorReading *reading, uint32_t dropped, uint32_t boot_id) {
+    frame->out = out;
+    frame->flags = reading != NULL ? TELEMETRY_FLAG_READING : 0;
+    frame->event_count = 0;
+
+    // The flags, event count and cursor are written by telemetry_frame_end()
+    memset(out, 0, TELEMETRY_HEADER_SIZE + TELEMETRY_READING_SIZE);
+    put_u32(out, TELEMETRY_MAGIC);
+    out[4] = TELEMETRY_VERSION;
+    put_u32(out + 8, time);
+    put_u32(out + 16, dropped);
+    put_u32(out + 20, boot_id);
+
+    if (reading != NULL) {
+        uint8_t *p = out + TELEMETRY_HEADER_SIZE;
+        p = put_u32(p, (uint32_t)reading->timestamp);
+        p = put_u32(p, (uint32_t)reading->ph_centi);
+        p = put_u32(p, (uint32_t)reading->temp_centi);
+        p = put_u32(p, (uint32_t)reading->humidity_centi);
+        put_u32(p, reading->tds);
+    }
+}
+
+bool telemetry_frame_add_event(struct TelemetryFrame *frame, const struct PumpPulseEvent *event) {
+    if (frame->event_count == TELEMETRY_MAX_EVENTS) {
+        return false;
+    }
+
+    uint8_t *p = frame->out + TELEMETRY_FRAME_SIZE(frame->event_count) - TELEMETRY_CRC_SIZE;
+    p = put_u32(p, event->seq);
+    p = put_u32(p, (uint32_t)event->timestamp);
+    p = put_u32(p, event->pulse_length);
+    p[0] = event->pump_id;
+    p[1] = (event->was_interrupted ? TELEMETRY_EVENT_INTERRUPTED : 0)
+        | (event->was_automatic ? TELEMETRY_EVENT_AUTOMATIC : 0);
+    p[2] = 0;
+    p[3] = 0;
+    ++frame->event_count;
+    return true;
+}
+
+size_t telemetry_frame_end(struct TelemetryFrame *frame, uint32_t seq, uint8_t flags) {
+    uint8_t *out = frame->out;
+    out[5] = frame->flags | (flags & (TELEMETRY_FLAG_RESET | TELEMETRY_FLAG_MORE));
+    out[6] = frame->event_count;
+    put_u32(out + 12, seq);
+
+    size_t len = TELEMETRY_FRAME_SIZE(frame->event_count) - TELEMETRY_CRC_SIZE;
+    put_u32(out + len, esp_rom_crc32_le(0, out, len));
+    return len + TELEMETRY_CRC_SIZE;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hydro_types.h"
+
+// Binary telemetry frame.
+//
+// A frame has a fixed layout of little-endian fields, so a collector can parse it without
+// a JSON parser and every frame without events is the same size:
+//
+//  * Header (24 bytes): u32 magic, u8 version, u8 flags, u8 number of events, u8 reserved,
+//    u32 time of the frame, u32 seq of the last event in the frame (the event cursor, like
+//    "seq" of '/api/events.json'), u32 number of dropped events and u32 boot ID (like
+//    "boot" of '/api/events.json')
+//  * Reading (20 bytes): u32 timestamp, i32 pH * 100, i32 degrees Celsius * 100,
+//    i32 %RH * 100 and u32 TDS ppm. It is all zeros without TELEMETRY_FLAG_READING.
+//  * Events (16 bytes each): u32 seq, u32 timestamp, u32 pulse length, u8 pump ID, u8 event
+//    flags and u16 reserved
+//  * CRC (4 bytes): CRC32 (IEEE 802.3) of everything before it
+
+// Identifies a telemetry frame; "HMTF"
+#define TELEMETRY_MAGIC 0x46544d48
+
+// Version of the frame layout; increased whenever the layout changes
+#define TELEMETRY_VERSION 2
+
+// Frame flags
+#define TELEMETRY_FLAG_READING  (1 << 0)    // The frame has a reading
+#define TELEMETRY_FLAG_RESET    (1 << 1)    // The event cursor was not recognized
+#define TELEMETRY_FLAG_MORE     (1 << 2)    // More events are waiting after this frame
+
+// Event flags
+#define TELEMETRY_EVENT_INTERRUPTED (1 << 0)
+#define TELEMETRY_EVENT_AUTOMATIC   (1 << 1)
+
+#define TELEMETRY_HEADER_SIZE 24
+#define TELEMETRY_READING_SIZE 20
+#define TELEMETRY_EVENT_SIZE 16
+#define TELEMETRY_CRC_SIZE 4
+
+// Max number of events in a frame
+#define TELEMETRY_MAX_EVENTS 16
+
+#define TELEMETRY_FRAME_SIZE(events) (TELEMETRY_HEADER_SIZE + TELEMETRY_READING_SIZE \
+        + (events) * TELEMETRY_EVENT_SIZE + TELEMETRY_CRC_SIZE)
+#define TELEMETRY_MAX_FRAME_SIZE TELEMETRY_FRAME_SIZE(TELEMETRY_MAX_EVENTS)
+
+struct TelemetryFrame {
+    uint8_t *out;
+    uint8_t flags;
+    uint8_t event_count;
+};
+
+// Starts a frame in `out`, which must fit TELEMETRY_MAX_FRAME_SIZE bytes. `reading` may be
+// NULL if there is no reading yet.
+void telemetry_frame_begin(struct TelemetryFrame *frame, uint8_t *out, uint32_t time,
+        const struct SensorReading *reading, uint32_t dropped, uint32_t boot_id);
+
+// Adds an event to the frame. Returns false if the frame already has TELEMETRY_MAX_EVENTS.
+bool telemetry_frame_add_event(struct TelemetryFrame *frame, const struct PumpPulseEvent *event);
+
+// Finishes the frame with the event cursor `seq` and TELEMETRY_FLAG_RESET or
+// TELEMETRY_FLAG_MORE in `flags`, and returns its size
+size_t telemetry_frame_end(struct TelemetryFrame *frame, uint32_t seq, uint8_t flags);
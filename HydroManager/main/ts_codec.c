@@ -0,0 +1,158 @@
+#include "ts_codec.h"
+
+#include <string.h>
+
+#define TS_CODEC_TYPE_READING 0
+#define TS_CODEC_TYPE_PUMP_EVENT 1
+
+static inline uint64_t zigzag_encode(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t zigzag_decode(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static uint8_t *varint_put(uint8_t *out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+// Returns the number of bytes used, or 0 if the varint is truncated or too long
+static size_t varint_get(const uint8_t *in, size_t len, uint64_t *value) {
+    *value = 0;
+    for (size_t i = 0; i < len && i < 10; ++i) {
+        *value |= (uint64_t)(in[i] & 0x7f) << (7 * i);
+        if (!(in[i] & 0x80)) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static void reading_values(const struct LogRecord *record, int32_t values[TS_CODEC_CHANNELS]) {
+    values[0] = record->reading.ph_centi;
+    values[1] = record->reading.temp_centi;
+    values[2] = record->reading.humidity_centi;
+    values[3] = record->reading.tds;
+}
+
+void ts_codec_reset(struct TsCodecState *state) {
+    memset(state, 0, sizeof(*state));
+}
+
+size_t ts_codec_encode(struct TsCodecState *state, const struct LogRecord *record,
+        uint8_t channels, uint8_t *out) {
+    uint8_t *p = out;
+
+    if (record->type == LOG_RECORD_PUMP_EVENT) {
+        int64_t time_delta = (int64_t)record->timestamp - state->last_timestamp;
+        p = varint_put(p, (zigzag_encode(time_delta) << 1) | TS_CODEC_TYPE_PUMP_EVENT);
+        p = varint_put(p, zigzag_encode((int64_t)record->pump_event.seq - state->last_event_seq));
+        p = varint_put(p, record->pump_event.pulse_length);
+        *p++ = (record->pump_id & 0x0f) | (record->was_interrupted ? 0x10 : 0)
+            | (record->was_automatic ? 0x20 : 0);
+
+        state->last_timestamp = record->timestamp;
+        state->last_event_seq = record->pump_event.seq;
+        return p - out;
+    }
+
+    // The first reading stores its timestamp and the second stores its delta
+    int64_t delta = (int64_t)record->timestamp - state->last_reading_timestamp;
+    int64_t delta_of_delta = delta - state->last_reading_delta;
+
+    int32_t values[TS_CODEC_CHANNELS];
+    reading_values(record, values);
+    uint8_t changed = 0;
+    for (int i = 0; i < TS_CODEC_CHANNELS; ++i) {
+        if ((channels & (1 << i)) && values[i] != state->last_values[i]) {
+            changed |= 1 << i;
+        }
+    }
+
+    p = varint_put(p, (zigzag_encode(delta_of_delta) << 5) | (changed << 1)
+            | TS_CODEC_TYPE_READING);
+    for (int i = 0; i < TS_CODEC_CHANNELS; ++i) {
+        if (changed & (1 << i)) {
+            p = varint_put(p, zigzag_encode((int64_t)values[i] - state->last_values[i]));
+            state->last_values[i] = values[i];
+        }
+    }
+
+    state->last_reading_delta = (state->readings == 0) ? 0 : (int32_t)delta;
+    state->last_reading_timestamp = record->timestamp;
+    state->last_timestamp = record->timestamp;
+    ++state->readings;
+    return p - out;
+}
+
+size_t ts_codec_decode(struct TsCodecState *state, const uint8_t *in, size_t len,
+        struct LogRecord *record) {
+    size_t offset = 0;
+    uint64_t header;
+    size_t used = varint_get(in, len, &header);
+    if (used == 0) {
+        return 0;
+    }
+    offset += used;
+
+    memset(record, 0, sizeof(*record));
+    if ((header & 1) == TS_CODEC_TYPE_PUMP_EVENT) {
+        uint64_t seq_delta, pulse_length;
+        if ((used = varint_get(in + offset, len - offset, &seq_delta)) == 0) {
+            return 0;
+        }
+        offset += used;
+        if ((used = varint_get(in + offset, len - offset, &pulse_length)) == 0) {
+            return 0;
+        }
+        offset += used;
+        if (offset >= len) {
+            return 0;
+        }
+        uint8_t flags = in[offset++];
+
+        record->type = LOG_RECORD_PUMP_EVENT;
+        record->timestamp = state->last_timestamp + zigzag_decode(header >> 1);
+        record->pump_event.seq = state->last_event_seq + zigzag_decode(seq_delta);
+        record->pump_event.pulse_length = pulse_length;
+        record->pump_id = flags & 0x0f;
+        record->was_interrupted = (flags & 0x10) != 0;
+        record->was_automatic = (flags & 0x20) != 0;
+
+        state->last_timestamp = record->timestamp;
+        state->last_event_seq = record->pump_event.seq;
+        return offset;
+    }
+
+    uint8_t changed = (header >> 1) & TS_CODEC_CHANNEL_ALL;
+    int64_t delta = state->last_reading_delta + zigzag_decode(header >> 5);
+    for (int i = 0; i < TS_CODEC_CHANNELS; ++i) {
+        if (changed & (1 << i)) {
+            uint64_t value_delta;
+            if ((used = varint_get(in + offset, len - offset, &value_delta)) == 0) {
+                return 0;
+            }
+            offset += used;
+            state->last_values[i] += zigzag_decode(value_delta);
+        }
+    }
+
+    record->type = LOG_RECORD_READING;
+    record->timestamp = state->last_reading_timestamp + delta;
+    record->reading.ph_centi = state->last_values[0];
+    record->reading.temp_centi = state->last_values[1];
+    record->reading.humidity_centi = state->last_values[2];
+    record->reading.tds = state->last_values[3];
+
+    state->last_reading_delta = (state->readings == 0) ? 0 : (int32_t)delta;
+    state->last_reading_timestamp = record->timestamp;
+    state->last_timestamp = record->timestamp;
+    ++state->readings;
+    return offset;
+}
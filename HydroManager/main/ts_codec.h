@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hydro_types.h"
+
+// Compact encoding of a stream of log records.
+//
+// Reading timestamps are delta-of-delta encoded, so readings taken at a fixed interval
+// only cost the bits of a 0. Each reading channel is stored as the zig-zag encoded
+// difference from its previous value, and only channels that changed are stored. Every
+// number is a little-endian base-128 varint.
+//
+// A record starts with a header varint; bit 0 is the record type:
+//  * Reading (0): bits 1-4 are the mask of stored channels (pH, temperature, humidity,
+//    TDS), and the rest is the zig-zag delta-of-delta of the timestamp. The stored
+//    channels follow as zig-zag deltas.
+//  * Pump pulse event (1): the rest is the zig-zag difference between its timestamp and
+//    the timestamp of the previous record. It is followed by the zig-zag difference from
+//    the previous event seq, the pulse length, and a byte of the pump ID
+//    (bits 0-3), interrupted flag (bit 4) and automatic flag (bit 5).
+//
+// The first reading of a stream stores its absolute timestamp, and the second stores its
+// delta. Streams are decoded from their start, so the state is reset at every flash log
+// page and history export.
+
+#define TS_CODEC_CHANNELS 4
+
+// Mask of every reading channel
+#define TS_CODEC_CHANNEL_ALL ((1 << TS_CODEC_CHANNELS) - 1)
+
+// Largest encoded record; a 6-byte header and 4 channels of 5 bytes
+#define TS_CODEC_RECORD_MAX_SIZE 26
+
+struct TsCodecState {
+    uint32_t readings;          // Number of readings so far
+    uint32_t last_timestamp;    // Timestamp of the last record of any type
+    uint32_t last_reading_timestamp;
+    int32_t last_reading_delta;
+    int32_t last_values[TS_CODEC_CHANNELS];
+    uint32_t last_event_seq;
+};
+
+void ts_codec_reset(struct TsCodecState *state);
+
+// Encodes `record` to `out`, which must fit TS_CODEC_RECORD_MAX_SIZE bytes, and returns
+// the encoded size. Only the reading channels in `channels` are stored; the others are
+// decoded as 0.
+size_t ts_codec_encode(struct TsCodecState *state, const struct LogRecord *record,
+        uint8_t channels, uint8_t *out);
+
+// Decodes a record from `in` and returns the number of bytes used, or 0 if the record is
+// truncated or malformed
+size_t ts_codec_decode(struct TsCodecState *state, const uint8_t *in, size_t len,
+        struct LogRecord *record);
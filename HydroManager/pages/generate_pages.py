@@ -0,0 +1,64 @@
+# Generates ../html_pages.h from the HTML pages in this directory.
+#
+# Each page is minified, gzip compressed and stored as a PROGMEM array, along with an ETag
+# of its compressed bytes. Run this after changing any page:
+#
+#   python3 generate_pages.py
+import gzip, hashlib, os, re
+
+
+PAGES_DIR = os.path.dirname(os.path.abspath(__file__))
+OUTPUT_FILE = os.path.join(PAGES_DIR, '..', 'html_pages.h')
+
+
+def minify(html):
+    html = re.sub(r'<!--.*?-->', '', html, flags=re.S)
+    lines = (line.strip() for line in html.splitlines())
+    # Lines are kept separate so inline scripts do not need semicolons everywhere
+    return '\n'.join(line for line in lines if line and not line.startswith('//'))
+
+
+def page_name(file_name):
+    return 'PAGE_' + os.path.splitext(file_name)[0].upper()
+
+
+def c_array(data):
+    rows = []
+    for i in range(0, len(data), 16):
+        rows.append('  ' + ', '.join(f'0x{b:02x}' for b in data[i:i + 16]))
+    return ',\n'.join(rows)
+
+
+if __name__ == '__main__':
+    out = [
+        '// Generated by pages/generate_pages.py from pages/*.html; do not edit.',
+        '#pragma once',
+        '',
+        '// Gzip compressed HTML page stored in flash',
+        'struct StaticPage {',
+        '  const uint8_t *gzip;',
+        '  size_t length;',
+        '  const char *etag;',
+        '};',
+    ]
+    for file_name in sorted(os.listdir(PAGES_DIR)):
+        if not file_name.endswith('.html'):
+            continue
+        with open(os.path.join(PAGES_DIR, file_name)) as f:
+            html = minify(f.read())
+
+        # A fixed mtime keeps the output the same for the same page
+        data = gzip.compress(html.encode(), compresslevel=9, mtime=0)
+        etag = hashlib.sha1(data).hexdigest()[:16]
+        name = page_name(file_name)
+        out += [
+            '',
+            f'// {file_name}: {len(html)} bytes, {len(data)} bytes compressed',
+            f'const uint8_t {name}_GZIP[] PROGMEM = {{',
+            c_array(data),
+            '};',
+            f'const StaticPage {name} = {{{name}_GZIP, sizeof({name}_GZIP), "\\"{etag}\\""}};',
+        ]
+
+    with open(OUTPUT_FILE, 'w') as f:
+        f.write('\n'.join(out) + '\n')
@@ -2,7 +2,7 @@ from setuptools import setup, find_packages
 
 setup(
     name='hydro_data_view',
-    version='0.1.0',
+    version='0.3.0',
     long_description='A way to view hydroponic data',
     packages=find_packages(),
     include_package_data=True,